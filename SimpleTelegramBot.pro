@@ -12,10 +12,14 @@ QT += gui
 QT += widgets
 QT += network
 QT += sql
+QT += concurrent
 CONFIG += c++17
 CONFIG += release
 CONFIG += silent
 
+# zlib (decompressing animated stickers, ZIP checksums)
+LIBS += -lz
+
 
 # macOS stuff
 # Build for macOS 14
@@ -33,22 +37,56 @@ HEADERS += shared/CallTracer.h
 SOURCES += shared/CallTracer.cpp
 HEADERS += shared/DatabaseHelper.h
 SOURCES += shared/DatabaseHelper.cpp
+HEADERS += shared/ImageScaler.h
+SOURCES += shared/ImageScaler.cpp
 HEADERS += shared/MD5Sum.h
 SOURCES += shared/MD5Sum.cpp
 HEADERS += shared/MessageLogger.h
 SOURCES += shared/MessageLogger.cpp
 HEADERS += shared/StringHelper.h
 SOURCES += shared/StringHelper.cpp
+HEADERS += shared/StringPool.h
+SOURCES += shared/StringPool.cpp
+HEADERS += shared/ZIPWriter.h
+SOURCES += shared/ZIPWriter.cpp
 
 # Specific classes
 HEADERS += src/Application.h
 SOURCES += src/Application.cpp
 HEADERS += src/Config.h
+HEADERS += src/ContactSheetRenderer.h
+SOURCES += src/ContactSheetRenderer.cpp
 HEADERS += src/Deploy.h
 SOURCES += src/main.cpp
 HEADERS += src/MainWindow.h
 SOURCES += src/MainWindow.cpp
+HEADERS += src/ParserBenchmark.h
+SOURCES += src/ParserBenchmark.cpp
+HEADERS += src/ScalerBenchmark.h
+SOURCES += src/ScalerBenchmark.cpp
+HEADERS += src/StickerSetCheck.h
+SOURCES += src/StickerSetCheck.cpp
+HEADERS += src/StickerTranscoder.h
+SOURCES += src/StickerTranscoder.cpp
 HEADERS += src/TelegramComms.h
 SOURCES += src/TelegramComms.cpp
 HEADERS += src/TelegramHelper.h
 SOURCES += src/TelegramHelper.cpp
+HEADERS += src/TelegramRecords.h
+SOURCES += src/TelegramRecords.cpp
+
+
+# Count allocations in the parser benchmark (--benchmark); glibc only
+count_allocations {
+    DEFINES += COUNT_ALLOCATIONS
+}
+
+# Parser fuzzer (libFuzzer, needs clang): qmake CONFIG+=fuzz
+# It provides its own main(), so the bot's main() is left out.
+fuzz {
+    HEADERS += src/ParserFuzzer.h
+    SOURCES += src/ParserFuzzer.cpp
+    SOURCES -= src/main.cpp
+    QMAKE_CXXFLAGS += -fsanitize=fuzzer,address
+    QMAKE_LFLAGS += -fsanitize=fuzzer,address
+}
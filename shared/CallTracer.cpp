@@ -27,6 +27,7 @@
 #include <QDateTime>
 #include <QDebug>
 #include <QJsonDocument>
+#include <QMutexLocker>
 #include <QUrl>
 
 
@@ -68,8 +69,15 @@ void CallTracer::ResetHistory()
     m_CallStack_Time.clear();
     m_CallStack_Method.clear();
     m_CallStack_Text.clear();
-    m_CallCount.clear();
-    m_OriginatorCount.clear();
+    m_CallStack_Parameters.clear();
+
+    QMutexLocker usage_lock(&m_UsageMutex);
+    for (const std::shared_ptr < Usage > & usage : m_AllUsage)
+    {
+        QMutexLocker counts_lock(&usage -> m_Mutex);
+        usage -> m_CallCount.clear();
+        usage -> m_OriginatorCount.clear();
+    }
 }
 
 
@@ -78,6 +86,13 @@ void CallTracer::ResetHistory()
 // Set keeping all history
 void CallTracer::SetKeepAllHistory(const bool mcKeepHistory)
 {
+    // Entries on the stack will be kept after their functions return.
+    // Only this thread's stack can be put together here; other threads
+    // keep history for functions they enter from now on.
+    if (mcKeepHistory)
+    {
+        MaterializeParameters();
+    }
     m_KeepAllHistory = mcKeepHistory;
 }
 
@@ -106,10 +121,17 @@ void CallTracer::EnterFunction(const QString mcFilename,
     m_CallStack_Time << timestamp;
     m_CallStack_Method << called_method;
     m_CallStack_Text << QString("(%1)").arg(mcParameters);
-    m_CallCount[class_name][mcFunction]++;
+    m_CallStack_Parameters << nullptr;
 
-    // Log originator
-    m_OriginatorCount[called_method][caller_method]++;
+    // Usage statistics (this thread's own)
+    {
+        Usage & usage = GetThreadUsage();
+        QMutexLocker counts_lock(&usage.m_Mutex);
+        usage.m_CallCount[class_name][mcFunction]++;
+
+        // Log originator
+        usage.m_OriginatorCount[called_method][caller_method]++;
+    }
 
     // Print on screen if required
     if (m_IsVerbose)
@@ -123,6 +145,29 @@ void CallTracer::EnterFunction(const QString mcFilename,
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Enter function (parameters on demand)
+void CallTracer::EnterFunction(const QString mcFilename,
+    const QString mcFunction,
+    const std::function < QString() > & mcrParameters)
+{
+    // Parameters are needed right away if we print them, or if they have
+    // to outlive the function call
+    if (m_IsVerbose ||
+        m_KeepAllHistory)
+    {
+        EnterFunction(mcFilename, mcFunction, mcrParameters());
+        return;
+    }
+
+    // Put them together later (if at all)
+    EnterFunction(mcFilename, mcFunction, QString());
+    m_CallStack_Text.last() = QString();
+    m_CallStack_Parameters.last() = mcrParameters;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Exit function
 void CallTracer::ExitFunction(const QString mcFilename,
@@ -153,6 +198,31 @@ void CallTracer::ExitFunction(const QString mcFilename,
             "method names exiting method %1 (matching incoming method is %2)")
             .arg(full_method,
                 m_CallStack_Method.last());
+
+        // The entries stay on the stack, but their parameter functions
+        // must not: entries above this function's own belong to functions
+        // that have returned already, and this one is about to return.
+        const int index = m_CallStack_Method.lastIndexOf(full_method);
+        if (index != -1)
+        {
+            for (int above = index + 1;
+                 above < m_CallStack_Parameters.size();
+                 above++)
+            {
+                if (m_CallStack_Parameters[above])
+                {
+                    m_CallStack_Text[above] = tr("(parameters not "
+                        "available)");
+                    m_CallStack_Parameters[above] = nullptr;
+                }
+            }
+            if (m_CallStack_Parameters[index])
+            {
+                m_CallStack_Text[index] =
+                    QString("(%1)").arg(m_CallStack_Parameters[index]());
+                m_CallStack_Parameters[index] = nullptr;
+            }
+        }
         return;
     }
 
@@ -187,11 +257,13 @@ void CallTracer::ExitFunction(const QString mcFilename,
         {
             m_CallStack_Text << tr(": leaving (%1)").arg(mcReason);
         }
+        m_CallStack_Parameters << nullptr;
     } else
     {
         m_CallStack_Time.takeLast();
         m_CallStack_Method.takeLast();
         m_CallStack_Text.takeLast();
+        m_CallStack_Parameters.takeLast();
     }
 }
 
@@ -202,6 +274,7 @@ void CallTracer::ExitFunction(const QString mcFilename,
 QString CallTracer::GetCallTrace()
 {
     QString trace = tr("--------- Trace start\n");
+    MaterializeParameters();
     for (int index = 0; index < m_CallStack_Time.size(); index++)
     {
         trace += QString("%1 %2%3\n")
@@ -216,6 +289,25 @@ QString CallTracer::GetCallTrace()
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Put together parameters that haven't been needed so far
+void CallTracer::MaterializeParameters()
+{
+    // All of these functions are still on the stack, so whatever the
+    // parameter functions refer to is still there
+    for (int index = 0; index < m_CallStack_Parameters.size(); index++)
+    {
+        if (m_CallStack_Parameters[index])
+        {
+            m_CallStack_Text[index] =
+                QString("(%1)").arg(m_CallStack_Parameters[index]());
+            m_CallStack_Parameters[index] = nullptr;
+        }
+    }
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Class name
 QString CallTracer::ClassName(const QString mcFilename)
@@ -237,16 +329,18 @@ QString CallTracer::ClassName(const QString mcFilename)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Call stacks
-QList < QString > CallTracer::m_CallStack_Time;
-QList < QString > CallTracer::m_CallStack_Method;
-QList < QString > CallTracer::m_CallStack_Text;
+// Call stacks (one per thread)
+thread_local QList < QString > CallTracer::m_CallStack_Time;
+thread_local QList < QString > CallTracer::m_CallStack_Method;
+thread_local QList < QString > CallTracer::m_CallStack_Text;
+thread_local QList < std::function < QString() > >
+    CallTracer::m_CallStack_Parameters;
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Keeping history
-bool CallTracer::m_KeepAllHistory = false;
+std::atomic < bool > CallTracer::m_KeepAllHistory(false);
 
 
 
@@ -258,17 +352,23 @@ bool CallTracer::m_KeepAllHistory = false;
 // Reset usage
 void CallTracer::ResetUsage(const QString mcClass, const QString mcMethod)
 {
-    if (mcClass.isEmpty())
-    {
-        m_CallCount.clear();
-    } else
+    QMutexLocker usage_lock(&m_UsageMutex);
+
+    for (const std::shared_ptr < Usage > & usage : m_AllUsage)
     {
-        if (mcMethod.isEmpty())
+        QMutexLocker counts_lock(&usage -> m_Mutex);
+        if (mcClass.isEmpty())
         {
-            m_CallCount[mcClass].clear();
+            usage -> m_CallCount.clear();
         } else
         {
-            m_CallCount[mcClass].remove(mcMethod);
+            if (mcMethod.isEmpty())
+            {
+                usage -> m_CallCount[mcClass].clear();
+            } else
+            {
+                usage -> m_CallCount[mcClass].remove(mcMethod);
+            }
         }
     }
 }
@@ -281,7 +381,7 @@ void CallTracer::ShowUsage(const QString mcClass, const QString mcMethod)
 {
     if (mcClass.isEmpty())
     {
-        QList < QString > all_classes = m_CallCount.keys();
+        QList < QString > all_classes = GetCallCount().keys();
         std::sort(all_classes.begin(), all_classes.end());
         for (auto class_iterator = all_classes.begin();
              class_iterator != all_classes.end();
@@ -294,7 +394,8 @@ void CallTracer::ShowUsage(const QString mcClass, const QString mcMethod)
     {
         if (mcMethod.isEmpty())
         {
-            QList < QString > all_methods = m_CallCount[mcClass].keys();
+            QList < QString > all_methods =
+                GetCallCount().value(mcClass).keys();
             std::sort(all_methods.begin(), all_methods.end());
             for (auto method_iterator = all_methods.begin();
                  method_iterator != all_methods.end();
@@ -305,8 +406,9 @@ void CallTracer::ShowUsage(const QString mcClass, const QString mcMethod)
             }
         } else
         {
-            const QString count =
-                "      " + QString::number(m_CallCount[mcClass][mcMethod]);
+            const QString count = "      " +
+                QString::number(
+                    GetCallCount().value(mcClass).value(mcMethod));
             qDebug().noquote() << QString("%1: %2::%3()")
                 .arg(count.right(7),
                      mcClass,
@@ -329,20 +431,22 @@ void CallTracer::ShowCallOriginators(const QString mcClass,
 
     qDebug().noquote() << tr("Caller statistics for %1").arg(called_method);
 
-    if (!m_OriginatorCount.contains(called_method))
+    const QHash < QString, QHash < QString, int > > originator_count =
+        GetOriginatorCount();
+    if (!originator_count.contains(called_method))
     {
         qDebug().noquote() << tr("  This method has never been called.");
         return;
     }
 
     // Sort by frequency
-    QList < QString > sorted_keys =
-        StringHelper::SortHash(m_OriginatorCount[called_method]);
+    const QHash < QString, int > callers = originator_count[called_method];
+    QList < QString > sorted_keys = StringHelper::SortHash(callers);
     while (!sorted_keys.isEmpty())
     {
         const QString calling_method = sorted_keys.takeLast();
         const QString count = "      " +
-            QString::number(m_OriginatorCount[called_method][calling_method]);
+            QString::number(callers[calling_method]);
         qDebug().noquote() << QString("%1: %2()")
             .arg(count.right(7),
                  calling_method);
@@ -352,16 +456,86 @@ void CallTracer::ShowCallOriginators(const QString mcClass,
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Call count
-QHash < QString, QHash < QString, int > > CallTracer::m_CallCount =
-    QHash < QString, QHash < QString, int > > ();
+// Usage statistics of the current thread
+CallTracer::Usage & CallTracer::GetThreadUsage()
+{
+    if (!m_ThreadUsage)
+    {
+        m_ThreadUsage = std::make_shared < Usage >();
+        QMutexLocker usage_lock(&m_UsageMutex);
+        m_AllUsage << m_ThreadUsage;
+    }
+    return *m_ThreadUsage;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Call counts of all threads
+QHash < QString, QHash < QString, int > > CallTracer::GetCallCount()
+{
+    QHash < QString, QHash < QString, int > > call_count;
+    QMutexLocker usage_lock(&m_UsageMutex);
+    for (const std::shared_ptr < Usage > & usage : m_AllUsage)
+    {
+        QMutexLocker counts_lock(&usage -> m_Mutex);
+        for (auto class_iterator = usage -> m_CallCount.constBegin();
+             class_iterator != usage -> m_CallCount.constEnd();
+             class_iterator++)
+        {
+            QHash < QString, int > & methods =
+                call_count[class_iterator.key()];
+            for (auto method_iterator = class_iterator.value().constBegin();
+                 method_iterator != class_iterator.value().constEnd();
+                 method_iterator++)
+            {
+                methods[method_iterator.key()] += method_iterator.value();
+            }
+        }
+    }
+    return call_count;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Originator counts of all threads
+QHash < QString, QHash < QString, int > > CallTracer::GetOriginatorCount()
+{
+    QHash < QString, QHash < QString, int > > originator_count;
+    QMutexLocker usage_lock(&m_UsageMutex);
+    for (const std::shared_ptr < Usage > & usage : m_AllUsage)
+    {
+        QMutexLocker counts_lock(&usage -> m_Mutex);
+        for (auto called_iterator = usage -> m_OriginatorCount.constBegin();
+             called_iterator != usage -> m_OriginatorCount.constEnd();
+             called_iterator++)
+        {
+            QHash < QString, int > & callers =
+                originator_count[called_iterator.key()];
+            for (auto caller_iterator = called_iterator.value().constBegin();
+                 caller_iterator != called_iterator.value().constEnd();
+                 caller_iterator++)
+            {
+                callers[caller_iterator.key()] += caller_iterator.value();
+            }
+        }
+    }
+    return originator_count;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Usage statistics (one per thread, and all of them)
+thread_local std::shared_ptr < CallTracer::Usage > CallTracer::m_ThreadUsage;
+QList < std::shared_ptr < CallTracer::Usage > > CallTracer::m_AllUsage;
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Originator count
-QHash < QString, QHash < QString, int > > CallTracer::m_OriginatorCount =
-    QHash < QString, QHash < QString, int > > ();
+// Protects the list of usage statistics
+QMutex CallTracer::m_UsageMutex;
 
 
 
@@ -376,7 +550,7 @@ void CallTracer::SetVerbosity(const bool mcNewVerbosity)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Verbosity
-bool CallTracer::m_IsVerbose = false;
+std::atomic < bool > CallTracer::m_IsVerbose(false);
 
 
 
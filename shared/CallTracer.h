@@ -5,8 +5,8 @@
   * Used for keeping track of methods and functions being called while the
   * program is running, to be used as a call stack for debugging purposes.
   *
-  * This class is at this point not designed to be thread-safe, but it should
-  * be rather straight forward, and it's on the list of future improvements.
+  * Every thread has its own call stack (and call history); usage statistics
+  * are shared between all threads.
   *
   * Users of this class would use it mostly through the macros defined below,
   * using \link CALL_IN()\endlink as the first thing when entering a function,
@@ -44,10 +44,16 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QList>
+#include <QMutex>
 #include <QObject>
 #include <QPixmap>
 #include <QString>
 
+// System includes
+#include <atomic>
+#include <functional>
+#include <memory>
+
 
 // The following a luckily documented in
 // https://lists.qt-project.org/pipermail/interest/2015-January/014617.html
@@ -68,9 +74,11 @@
     #define CALL_CLASS QString()
     #define CALL_METHOD QString()
     #define CALL_IN(p) {}
+    #define CALL_IN_LAZY(p) {}
     #define CALL_OUT(p) {}
     #define CALL_STACK() QString()
     #define CALL_SHOW(p) QString()
+    #define CALL_SHOW_FULL(p) QString()
     #define CALL_TIMESTAMP QString()
 #else
     /** \brief Generates class name from filename
@@ -85,6 +93,14 @@
      */
     #define CALL_IN(p) CallTracer::EnterFunction(__FILE__, __func__, p)
 
+    /** \brief Same as CALL_IN(), but the parameter text is only put
+     * together when somebody actually looks at it (verbose mode, full
+     * history, or a call stack for an error). Use it for functions that are
+     * called a lot and have expensive parameters (e.g. JSON objects).
+     */
+    #define CALL_IN_LAZY(p) CallTracer::EnterFunction(__FILE__, __func__, \
+        std::function < QString() >([&]() { return QString(p); }))
+
     /** \brief Saves information when exiting a function or method
      */
     #define CALL_OUT(p) CallTracer::ExitFunction(__FILE__, __func__, __LINE__, p)
@@ -140,6 +156,9 @@ public:
 
     /** \brief Start or stop keeping the entire call history.
       * By default, only the call stack is maintained, not the full history.
+      * Functions the calling thread is currently in are included; other
+      * threads only keep history for functions they enter afterwards
+      * (their pending entries may still be lost when they return).
       * \param mcKeepHistory \c true if you want to keep the full history,
       * \c false if you don't.
       */
@@ -156,6 +175,18 @@ public:
     static void EnterFunction(const QString mcFilename,
         const QString mcFunction, const QString mcParameters);
 
+    /** \brief Records when a function is entered; parameters are provided
+      * on demand.
+      * \param mcFilename Name of the source code file
+      * \param mcFunction Name of the function/method being entered
+      * \param mcrParameters Function returning the list of parameters and
+      * their values. It will only be called while the function is still
+      * on the call stack.
+      */
+    static void EnterFunction(const QString mcFilename,
+        const QString mcFunction,
+        const std::function < QString() > & mcrParameters);
+
     /** \brief Records when a function is exited.
       * \param mcFilename Name of the source code file; \c __FILE__
       * macro is a good choice here
@@ -186,22 +217,32 @@ public:
     static QString ClassName(const QString mcFilename);
 
 private:
-    /** \brief Time stamp when a function/method was called.
+    /** \brief Put together all parameters of
+      * \link CALL_IN_LAZY()\endlink calls that are still pending.
+      */
+    static void MaterializeParameters();
+
+    /** \brief Time stamp when a function/method was called (per thread).
       */
-    static QList < QString > m_CallStack_Time;
-    /** \brief Name of the method that had been called.
+    static thread_local QList < QString > m_CallStack_Time;
+    /** \brief Name of the method that had been called (per thread).
       */
-    static QList < QString > m_CallStack_Method;
+    static thread_local QList < QString > m_CallStack_Method;
     /** \brief Text (usually the list of arguments and their content) for the
-      * call of the function/method
+      * call of the function/method (per thread)
       */
-    static QList < QString > m_CallStack_Text;
+    static thread_local QList < QString > m_CallStack_Text;
+    /** \brief Parameters that have not been put together yet (see
+      * \link CALL_IN_LAZY()\endlink); empty for all other entries.
+      */
+    static thread_local QList < std::function < QString() > >
+        m_CallStack_Parameters;
 
     /** \brief Flag indicating if we want to keep the full call history or just
       * the call stack.
       * Set it with \link SetKeepAllHistory()\endlink.
       */
-    static bool m_KeepAllHistory;
+    static std::atomic < bool > m_KeepAllHistory;
 
 
 
@@ -231,14 +272,46 @@ public:
         const QString mcMethod);
 
 private:
-    /** \brief Counts what class and method is called how often
-      * Maps class + method to call count.
+    /** \brief Usage statistics of one thread. Each thread only counts its
+      * own calls, so threads don't wait for each other; the counts of all
+      * threads are added up when they are shown.
+      */
+    struct Usage
+    {
+        /** \brief Protects the counts (only ever contended while they are
+          * being read or reset).
+          */
+        QMutex m_Mutex;
+        /** \brief Counts what class and method is called how often
+          * Maps class + method to call count.
+          */
+        QHash < QString, QHash < QString, int > > m_CallCount;
+        /** \brief Counts what method is called by what other method, and
+          * how often maps called method + calling method to call count.
+          */
+        QHash < QString, QHash < QString, int > > m_OriginatorCount;
+    };
+
+    /** \brief Usage statistics of the current thread (registered with
+      * \link m_AllUsage\endlink the first time they're needed).
+      */
+    static Usage & GetThreadUsage();
+    /** \brief Call counts of all threads added up.
+      */
+    static QHash < QString, QHash < QString, int > > GetCallCount();
+    /** \brief Originator counts of all threads added up.
+      */
+    static QHash < QString, QHash < QString, int > > GetOriginatorCount();
+
+    /** \brief Usage statistics of this thread.
+      */
+    static thread_local std::shared_ptr < Usage > m_ThreadUsage;
+    /** \brief Usage statistics of all threads (kept after threads finish).
       */
-    static QHash < QString, QHash < QString, int > > m_CallCount;
-    /** \brief Counts what method is called by what other method, and how often
-      * maps called method + calling method to call count.
+    static QList < std::shared_ptr < Usage > > m_AllUsage;
+    /** \brief Protects the list of usage statistics.
       */
-    static QHash < QString, QHash < QString, int > > m_OriginatorCount;
+    static QMutex m_UsageMutex;
 
 public:
     /** \brief Set verbosity of operations
@@ -249,7 +322,7 @@ public:
 private:
     /** \brief Verbosity
       */
-    static bool m_IsVerbose;
+    static std::atomic < bool > m_IsVerbose;
 
 
 
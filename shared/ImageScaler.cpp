@@ -0,0 +1,607 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// ImageScaler.cpp
+// Class implementation file
+
+// Project includes
+#include "CallTracer.h"
+#include "ImageScaler.h"
+
+// Qt includes
+#include <QVarLengthArray>
+
+// System includes
+#include <cmath>
+#include <cstring>
+
+// SSE2 is part of every x86-64 CPU; AVX2 is compiled in separately (GCC
+// and clang only) and used if the CPU has it
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define IMAGESCALER_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(IMAGESCALER_SSE2) && defined(__GNUC__)
+#define IMAGESCALER_AVX2
+#include <immintrin.h>
+#endif
+
+// Weights are fixed point numbers with 14 bits; each target pixel's
+// weights add up to exactly 1 << WEIGHT_BITS. The vertical pass keeps
+// INTERMEDIATE_BITS fractional bits (so intermediate values fit into 16
+// bits), the horizontal pass removes the rest.
+#define WEIGHT_BITS 14
+#define INTERMEDIATE_BITS 7
+#define VERTICAL_SHIFT (WEIGHT_BITS - INTERMEDIATE_BITS)
+#define HORIZONTAL_SHIFT (WEIGHT_BITS + INTERMEDIATE_BITS)
+
+
+
+// ==================================================================== Kernels
+
+// Kernels work on a single target row each and are called for every row,
+// so they are plain functions without call tracing. They compute the same
+// integer arithmetic: 32 bit products of 16 bit values and weights (SIMD
+// uses madd on value/zero pairs for this), added up and shifted with
+// rounding. Values are never negative, so saturation never kicks in, and
+// values and weights fit into 16 bits, so two of them can share a madd.
+
+// Vertical pass: add up source rows (bytes) into one intermediate row
+typedef void (* VerticalKernel)(const uchar * const * mcpLines,
+    const qint32 * mcpWeights, const int mcCount, const int mcNumValues,
+    qint16 * mpOutput);
+
+// Horizontal pass: add up intermediate pixels into one target row
+typedef void (* HorizontalKernel)(const qint16 * mcpInput,
+    const int mcNumPixels, const int * mcpFirst, const int * mcpCount,
+    const qint32 * mcpWeights, uchar * mpOutput);
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Vertical pass (scalar)
+static void Vertical_Scalar(const uchar * const * mcpLines,
+    const qint32 * mcpWeights, const int mcCount, const int mcNumValues,
+    qint16 * mpOutput)
+{
+    for (int index = 0; index < mcNumValues; index++)
+    {
+        qint32 sum = 0;
+        for (int line = 0; line < mcCount; line++)
+        {
+            sum += qint32(mcpLines[line][index]) * mcpWeights[line];
+        }
+        mpOutput[index] =
+            qint16((sum + (1 << (VERTICAL_SHIFT - 1))) >> VERTICAL_SHIFT);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Horizontal pass (scalar)
+static void Horizontal_Scalar(const qint16 * mcpInput,
+    const int mcNumPixels, const int * mcpFirst, const int * mcpCount,
+    const qint32 * mcpWeights, uchar * mpOutput)
+{
+    const qint32 * weight = mcpWeights;
+    for (int pixel = 0; pixel < mcNumPixels; pixel++)
+    {
+        qint32 sum[4] = { 0, 0, 0, 0 };
+        const qint16 * input = mcpInput + 4 * mcpFirst[pixel];
+        for (int source = 0; source < mcpCount[pixel]; source++)
+        {
+            for (int channel = 0; channel < 4; channel++)
+            {
+                sum[channel] += qint32(input[channel]) * *weight;
+            }
+            input += 4;
+            weight++;
+        }
+        for (int channel = 0; channel < 4; channel++)
+        {
+            const qint32 value = (sum[channel] +
+                (1 << (HORIZONTAL_SHIFT - 1))) >> HORIZONTAL_SHIFT;
+            mpOutput[4 * pixel + channel] = uchar(qBound(0, value, 255));
+        }
+    }
+}
+
+
+
+#ifdef IMAGESCALER_SSE2
+///////////////////////////////////////////////////////////////////////////////
+// Vertical pass (SSE2; 16 values at a time)
+static void Vertical_SSE2(const uchar * const * mcpLines,
+    const qint32 * mcpWeights, const int mcCount, const int mcNumValues,
+    qint16 * mpOutput)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(1 << (VERTICAL_SHIFT - 1));
+    int index = 0;
+    for (; index + 16 <= mcNumValues; index += 16)
+    {
+        // Two lines at a time: interleaved values of both lines times
+        // interleaved weights (an odd last line is paired with itself and
+        // a weight of zero)
+        __m128i sum0 = zero;
+        __m128i sum1 = zero;
+        __m128i sum2 = zero;
+        __m128i sum3 = zero;
+        for (int line = 0; line < mcCount; line += 2)
+        {
+            const int next = qMin(line + 1, mcCount - 1);
+            const qint32 next_weight =
+                (line + 1 < mcCount ? mcpWeights[line + 1] : 0);
+            const __m128i weights =
+                _mm_set1_epi32((next_weight << 16) | mcpWeights[line]);
+            const __m128i first = _mm_loadu_si128(
+                reinterpret_cast < const __m128i * >(mcpLines[line] + index));
+            const __m128i second = _mm_loadu_si128(
+                reinterpret_cast < const __m128i * >(mcpLines[next] + index));
+            const __m128i low = _mm_unpacklo_epi8(first, second);
+            const __m128i high = _mm_unpackhi_epi8(first, second);
+            sum0 = _mm_add_epi32(sum0,
+                _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), weights));
+            sum1 = _mm_add_epi32(sum1,
+                _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), weights));
+            sum2 = _mm_add_epi32(sum2,
+                _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), weights));
+            sum3 = _mm_add_epi32(sum3,
+                _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), weights));
+        }
+        sum0 = _mm_srai_epi32(_mm_add_epi32(sum0, rounding), VERTICAL_SHIFT);
+        sum1 = _mm_srai_epi32(_mm_add_epi32(sum1, rounding), VERTICAL_SHIFT);
+        sum2 = _mm_srai_epi32(_mm_add_epi32(sum2, rounding), VERTICAL_SHIFT);
+        sum3 = _mm_srai_epi32(_mm_add_epi32(sum3, rounding), VERTICAL_SHIFT);
+        __m128i * output = reinterpret_cast < __m128i * >(mpOutput + index);
+        _mm_storeu_si128(output, _mm_packs_epi32(sum0, sum1));
+        _mm_storeu_si128(output + 1, _mm_packs_epi32(sum2, sum3));
+    }
+
+    // Rest (up to 3 pixels)
+    if (index < mcNumValues)
+    {
+        QVarLengthArray < const uchar *, 64 > lines(mcCount);
+        for (int line = 0; line < mcCount; line++)
+        {
+            lines[line] = mcpLines[line] + index;
+        }
+        Vertical_Scalar(lines.constData(), mcpWeights, mcCount,
+            mcNumValues - index, mpOutput + index);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Horizontal pass (SSE2; one pixel at a time)
+static void Horizontal_SSE2(const qint16 * mcpInput,
+    const int mcNumPixels, const int * mcpFirst, const int * mcpCount,
+    const qint32 * mcpWeights, uchar * mpOutput)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi32(1 << (HORIZONTAL_SHIFT - 1));
+    const qint32 * weight = mcpWeights;
+    for (int pixel = 0; pixel < mcNumPixels; pixel++)
+    {
+        __m128i sum = zero;
+        const qint16 * input = mcpInput + 4 * mcpFirst[pixel];
+        int source = 0;
+
+        // Two neighbouring source pixels at a time (one load); channels of
+        // both interleaved, times interleaved weights
+        for (; source + 2 <= mcpCount[pixel]; source += 2)
+        {
+            const __m128i values = _mm_loadu_si128(
+                reinterpret_cast < const __m128i * >(input));
+            const __m128i weights =
+                _mm_set1_epi32((weight[1] << 16) | weight[0]);
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(
+                _mm_unpacklo_epi16(values, _mm_srli_si128(values, 8)),
+                weights));
+            input += 8;
+            weight += 2;
+        }
+        if (source < mcpCount[pixel])
+        {
+            const __m128i values = _mm_unpacklo_epi16(_mm_loadl_epi64(
+                reinterpret_cast < const __m128i * >(input)), zero);
+            sum = _mm_add_epi32(sum,
+                _mm_madd_epi16(values, _mm_set1_epi32(*weight)));
+            weight++;
+        }
+        sum = _mm_srai_epi32(_mm_add_epi32(sum, rounding), HORIZONTAL_SHIFT);
+        sum = _mm_packs_epi32(sum, sum);
+        sum = _mm_packus_epi16(sum, sum);
+        const qint32 result = _mm_cvtsi128_si32(sum);
+        memcpy(mpOutput + 4 * pixel, &result, 4);
+    }
+}
+#endif
+
+
+
+#ifdef IMAGESCALER_AVX2
+///////////////////////////////////////////////////////////////////////////////
+// Vertical pass (AVX2; 32 values at a time)
+__attribute__((target("avx2")))
+static void Vertical_AVX2(const uchar * const * mcpLines,
+    const qint32 * mcpWeights, const int mcCount, const int mcNumValues,
+    qint16 * mpOutput)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i rounding = _mm256_set1_epi32(1 << (VERTICAL_SHIFT - 1));
+    int index = 0;
+    for (; index + 32 <= mcNumValues; index += 32)
+    {
+        // Same as SSE2, but unpacking works within 128 bit lanes: sums
+        // hold values 0-3/16-19, 4-7/20-23, 8-11/24-27 and 12-15/28-31
+        __m256i sum[4] = { zero, zero, zero, zero };
+        for (int line = 0; line < mcCount; line += 2)
+        {
+            const int next = qMin(line + 1, mcCount - 1);
+            const qint32 next_weight =
+                (line + 1 < mcCount ? mcpWeights[line + 1] : 0);
+            const __m256i weights =
+                _mm256_set1_epi32((next_weight << 16) | mcpWeights[line]);
+            const __m256i first = _mm256_loadu_si256(
+                reinterpret_cast < const __m256i * >(mcpLines[line] + index));
+            const __m256i second = _mm256_loadu_si256(
+                reinterpret_cast < const __m256i * >(mcpLines[next] + index));
+            const __m256i low = _mm256_unpacklo_epi8(first, second);
+            const __m256i high = _mm256_unpackhi_epi8(first, second);
+            sum[0] = _mm256_add_epi32(sum[0],
+                _mm256_madd_epi16(_mm256_unpacklo_epi8(low, zero), weights));
+            sum[1] = _mm256_add_epi32(sum[1],
+                _mm256_madd_epi16(_mm256_unpackhi_epi8(low, zero), weights));
+            sum[2] = _mm256_add_epi32(sum[2],
+                _mm256_madd_epi16(_mm256_unpacklo_epi8(high, zero), weights));
+            sum[3] = _mm256_add_epi32(sum[3],
+                _mm256_madd_epi16(_mm256_unpackhi_epi8(high, zero), weights));
+        }
+        for (int part = 0; part < 4; part++)
+        {
+            sum[part] = _mm256_srai_epi32(
+                _mm256_add_epi32(sum[part], rounding), VERTICAL_SHIFT);
+        }
+
+        // Packing gives values 0-7/16-23 and 8-15/24-31; put the halves
+        // back in order
+        const __m256i packed_low = _mm256_packs_epi32(sum[0], sum[1]);
+        const __m256i packed_high = _mm256_packs_epi32(sum[2], sum[3]);
+        __m256i * output = reinterpret_cast < __m256i * >(mpOutput + index);
+        _mm256_storeu_si256(output,
+            _mm256_permute2x128_si256(packed_low, packed_high, 0x20));
+        _mm256_storeu_si256(output + 1,
+            _mm256_permute2x128_si256(packed_low, packed_high, 0x31));
+    }
+
+    // Rest (up to 7 pixels)
+    if (index < mcNumValues)
+    {
+        QVarLengthArray < const uchar *, 64 > lines(mcCount);
+        for (int line = 0; line < mcCount; line++)
+        {
+            lines[line] = mcpLines[line] + index;
+        }
+        Vertical_SSE2(lines.constData(), mcpWeights, mcCount,
+            mcNumValues - index, mpOutput + index);
+    }
+}
+#endif
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Never to be instanciated
+ImageScaler::ImageScaler()
+{
+    CALL_IN("");
+
+    // Nothing to do.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ImageScaler::~ImageScaler()
+{
+    CALL_IN("");
+
+    // Nothing to do, either.
+
+    CALL_OUT("");
+}
+
+
+
+// ==================================================================== Scaling
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if an implementation can be used on this CPU
+bool ImageScaler::IsAvailable(const Implementation mcImplementation)
+{
+    CALL_IN(QString("mcImplementation=%1")
+        .arg(CALL_SHOW(int(mcImplementation))));
+
+    bool is_available = false;
+    switch (mcImplementation)
+    {
+    case Implementation_Automatic:
+    case Implementation_Scalar:
+        is_available = true;
+        break;
+
+    case Implementation_SSE2:
+#ifdef IMAGESCALER_SSE2
+        is_available = true;
+#endif
+        break;
+
+    case Implementation_AVX2:
+#ifdef IMAGESCALER_AVX2
+        is_available = __builtin_cpu_supports("avx2");
+#endif
+        break;
+    }
+
+    CALL_OUT("");
+    return is_available;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Name of an implementation
+QString ImageScaler::GetImplementationName(
+    const Implementation mcImplementation)
+{
+    CALL_IN(QString("mcImplementation=%1")
+        .arg(CALL_SHOW(int(mcImplementation))));
+
+    QString name;
+    switch (mcImplementation)
+    {
+    case Implementation_Automatic:
+        name = "automatic";
+        break;
+
+    case Implementation_Scalar:
+        name = "scalar";
+        break;
+
+    case Implementation_SSE2:
+        name = "SSE2";
+        break;
+
+    case Implementation_AVX2:
+        name = "AVX2";
+        break;
+    }
+
+    CALL_OUT("");
+    return name;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Best implementation for this CPU
+ImageScaler::Implementation ImageScaler::GetBestImplementation()
+{
+    CALL_IN("");
+
+    // CPU doesn't change while we're running
+    static const Implementation best =
+        IsAvailable(Implementation_AVX2) ? Implementation_AVX2
+        : IsAvailable(Implementation_SSE2) ? Implementation_SSE2
+        : Implementation_Scalar;
+
+    CALL_OUT("");
+    return best;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Scale down to fit into a square
+QImage ImageScaler::ScaleToFit(const QImage & mcrImage, const int mcSize,
+    const Implementation mcImplementation)
+{
+    CALL_IN(QString("mcrImage=%1, mcSize=%2, mcImplementation=%3")
+        .arg(CALL_SHOW(mcrImage),
+             CALL_SHOW(mcSize),
+             CALL_SHOW(int(mcImplementation))));
+
+    // Same size as Qt::KeepAspectRatio would give
+    const QSize size =
+        mcrImage.size().scaled(mcSize, mcSize, Qt::KeepAspectRatio);
+    const QImage image = ScaleDown(mcrImage, size, mcImplementation);
+
+    CALL_OUT("");
+    return image;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Scale down to a given size
+QImage ImageScaler::ScaleDown(const QImage & mcrImage, const QSize & mcrSize,
+    const Implementation mcImplementation)
+{
+    CALL_IN(QString("mcrImage=%1, mcrSize=%2, mcImplementation=%3")
+        .arg(CALL_SHOW(mcrImage),
+             QString("%1x%2").arg(QString::number(mcrSize.width()),
+                QString::number(mcrSize.height())),
+             CALL_SHOW(int(mcImplementation))));
+
+    // Nothing to scale
+    if (mcrImage.isNull() ||
+        mcrSize.isEmpty())
+    {
+        CALL_OUT("");
+        return QImage();
+    }
+
+    // Area averaging only works for making images smaller
+    if (mcrSize.width() > mcrImage.width() ||
+        mcrSize.height() > mcrImage.height())
+    {
+        const QImage image = mcrImage.scaled(mcrSize,
+            Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+            .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        CALL_OUT("");
+        return image;
+    }
+
+    // Pick kernels
+    Implementation implementation = mcImplementation;
+    if (implementation == Implementation_Automatic ||
+        !IsAvailable(implementation))
+    {
+        implementation = GetBestImplementation();
+    }
+    VerticalKernel vertical = &Vertical_Scalar;
+    HorizontalKernel horizontal = &Horizontal_Scalar;
+#ifdef IMAGESCALER_SSE2
+    if (implementation == Implementation_SSE2)
+    {
+        vertical = &Vertical_SSE2;
+        horizontal = &Horizontal_SSE2;
+    }
+#endif
+#ifdef IMAGESCALER_AVX2
+    if (implementation == Implementation_AVX2)
+    {
+        // Horizontal pass reads a single pixel per step; SSE2 is as good
+        // as it gets there
+        vertical = &Vertical_AVX2;
+        horizontal = &Horizontal_SSE2;
+    }
+#endif
+
+    // Averaging premultiplied pixels gets transparency right
+    const QImage source =
+        mcrImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const int source_width = source.width();
+    const int source_height = source.height();
+    const int target_width = mcrSize.width();
+    const int target_height = mcrSize.height();
+
+    // Filters
+    QList < int > first_column;
+    QList < int > column_count;
+    QList < qint32 > column_weights;
+    GetFilter(source_width, target_width, first_column, column_count,
+        column_weights);
+    QList < int > first_row;
+    QList < int > row_count;
+    QList < qint32 > row_weights;
+    GetFilter(source_height, target_height, first_row, row_count,
+        row_weights);
+
+    // Vertical and horizontal pass row by row, so the intermediate row
+    // stays in the cache
+    QImage target(mcrSize, QImage::Format_ARGB32_Premultiplied);
+    QList < qint16 > intermediate(4 * source_width);
+    QVarLengthArray < const uchar *, 64 > lines;
+    const qint32 * weights = row_weights.constData();
+    for (int row = 0; row < target_height; row++)
+    {
+        const int count = row_count[row];
+        lines.resize(count);
+        for (int line = 0; line < count; line++)
+        {
+            lines[line] = source.constScanLine(first_row[row] + line);
+        }
+        vertical(lines.constData(), weights, count, 4 * source_width,
+            intermediate.data());
+        weights += count;
+        horizontal(intermediate.constData(), target_width,
+            first_column.constData(), column_count.constData(),
+            column_weights.constData(), target.scanLine(row));
+    }
+
+    CALL_OUT("");
+    return target;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Source pixels covered by each target pixel
+void ImageScaler::GetFilter(const int mcSourceSize, const int mcTargetSize,
+    QList < int > & mrFirst, QList < int > & mrCount,
+    QList < qint32 > & mrWeights)
+{
+    CALL_IN(QString("mcSourceSize=%1, mcTargetSize=%2, mrFirst=%3, "
+        "mrCount=%4, mrWeights=%5")
+        .arg(CALL_SHOW(mcSourceSize),
+             CALL_SHOW(mcTargetSize),
+             CALL_SHOW(mrFirst),
+             CALL_SHOW(mrCount),
+             CALL_SHOW(mrWeights)));
+
+    mrFirst.clear();
+    mrCount.clear();
+    mrWeights.clear();
+
+    // Target pixel covers [start, end) in source pixels; each source pixel
+    // is weighted by how much of it is covered
+    const double scale = double(mcSourceSize) / mcTargetSize;
+    const qint32 one = 1 << WEIGHT_BITS;
+    for (int target = 0; target < mcTargetSize; target++)
+    {
+        const double start = target * scale;
+        const double end = qMin((target + 1) * scale, double(mcSourceSize));
+        const int first = int(std::floor(start));
+        const int last = qMin(int(std::ceil(end)) - 1, mcSourceSize - 1);
+        qint32 total = 0;
+        int largest = mrWeights.size();
+        for (int source = first; source <= last; source++)
+        {
+            const double coverage =
+                qMin(end, source + 1.0) - qMax(start, double(source));
+            const qint32 weight = qint32(std::lround(coverage / scale * one));
+            if (weight > mrWeights.value(largest, -1))
+            {
+                largest = mrWeights.size();
+            }
+            mrWeights << weight;
+            total += weight;
+        }
+
+        // Rounding errors go to the largest weight, so weights add up to
+        // exactly one
+        mrWeights[largest] += one - total;
+        mrFirst << first;
+        mrCount << last - first + 1;
+    }
+
+    CALL_OUT("");
+}
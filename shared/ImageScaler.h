@@ -0,0 +1,71 @@
+// ImageScaler.h
+// Class definition file
+
+// Scales images down by area averaging (box filter): every target pixel is
+// the average of the source pixels it covers. Works on premultiplied
+// ARGB32 with integer weights, using AVX2 or SSE2 where the CPU has them
+// and a scalar fallback otherwise. All implementations give identical
+// results. Scaling up is left to Qt.
+
+// Just include once
+#ifndef IMAGESCALER_H
+#define IMAGESCALER_H
+
+// Qt includes
+#include <QImage>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+// Class definition
+class ImageScaler
+{
+    // ============================================================== Lifecycle
+private:
+    // Never to be instanciated
+    ImageScaler();
+
+public:
+    // Destructor
+    ~ImageScaler();
+
+
+
+    // ================================================================ Scaling
+public:
+    // Available implementations
+    enum Implementation
+    {
+        Implementation_Automatic,
+        Implementation_Scalar,
+        Implementation_SSE2,
+        Implementation_AVX2
+    };
+
+    // Check if an implementation can be used on this CPU
+    static bool IsAvailable(const Implementation mcImplementation);
+
+    // Name of an implementation
+    static QString GetImplementationName(
+        const Implementation mcImplementation);
+
+    // Scale down to fit into a square (keeps the aspect ratio)
+    static QImage ScaleToFit(const QImage & mcrImage, const int mcSize,
+        const Implementation mcImplementation = Implementation_Automatic);
+
+    // Scale down to a given size (result is premultiplied ARGB32)
+    static QImage ScaleDown(const QImage & mcrImage, const QSize & mcrSize,
+        const Implementation mcImplementation = Implementation_Automatic);
+
+private:
+    // Best implementation for this CPU
+    static Implementation GetBestImplementation();
+
+    // Source pixels covered by each target pixel (first source pixel,
+    // number of source pixels, and their weights one after the other)
+    static void GetFilter(const int mcSourceSize, const int mcTargetSize,
+        QList < int > & mrFirst, QList < int > & mrCount,
+        QList < qint32 > & mrWeights);
+};
+
+#endif
@@ -0,0 +1,189 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// StringPool.cpp
+// Class implementation file
+
+// Project includes
+#include "CallTracer.h"
+#include "StringPool.h"
+
+// Qt includes
+#include <QDebug>
+#include <QObject>
+#include <QReadLocker>
+#include <QWriteLocker>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Never to be instanciated
+StringPool::StringPool()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+StringPool::~StringPool()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+// ================================================================== Interning
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Shared copy of a string
+QString StringPool::Intern(const QString & mcrText)
+{
+    CALL_IN_LAZY(QString("mcrText=%1")
+        .arg(CALL_SHOW(mcrText)));
+
+    // Not worth it
+    if (mcrText.isEmpty() ||
+        mcrText.size() > m_MaxLength)
+    {
+        CALL_OUT("");
+        return mcrText;
+    }
+
+    // Known string (readers don't block each other); the caller's copy
+    // can go away once it uses ours
+    {
+        QReadLocker read_lock(&m_Lock);
+        const auto pool_iterator = m_Pool.constFind(mcrText);
+        if (pool_iterator != m_Pool.constEnd())
+        {
+            if (pool_iterator -> constData() != mcrText.constData())
+            {
+                m_SavedBytes += mcrText.size() * qint64(sizeof(QChar));
+            }
+            const QString pooled = *pool_iterator;
+            CALL_OUT("");
+            return pooled;
+        }
+    }
+
+    // New string (unless another thread added it in the meantime)
+    QWriteLocker write_lock(&m_Lock);
+    const auto pool_iterator = m_Pool.constFind(mcrText);
+    if (pool_iterator == m_Pool.constEnd())
+    {
+        m_Pool.insert(mcrText);
+        CALL_OUT("");
+        return mcrText;
+    }
+    if (pool_iterator -> constData() != mcrText.constData())
+    {
+        m_SavedBytes += mcrText.size() * qint64(sizeof(QChar));
+    }
+
+    CALL_OUT("");
+    return *pool_iterator;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Maximum length of pooled strings
+const int StringPool::m_MaxLength = 32;
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Pool
+QSet < QString > StringPool::m_Pool;
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Protects the pool
+QReadWriteLock StringPool::m_Lock;
+
+
+
+// ================================================================= Statistics
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of strings in the pool
+int StringPool::GetSize()
+{
+    CALL_IN("");
+
+    QReadLocker read_lock(&m_Lock);
+    const int size = m_Pool.size();
+
+    CALL_OUT("");
+    return size;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory saved
+qint64 StringPool::GetSavedBytes()
+{
+    CALL_IN("");
+
+    const qint64 saved_bytes = m_SavedBytes;
+
+    CALL_OUT("");
+    return saved_bytes;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Show statistics
+void StringPool::ShowStatistics()
+{
+    CALL_IN("");
+
+    qDebug().noquote() << QObject::tr("String pool: %1 strings, "
+        "approx. %2 kB saved")
+        .arg(QString::number(GetSize()),
+             QString::number(GetSavedBytes() / 1024));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory saved
+std::atomic < qint64 > StringPool::m_SavedBytes(0);
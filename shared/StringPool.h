@@ -0,0 +1,66 @@
+// StringPool.h
+// Class definition file
+
+// Keeps one shared copy of strings that show up over and over again (keys
+// like "first_name", values like "false" or "private"). QString is
+// implicitly shared, so everybody using the pooled copy uses the same
+// memory. Thread-safe; strings that are in the pool already (which is most
+// of them) can be looked up by several threads at the same time.
+
+// Just include once
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+// Qt includes
+#include <QReadWriteLock>
+#include <QSet>
+#include <QString>
+
+// System includes
+#include <atomic>
+
+// Class definition
+class StringPool
+{
+    // ============================================================== Lifecycle
+private:
+    // Never to be instanciated
+    StringPool();
+
+public:
+    // Destructor
+    ~StringPool();
+
+
+
+    // ============================================================== Interning
+public:
+    // Shared copy of a string (long strings are returned as they are)
+    static QString Intern(const QString & mcrText);
+
+private:
+    // Longer strings are hardly ever repeated
+    static const int m_MaxLength;
+
+    // Pool
+    static QSet < QString > m_Pool;
+    static QReadWriteLock m_Lock;
+
+
+
+    // ============================================================= Statistics
+public:
+    // Number of strings in the pool
+    static int GetSize();
+
+    // Memory saved (approximately; only counts the string data)
+    static qint64 GetSavedBytes();
+
+    // Show statistics
+    static void ShowStatistics();
+
+private:
+    static std::atomic < qint64 > m_SavedBytes;
+};
+
+#endif
@@ -0,0 +1,658 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// ZIPWriter.cpp
+// Class implementation file
+
+// Project includes
+#include "CallTracer.h"
+#include "MessageLogger.h"
+#include "ZIPWriter.h"
+
+// Qt includes
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QtConcurrent>
+#include <QtEndian>
+
+// System includes
+#include <zlib.h>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+ZIPWriter::ZIPWriter(const QString & mcrFilename) :
+    m_Filename(mcrFilename),
+    m_File(mcrFilename),
+    m_IsOpen(false)
+{
+    CALL_IN(QString("mcrFilename=%1")
+        .arg(CALL_SHOW(mcrFilename)));
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ZIPWriter::~ZIPWriter()
+{
+    CALL_IN("");
+
+    // Archive that has not been closed is incomplete
+    if (m_IsOpen)
+    {
+        m_File.cancelWriting();
+    }
+
+    CALL_OUT("");
+}
+
+
+
+// ==================================================================== Entries
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compress data for an entry
+ZIPWriter::Entry ZIPWriter::PrepareEntry(const QString & mcrName,
+    const QByteArray & mcrData, const int mcLevel,
+    const QDateTime & mcrModified)
+{
+    CALL_IN_LAZY(
+        QString("mcrName=%1, mcrData=%2, mcLevel=%3, mcrModified=%4")
+        .arg(CALL_SHOW(mcrName),
+             CALL_SHOW(mcrData),
+             CALL_SHOW(mcLevel),
+             CALL_SHOW(mcrModified)));
+
+    Entry entry;
+    entry.m_Name = mcrName;
+    entry.m_CRC32 = ComputeCRC32(mcrData);
+    entry.m_Size = quint32(mcrData.size());
+
+    // MS-DOS date and time (2 second resolution, years from 1980)
+    const QDate date = mcrModified.date();
+    const QTime time = mcrModified.time();
+    entry.m_DOSTime = quint16((time.hour() << 11) |
+        (time.minute() << 5) |
+        (time.second() / 2));
+    entry.m_DOSDate = quint16((qMax(date.year() - 1980, 0) << 9) |
+        (date.month() << 5) |
+        date.day());
+
+    // Don't bother compressing what's compressed already
+    const QString extension = mcrName.section('.', -1).toLower();
+    const bool is_compressed = mcrName.contains('.') &&
+        m_CompressedExtensions.contains(extension);
+
+    // qCompress() returns the uncompressed size (4 bytes), a zlib header
+    // (2 bytes), the raw deflate stream ZIP wants, and an Adler-32
+    // checksum (4 bytes).
+    if (mcLevel > 0 &&
+        !is_compressed)
+    {
+        const QByteArray compressed = qCompress(mcrData, qMin(mcLevel, 9));
+        if (compressed.size() > 10 &&
+            compressed.size() - 10 < mcrData.size())
+        {
+            entry.m_Method = Method_Deflated;
+            entry.m_CompressedData = compressed.mid(6,
+                compressed.size() - 10);
+            CALL_OUT("");
+            return entry;
+        }
+    }
+
+    // Store
+    entry.m_Method = Method_Stored;
+    entry.m_CompressedData = mcrData;
+
+    CALL_OUT("");
+    return entry;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read files on disk and compress them in parallel
+bool ZIPWriter::PrepareEntriesFromDisk(
+    const QList < QPair < QString, QString > > & mcrNamesAndFilenames,
+    QList < Entry > & mrEntries, const int mcLevel)
+{
+    CALL_IN(QString("mcrNamesAndFilenames=%1, mrEntries=%2, mcLevel=%3")
+        .arg("...",
+             "...",
+             CALL_SHOW(mcLevel)));
+
+    // Read files (one after the other; it's the same disk)
+    struct Input
+    {
+        QString m_Name;
+        QByteArray m_Data;
+        QDateTime m_Modified;
+    };
+    QList < Input > inputs;
+    inputs.reserve(mcrNamesAndFilenames.size());
+    for (const QPair < QString, QString > & name_and_filename :
+        mcrNamesAndFilenames)
+    {
+        Input input;
+        input.m_Name = name_and_filename.first;
+        if (!ReadFile(name_and_filename.second, input.m_Data,
+            input.m_Modified))
+        {
+            // Error has been reported elsewhere.
+            CALL_OUT("");
+            return false;
+        }
+        inputs << input;
+    }
+
+    // Compress them in parallel
+    auto prepare_entry = [mcLevel](const Input & mcrInput)
+    {
+        return PrepareEntry(mcrInput.m_Name, mcrInput.m_Data, mcLevel,
+            mcrInput.m_Modified);
+    };
+    mrEntries = QtConcurrent::blockingMapped < QList < Entry > >(inputs,
+        prepare_entry);
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// CRC-32 of some data
+quint32 ZIPWriter::ComputeCRC32(const QByteArray & mcrData)
+{
+    CALL_IN_LAZY(QString("mcrData=%1")
+        .arg(CALL_SHOW(mcrData)));
+
+    // zlib's (same polynomial as ZIP)
+    const quint32 crc = quint32(::crc32(::crc32(0L, Z_NULL, 0),
+        reinterpret_cast < const Bytef * >(mcrData.constData()),
+        uInt(mcrData.size())));
+
+    CALL_OUT("");
+    return crc;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read the entries of an existing archive
+bool ZIPWriter::ReadEntries(const QString & mcrFilename,
+    QHash < QString, Entry > & mrEntries)
+{
+    CALL_IN(QString("mcrFilename=%1, mrEntries=%2")
+        .arg(CALL_SHOW(mcrFilename),
+             "..."));
+
+    // Whole archive
+    QFile in_file(mcrFilename);
+    if (!in_file.open(QIODevice::ReadOnly))
+    {
+        const QString reason =
+            QObject::tr("ZIP file \"%1\" could not be opened.")
+                .arg(mcrFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    const QByteArray archive = in_file.readAll();
+    in_file.close();
+    const char * data = archive.constData();
+    auto read_uint16 = [data](const qint64 mcOffset)
+    {
+        return qFromLittleEndian < quint16 >(data + mcOffset);
+    };
+    auto read_uint32 = [data](const qint64 mcOffset)
+    {
+        return qFromLittleEndian < quint32 >(data + mcOffset);
+    };
+
+    // End of central directory record (no archive comment)
+    const qint64 end_offset = archive.size() - 22;
+    if (end_offset < 0 ||
+        read_uint32(end_offset) != 0x06054B50)
+    {
+        const QString reason =
+            QObject::tr("\"%1\" is not a ZIP file written by us.")
+                .arg(mcrFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    const int number_of_entries = read_uint16(end_offset + 10);
+    qint64 offset = read_uint32(end_offset + 16);
+
+    // Central directory
+    mrEntries.clear();
+    for (int index = 0; index < number_of_entries; index++)
+    {
+        if (offset + 46 > end_offset ||
+            read_uint32(offset) != 0x02014B50)
+        {
+            const QString reason =
+                QObject::tr("Central directory of ZIP file \"%1\" is "
+                    "damaged.")
+                    .arg(mcrFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        Entry entry;
+        entry.m_Method = Method(read_uint16(offset + 10));
+        entry.m_DOSTime = read_uint16(offset + 12);
+        entry.m_DOSDate = read_uint16(offset + 14);
+        entry.m_CRC32 = read_uint32(offset + 16);
+        const qint64 compressed_size = read_uint32(offset + 20);
+        entry.m_Size = read_uint32(offset + 24);
+        const int name_length = read_uint16(offset + 28);
+        const int extra_length = read_uint16(offset + 30);
+        const int comment_length = read_uint16(offset + 32);
+        const qint64 local_offset = read_uint32(offset + 42);
+        if (offset + 46 + name_length > end_offset)
+        {
+            const QString reason =
+                QObject::tr("Central directory of ZIP file \"%1\" is "
+                    "damaged.")
+                    .arg(mcrFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        entry.m_Name = QString::fromUtf8(data + offset + 46, name_length);
+        offset += 46 + name_length + extra_length + comment_length;
+
+        // Data follows the local file header
+        if (local_offset + 30 > end_offset ||
+            read_uint32(local_offset) != 0x04034B50)
+        {
+            const QString reason =
+                QObject::tr("Entry \"%1\" of ZIP file \"%2\" is damaged.")
+                    .arg(entry.m_Name,
+                         mcrFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        const qint64 data_offset = local_offset + 30 +
+            read_uint16(local_offset + 26) + read_uint16(local_offset + 28);
+        if (data_offset + compressed_size > end_offset)
+        {
+            const QString reason =
+                QObject::tr("Entry \"%1\" of ZIP file \"%2\" is damaged.")
+                    .arg(entry.m_Name,
+                         mcrFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        entry.m_CompressedData = archive.mid(data_offset, compressed_size);
+        mrEntries[entry.m_Name] = entry;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// File name extensions of formats that are compressed already (Telegram
+// stickers are WebP or WebM). Animated stickers (.tgs) are gzipped as
+// well, but deflating them again often saves a little; that is left to
+// the size check.
+const QStringList ZIPWriter::m_CompressedExtensions =
+{
+    "gif", "gz", "jpeg", "jpg", "mp3", "mp4", "png", "webm", "webp", "zip"
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read file
+bool ZIPWriter::ReadFile(const QString & mcrFilename, QByteArray & mrData,
+    QDateTime & mrModified)
+{
+    CALL_IN(QString("mcrFilename=%1, mrData=%2, mrModified=%3")
+        .arg(CALL_SHOW(mcrFilename),
+             "...",
+             "..."));
+
+    QFile in_file(mcrFilename);
+    if (!in_file.open(QIODevice::ReadOnly))
+    {
+        const QString reason =
+            QObject::tr("File \"%1\" could not be opened.")
+                .arg(mcrFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    mrData = in_file.readAll();
+    in_file.close();
+    mrModified = QFileInfo(mcrFilename).lastModified();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+// ==================================================================== Writing
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Little endian numbers
+static void AppendUInt16(QByteArray & mrData, const quint16 mcValue)
+{
+    const quint16 value = qToLittleEndian(mcValue);
+    mrData.append(reinterpret_cast < const char * >(&value), sizeof(value));
+}
+
+static void AppendUInt32(QByteArray & mrData, const quint32 mcValue)
+{
+    const quint32 value = qToLittleEndian(mcValue);
+    mrData.append(reinterpret_cast < const char * >(&value), sizeof(value));
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Open archive for writing
+bool ZIPWriter::Open()
+{
+    CALL_IN("");
+
+    if (m_IsOpen)
+    {
+        const QString reason =
+            QObject::tr("ZIP file \"%1\" is already open.")
+                .arg(m_Filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    if (!m_File.open(QIODevice::WriteOnly))
+    {
+        const QString reason =
+            QObject::tr("ZIP file \"%1\" could not be opened: %2")
+                .arg(m_Filename,
+                     m_File.errorString());
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    m_IsOpen = true;
+    m_CentralDirectory.clear();
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add entry
+bool ZIPWriter::AddEntry(const Entry & mcrEntry)
+{
+    CALL_IN(QString("mcrEntry=%1")
+        .arg(CALL_SHOW(mcrEntry.m_Name)));
+
+    if (!m_IsOpen)
+    {
+        const QString reason =
+            QObject::tr("ZIP file \"%1\" is not open.")
+                .arg(m_Filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // No ZIP64
+    const QByteArray name = mcrEntry.m_Name.toUtf8();
+    const qint64 offset = m_File.pos();
+    if (m_CentralDirectory.size() >= 0xFFFF ||
+        offset + 30 + name.size() + mcrEntry.m_CompressedData.size() >
+            qint64(0xFFFFFFFFu))
+    {
+        const QString reason =
+            QObject::tr("ZIP file \"%1\" is getting too large for \"%2\".")
+                .arg(m_Filename,
+                     mcrEntry.m_Name);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Local file header; names are UTF-8 (flag bit 11)
+    QByteArray header;
+    AppendUInt32(header, 0x04034B50);
+    AppendUInt16(header, 20);
+    AppendUInt16(header, 0x0800);
+    AppendUInt16(header, mcrEntry.m_Method);
+    AppendUInt16(header, mcrEntry.m_DOSTime);
+    AppendUInt16(header, mcrEntry.m_DOSDate);
+    AppendUInt32(header, mcrEntry.m_CRC32);
+    AppendUInt32(header, quint32(mcrEntry.m_CompressedData.size()));
+    AppendUInt32(header, mcrEntry.m_Size);
+    AppendUInt16(header, quint16(name.size()));
+    AppendUInt16(header, 0);
+    header.append(name);
+    if (m_File.write(header) != header.size() ||
+        m_File.write(mcrEntry.m_CompressedData) !=
+            mcrEntry.m_CompressedData.size())
+    {
+        const QString reason =
+            QObject::tr("Could not write \"%1\" to ZIP file \"%2\": %3")
+                .arg(mcrEntry.m_Name,
+                     m_Filename,
+                     m_File.errorString());
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Remember for central directory
+    CentralDirectoryEntry directory_entry;
+    directory_entry.m_Name = mcrEntry.m_Name;
+    directory_entry.m_Method = mcrEntry.m_Method;
+    directory_entry.m_CRC32 = mcrEntry.m_CRC32;
+    directory_entry.m_Size = mcrEntry.m_Size;
+    directory_entry.m_CompressedSize =
+        quint32(mcrEntry.m_CompressedData.size());
+    directory_entry.m_DOSTime = mcrEntry.m_DOSTime;
+    directory_entry.m_DOSDate = mcrEntry.m_DOSDate;
+    directory_entry.m_Offset = quint32(offset);
+    m_CentralDirectory << directory_entry;
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compress and add data
+bool ZIPWriter::AddFile(const QString & mcrName, const QByteArray & mcrData,
+    const int mcLevel)
+{
+    CALL_IN(QString("mcrName=%1, mcrData=%2, mcLevel=%3")
+        .arg(CALL_SHOW(mcrName),
+             CALL_SHOW(mcrData),
+             CALL_SHOW(mcLevel)));
+
+    const bool success = AddEntry(PrepareEntry(mcrName, mcrData, mcLevel));
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compress and add a file on disk
+bool ZIPWriter::AddFileFromDisk(const QString & mcrName,
+    const QString & mcrFilename, const int mcLevel)
+{
+    CALL_IN(QString("mcrName=%1, mcrFilename=%2, mcLevel=%3")
+        .arg(CALL_SHOW(mcrName),
+             CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcLevel)));
+
+    QByteArray data;
+    QDateTime modified;
+    if (!ReadFile(mcrFilename, data, modified))
+    {
+        // Error has been reported elsewhere.
+        CALL_OUT("");
+        return false;
+    }
+    const bool success =
+        AddEntry(PrepareEntry(mcrName, data, mcLevel, modified));
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compress files on disk in parallel and add them in order
+bool ZIPWriter::AddFilesFromDisk(
+    const QList < QPair < QString, QString > > & mcrNamesAndFilenames,
+    const int mcLevel)
+{
+    CALL_IN(QString("mcrNamesAndFilenames=%1, mcLevel=%2")
+        .arg("...",
+             CALL_SHOW(mcLevel)));
+
+    // Read and compress
+    QList < Entry > entries;
+    if (!PrepareEntriesFromDisk(mcrNamesAndFilenames, entries, mcLevel))
+    {
+        // Error has been reported elsewhere.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Write them in order
+    for (const Entry & entry : entries)
+    {
+        if (!AddEntry(entry))
+        {
+            // Error has been reported elsewhere.
+            CALL_OUT("");
+            return false;
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write central directory and save archive
+bool ZIPWriter::Close()
+{
+    CALL_IN("");
+
+    if (!m_IsOpen)
+    {
+        const QString reason =
+            QObject::tr("ZIP file \"%1\" is not open.")
+                .arg(m_Filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    m_IsOpen = false;
+
+    // Central directory
+    const quint32 directory_offset = quint32(m_File.pos());
+    QByteArray directory;
+    for (const CentralDirectoryEntry & entry : m_CentralDirectory)
+    {
+        const QByteArray name = entry.m_Name.toUtf8();
+        AppendUInt32(directory, 0x02014B50);
+        AppendUInt16(directory, 20);
+        AppendUInt16(directory, 20);
+        AppendUInt16(directory, 0x0800);
+        AppendUInt16(directory, entry.m_Method);
+        AppendUInt16(directory, entry.m_DOSTime);
+        AppendUInt16(directory, entry.m_DOSDate);
+        AppendUInt32(directory, entry.m_CRC32);
+        AppendUInt32(directory, entry.m_CompressedSize);
+        AppendUInt32(directory, entry.m_Size);
+        AppendUInt16(directory, quint16(name.size()));
+        AppendUInt16(directory, 0);
+        AppendUInt16(directory, 0);
+        AppendUInt16(directory, 0);
+        AppendUInt16(directory, 0);
+        AppendUInt32(directory, 0);
+        AppendUInt32(directory, entry.m_Offset);
+        directory.append(name);
+    }
+
+    // End of central directory record
+    const quint32 directory_size = quint32(directory.size());
+    const quint16 number_of_entries = quint16(m_CentralDirectory.size());
+    AppendUInt32(directory, 0x06054B50);
+    AppendUInt16(directory, 0);
+    AppendUInt16(directory, 0);
+    AppendUInt16(directory, number_of_entries);
+    AppendUInt16(directory, number_of_entries);
+    AppendUInt32(directory, directory_size);
+    AppendUInt32(directory, directory_offset);
+    AppendUInt16(directory, 0);
+
+    // Save
+    if (m_File.write(directory) != directory.size() ||
+        !m_File.commit())
+    {
+        const QString reason =
+            QObject::tr("Could not save ZIP file \"%1\": %2")
+                .arg(m_Filename,
+                     m_File.errorString());
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
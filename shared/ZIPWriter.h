@@ -0,0 +1,137 @@
+// ZIPWriter.h
+// Class definition file
+
+// Writes ZIP archives (stored and deflated entries, no ZIP64, so less than
+// 4 GB and 65535 entries). The archive only appears under its final name
+// once Close() succeeded; an archive that is not closed is discarded.
+// Entries are independent of each other, so several of them can be
+// compressed at the same time; they are written in the order they were
+// added.
+
+// Just include once
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+// Qt includes
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSaveFile>
+#include <QStringList>
+#include <QString>
+
+// Class definition
+class ZIPWriter
+{
+    // ============================================================== Lifecycle
+public:
+    // Constructor
+    ZIPWriter(const QString & mcrFilename);
+
+    // Destructor
+    ~ZIPWriter();
+
+
+
+    // ================================================================ Entries
+public:
+    // Compression methods (values as in the ZIP format)
+    enum Method
+    {
+        Method_Stored = 0,
+        Method_Deflated = 8
+    };
+
+    // Entry, compressed and ready to be written
+    struct Entry
+    {
+        QString m_Name;
+        Method m_Method;
+        quint32 m_CRC32;
+        quint32 m_Size;
+        QByteArray m_CompressedData;
+        quint16 m_DOSTime;
+        quint16 m_DOSDate;
+    };
+
+    // Compress data for an entry (level 0 stores; formats that are
+    // compressed already, and data deflating doesn't make smaller, are
+    // stored as well)
+    static Entry PrepareEntry(const QString & mcrName,
+        const QByteArray & mcrData, const int mcLevel = 9,
+        const QDateTime & mcrModified = QDateTime::currentDateTime());
+
+    // Read files on disk and compress them in parallel (entry name,
+    // filename)
+    static bool PrepareEntriesFromDisk(
+        const QList < QPair < QString, QString > > & mcrNamesAndFilenames,
+        QList < Entry > & mrEntries, const int mcLevel = 9);
+
+    // CRC-32 of some data (as used by ZIP)
+    static quint32 ComputeCRC32(const QByteArray & mcrData);
+
+    // Read the entries of an existing archive (name to entry), so they can
+    // be added to a new one without compressing them again. Only reads
+    // archives like the ones written here.
+    static bool ReadEntries(const QString & mcrFilename,
+        QHash < QString, Entry > & mrEntries);
+
+private:
+    // File name extensions of formats that are compressed already
+    static const QStringList m_CompressedExtensions;
+
+    // Read file
+    static bool ReadFile(const QString & mcrFilename, QByteArray & mrData,
+        QDateTime & mrModified);
+
+
+
+    // ================================================================ Writing
+public:
+    // Open archive for writing
+    bool Open();
+
+    // Add entry
+    bool AddEntry(const Entry & mcrEntry);
+
+    // Compress and add data
+    bool AddFile(const QString & mcrName, const QByteArray & mcrData,
+        const int mcLevel = 9);
+
+    // Compress and add a file on disk (keeps its modification time)
+    bool AddFileFromDisk(const QString & mcrName,
+        const QString & mcrFilename, const int mcLevel = 9);
+
+    // Compress files on disk in parallel and add them in order
+    // (entry name, filename)
+    bool AddFilesFromDisk(
+        const QList < QPair < QString, QString > > & mcrNamesAndFilenames,
+        const int mcLevel = 9);
+
+    // Write central directory and save archive
+    bool Close();
+
+private:
+    // Where the entries are in the archive
+    struct CentralDirectoryEntry
+    {
+        QString m_Name;
+        Method m_Method;
+        quint32 m_CRC32;
+        quint32 m_Size;
+        quint32 m_CompressedSize;
+        quint16 m_DOSTime;
+        quint16 m_DOSDate;
+        quint32 m_Offset;
+    };
+    QList < CentralDirectoryEntry > m_CentralDirectory;
+
+    // Archive file
+    QString m_Filename;
+    QSaveFile m_File;
+    bool m_IsOpen;
+};
+
+#endif
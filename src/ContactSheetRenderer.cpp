@@ -0,0 +1,496 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// ContactSheetRenderer.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Config.h"
+#include "ContactSheetRenderer.h"
+#include "ImageScaler.h"
+#include "MessageLogger.h"
+
+// Qt includes
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFont>
+#include <QImage>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+// Where scaled stickers are stored
+#define TILE_FILES (BOT_FILES + "Tiles/")
+
+// Where rendered sheets are stored
+#define SHEET_FILES (BOT_FILES + "Sheets/")
+
+// Memory used for scaled stickers (kB)
+#define TILE_CACHE_SIZE 64*1024
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+ContactSheetRenderer::ContactSheetRenderer()
+{
+    CALL_IN("");
+
+    // No jobs yet
+    m_NextJobID = 1;
+    m_NumJobs = 0;
+
+    // Tiles kept in memory (kB)
+    m_TileCache.setMaxCost(TILE_CACHE_SIZE);
+
+    // Create directories
+    QDir files("/");
+    if (!files.exists(TILE_FILES))
+    {
+        files.mkpath(TILE_FILES);
+    }
+    if (!files.exists(SHEET_FILES))
+    {
+        files.mkpath(SHEET_FILES);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ContactSheetRenderer::~ContactSheetRenderer()
+{
+    CALL_IN("");
+
+    // Let running jobs finish
+    m_ThreadPool.waitForDone();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instanciator
+ContactSheetRenderer * ContactSheetRenderer::Instance()
+{
+    CALL_IN("");
+
+    // Check if we already have an instance
+    if (!m_Instance)
+    {
+        // Nope. Create one.
+        m_Instance = new ContactSheetRenderer;
+    }
+
+    // Return instance
+    CALL_OUT("");
+    return m_Instance;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instance
+ContactSheetRenderer * ContactSheetRenderer::m_Instance = nullptr;
+
+
+
+// ===================================================================== Layout
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Dimensions (pixels)
+const int ContactSheetRenderer::m_MaxPixels = 20000000;
+const int ContactSheetRenderer::m_TileSize = 200;
+const int ContactSheetRenderer::m_FrameSize = 20;
+const int ContactSheetRenderer::m_Spacing = 20;
+const int ContactSheetRenderer::m_CaptionHeight = 20;
+const int ContactSheetRenderer::m_TitleHeight = 100;
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Size of a sheet
+QSize ContactSheetRenderer::GetSheetSize(const int mcRows,
+    const int mcColumns, const bool mcIsOverview)
+{
+    CALL_IN(QString("mcRows=%1, mcColumns=%2, mcIsOverview=%3")
+        .arg(CALL_SHOW(mcRows),
+             CALL_SHOW(mcColumns),
+             CALL_SHOW(mcIsOverview)));
+
+    const int width = m_FrameSize
+        + mcColumns * m_TileSize
+        + (mcColumns - 1) * m_Spacing
+        + m_FrameSize;
+    int height = m_FrameSize
+        + mcRows * m_TileSize
+        + (mcRows - 1) * m_Spacing
+        + m_FrameSize;
+    if (mcIsOverview)
+    {
+        height += mcRows * m_CaptionHeight;
+    } else
+    {
+        height += m_TitleHeight;
+    }
+
+    CALL_OUT("");
+    return QSize(width, height);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Identifies what a job renders
+QString ContactSheetRenderer::GetJobKey(const Job & mcrJob)
+{
+    CALL_IN(QString("mcrJob=%1")
+        .arg("..."));
+
+    // Anything that changes the sheets: layout, grid, title, and the
+    // stickers (file unique IDs change with a new sticker set version)
+    QStringList key_data;
+    key_data << QString("layout %1 %2 %3 %4 %5")
+        .arg(QString::number(m_TileSize),
+             QString::number(m_FrameSize),
+             QString::number(m_Spacing),
+             QString::number(m_CaptionHeight),
+             QString::number(m_TitleHeight));
+    key_data << QString("grid %1x%2")
+        .arg(QString::number(mcrJob.m_Columns),
+             QString::number(mcrJob.m_Rows));
+    if (mcrJob.m_IsOverview)
+    {
+        key_data << "overview";
+    } else
+    {
+        key_data << "title " + mcrJob.m_Title;
+    }
+    for (const Tile & tile : mcrJob.m_Tiles)
+    {
+        key_data << tile.m_UniqueID + "\t" + tile.m_Caption;
+    }
+    const QString key = QString::fromLatin1(
+        QCryptographicHash::hash(key_data.join("\n").toUtf8(),
+            QCryptographicHash::Sha1).toHex());
+
+    CALL_OUT("");
+    return key;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Where a rendered sheet is stored
+QString ContactSheetRenderer::GetSheetFilename(const QString & mcrKey,
+    const int mcNumber)
+{
+    CALL_IN(QString("mcrKey=%1, mcNumber=%2")
+        .arg(CALL_SHOW(mcrKey),
+             CALL_SHOW(mcNumber)));
+
+    const QString filename = SHEET_FILES + QString("Sheet %1-%2.png")
+        .arg(mcrKey,
+             QString::number(mcNumber));
+
+    CALL_OUT("");
+    return filename;
+}
+
+
+
+// ================================================================== Rendering
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start rendering
+qint64 ContactSheetRenderer::Render(const Job & mcrJob)
+{
+    CALL_IN(QString("mcrJob=%1")
+        .arg("..."));
+
+    // New job
+    Job job = mcrJob;
+    job.m_ID = m_NextJobID++;
+    job.m_Key = GetJobKey(job);
+    m_NumJobs.ref();
+
+    // Detach
+    QThreadPool * pool = &m_ThreadPool;
+    QtConcurrent::run(pool, [this, job]()
+        {
+            RenderJob(job);
+        });
+
+    CALL_OUT("");
+    return job.m_ID;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of jobs that haven't finished yet
+int ContactSheetRenderer::GetWorkListSize() const
+{
+    CALL_IN("");
+
+    const int size = m_NumJobs.loadAcquire();
+
+    CALL_OUT("");
+    return size;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Render job (runs on the thread pool)
+void ContactSheetRenderer::RenderJob(const Job & mcrJob)
+{
+    CALL_IN(QString("mcrJob=%1")
+        .arg("..."));
+
+    // Signals emitted here are queued for the thread the receivers live in
+
+    const QSize sheet_size =
+        GetSheetSize(mcrJob.m_Rows, mcrJob.m_Columns, mcrJob.m_IsOverview);
+    const int top = m_FrameSize + (mcrJob.m_IsOverview ? 0 : m_TitleHeight);
+    const int row_height = m_TileSize + m_Spacing +
+        (mcrJob.m_IsOverview ? m_CaptionHeight : 0);
+    const QFont title_font("Georgia", 70);
+
+    int row = 0;
+    int column = 0;
+    int num_sheets = 0;
+    int num_tiles = 0;
+    int num_skipped = 0;
+    QImage sheet;
+    QPainter painter;
+    const int tiles_per_sheet = mcrJob.m_Rows * mcrJob.m_Columns;
+    for (int first = 0; first < mcrJob.m_Tiles.size();
+        first += tiles_per_sheet)
+    {
+        // Decode and scale a sheet's worth of tiles in parallel. This uses
+        // the global thread pool: the job itself already occupies a thread
+        // in ours, and only one sheet's tiles are held in memory.
+        const QList < Tile > batch =
+            mcrJob.m_Tiles.mid(first, tiles_per_sheet);
+        const QList < QImage > images =
+            QtConcurrent::blockingMapped < QList < QImage > >(batch,
+                [this](const Tile & mcrTile)
+                {
+                    return LoadTile(mcrTile);
+                });
+
+        // Composite
+        for (int index = 0; index < batch.size(); index++)
+        {
+            const QImage & image = images[index];
+            if (image.isNull())
+            {
+                num_skipped++;
+                continue;
+            }
+
+            // New sheet
+            if (row == 0 &&
+                column == 0)
+            {
+                sheet =
+                    QImage(sheet_size, QImage::Format_ARGB32_Premultiplied);
+                sheet.fill(Qt::white);
+                painter.begin(&sheet);
+                if (!mcrJob.m_IsOverview)
+                {
+                    painter.setFont(title_font);
+                    painter.drawText(0, m_FrameSize, sheet_size.width(),
+                        m_TitleHeight, Qt::AlignCenter, mcrJob.m_Title);
+                    painter.setFont(QFont());
+                }
+            }
+
+            // Render
+            const int base_x =
+                m_FrameSize + column * (m_TileSize + m_Spacing);
+            const int base_y = top + row * row_height;
+            painter.drawImage(base_x + (m_TileSize - image.width())/2,
+                base_y + (m_TileSize - image.height())/2, image);
+            if (mcrJob.m_IsOverview)
+            {
+                painter.drawText(base_x, base_y + m_TileSize + 2,
+                    m_TileSize, 15, Qt::AlignCenter, batch[index].m_Caption);
+            }
+            num_tiles++;
+
+            // Next position; save sheet once it's full
+            column++;
+            if (column == mcrJob.m_Columns)
+            {
+                column = 0;
+                row++;
+            }
+            if (row == mcrJob.m_Rows)
+            {
+                painter.end();
+                num_sheets++;
+                SaveSheet(mcrJob, num_sheets, sheet);
+                row = 0;
+                column = 0;
+            }
+        }
+    }
+
+    // Last sheet (if it isn't full)
+    if (painter.isActive())
+    {
+        painter.end();
+        num_sheets++;
+        SaveSheet(mcrJob, num_sheets, sheet);
+    }
+
+    // Done
+    m_NumJobs.deref();
+    emit JobFinished(mcrJob.m_ID, mcrJob.m_ChatID, num_sheets, num_tiles,
+        num_skipped);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read and scale a sticker (runs on the global thread pool)
+QImage ContactSheetRenderer::LoadTile(const Tile & mcrTile)
+{
+    CALL_IN(QString("mcrTile=%1")
+        .arg("..."));
+
+    // Memory cache
+    const QString key = QString("%1_%2")
+        .arg(mcrTile.m_UniqueID,
+             QString::number(m_TileSize));
+    const bool use_cache = !mcrTile.m_UniqueID.isEmpty();
+    if (use_cache)
+    {
+        QMutexLocker locker(&m_TileCacheMutex);
+        if (QImage * cached = m_TileCache.object(key))
+        {
+            const QImage image = *cached;
+            CALL_OUT("");
+            return image;
+        }
+    }
+
+    // Disk cache
+    const QString cache_filename = TILE_FILES + key + ".png";
+    QImage image;
+    if (use_cache &&
+        QFile::exists(cache_filename))
+    {
+        image = QImage(cache_filename, "PNG");
+    }
+
+    if (image.isNull())
+    {
+        // This will fail for animated stickers (we can't read their file
+        // format); a null image is returned then
+        QFile in_file(mcrTile.m_Filename);
+        if (!in_file.open(QIODevice::ReadOnly))
+        {
+            CALL_OUT("");
+            return QImage();
+        }
+        image = QImage::fromData(in_file.readAll());
+        if (image.isNull())
+        {
+            CALL_OUT("");
+            return QImage();
+        }
+        image = ImageScaler::ScaleToFit(image, m_TileSize);
+
+        // Tile only appears on disk once it's complete (other jobs may be
+        // reading it)
+        if (use_cache)
+        {
+            QSaveFile out_file(cache_filename);
+            if (!out_file.open(QIODevice::WriteOnly) ||
+                !image.save(&out_file, "PNG") ||
+                !out_file.commit())
+            {
+                const QString reason = tr("Could not save tile \"%1\".")
+                    .arg(cache_filename);
+                MessageLogger::Error(CALL_METHOD, reason);
+            }
+        }
+    }
+
+    if (use_cache)
+    {
+        // Cost is in kB
+        QMutexLocker locker(&m_TileCacheMutex);
+        m_TileCache.insert(key, new QImage(image),
+            int(image.sizeInBytes() / 1024));
+    }
+
+    CALL_OUT("");
+    return image;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Save a finished sheet (runs on the thread pool)
+void ContactSheetRenderer::SaveSheet(const Job & mcrJob, const int mcNumber,
+    const QImage & mcrSheet)
+{
+    CALL_IN(QString("mcrJob=%1, mcNumber=%2, mcrSheet=%3")
+        .arg("...",
+             CALL_SHOW(mcNumber),
+             "..."));
+
+    // Sheets are kept (by job key) for identical requests; they only
+    // appear once complete, as identical jobs may run at the same time
+    const QString filename = GetSheetFilename(mcrJob.m_Key, mcNumber);
+    QSaveFile out_file(filename);
+    if (!out_file.open(QIODevice::WriteOnly) ||
+        !mcrSheet.save(&out_file, "PNG") ||
+        !out_file.commit())
+    {
+        const QString reason = tr("Could not save contact sheet \"%1\".")
+            .arg(filename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+    emit SheetRendered(mcrJob.m_ID, mcrJob.m_ChatID, mcNumber, filename);
+
+    CALL_OUT("");
+}
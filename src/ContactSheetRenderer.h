@@ -0,0 +1,139 @@
+// ContactSheetRenderer.h
+// Class definition
+
+// Renders contact sheets (stickers on a grid, saved as PNG files) on a
+// thread pool of its own, so neither the GUI nor polling for updates has
+// to wait for them. Several jobs can run at the same time. Rendering uses
+// QImage, which (unlike QPixmap) can be used outside the GUI thread.
+// Finished sheets are reported through signals, in the thread the
+// renderer lives in.
+
+#ifndef CONTACTSHEETRENDERER_H
+#define CONTACTSHEETRENDERER_H
+
+// Qt includes
+#include <QAtomicInt>
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+
+
+
+// Class definition
+class ContactSheetRenderer
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+private:
+    // Constructor
+    ContactSheetRenderer();
+
+public:
+    // Destructor
+    virtual ~ContactSheetRenderer();
+
+    // Instanciator
+    static ContactSheetRenderer * Instance();
+
+private:
+    // Instance
+    static ContactSheetRenderer * m_Instance;
+
+
+
+    // ================================================================= Layout
+public:
+    // Size of a sheet (overviews have a caption under each sticker, sticker
+    // set sheets a title on top)
+    static QSize GetSheetSize(const int mcRows, const int mcColumns,
+        const bool mcIsOverview);
+
+    // Maximum size of a sheet (pixels)
+    static const int m_MaxPixels;
+
+private:
+    static const int m_TileSize;
+    static const int m_FrameSize;
+    static const int m_Spacing;
+    static const int m_CaptionHeight;
+    static const int m_TitleHeight;
+
+
+
+    // ============================================================== Rendering
+public:
+    // Sticker on a sheet
+    struct Tile
+    {
+        QString m_UniqueID;
+        QString m_Filename;
+        QString m_Caption;
+    };
+
+    // What to render (files are only read by the renderer, so everything
+    // it needs is in here)
+    struct Job
+    {
+        qint64 m_ID = 0;
+        QString m_Key;
+        qint64 m_ChatID = 0;
+        bool m_IsOverview = false;
+        QString m_Title;
+        int m_Rows = 0;
+        int m_Columns = 0;
+        QList < Tile > m_Tiles;
+    };
+
+    // Identifies what a job renders (identical keys give identical sheets)
+    static QString GetJobKey(const Job & mcrJob);
+
+    // Where a rendered sheet is stored (numbers start at 1)
+    static QString GetSheetFilename(const QString & mcrKey,
+        const int mcNumber);
+
+    // Start rendering (detaches; returns job ID)
+    qint64 Render(const Job & mcrJob);
+
+    // Number of jobs that haven't finished yet
+    int GetWorkListSize() const;
+
+signals:
+    // Single sheet is ready
+    void SheetRendered(const qint64 mcJobID, const qint64 mcChatID,
+        const int mcNumber, const QString & mcrFilename);
+
+    // Job is done (tiles that could not be read are skipped)
+    void JobFinished(const qint64 mcJobID, const qint64 mcChatID,
+        const int mcNumSheets, const int mcNumTiles,
+        const int mcNumSkipped);
+
+private:
+    // Render job (runs on the thread pool)
+    void RenderJob(const Job & mcrJob);
+
+    // Read and scale a sticker (runs on the global thread pool; null image
+    // if it can't be read). Scaled stickers are cached on disk and in
+    // memory by file unique ID and tile size.
+    QImage LoadTile(const Tile & mcrTile);
+    QCache < QString, QImage > m_TileCache;
+    QMutex m_TileCacheMutex;
+
+    // Save a finished sheet (runs on the thread pool)
+    void SaveSheet(const Job & mcrJob, const int mcNumber,
+        const QImage & mcrSheet);
+
+    QThreadPool m_ThreadPool;
+    qint64 m_NextJobID;
+    QAtomicInt m_NumJobs;
+};
+
+#endif
@@ -22,6 +22,7 @@
 // Project includes
 #include "CallTracer.h"
 #include "Config.h"
+#include "ContactSheetRenderer.h"
 #include "MainWindow.h"
 #include "MessageLogger.h"
 #include "StringHelper.h"
@@ -29,9 +30,10 @@
 #include "TelegramHelper.h"
 
 // Qt includes
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
 #include <QGridLayout>
-#include <QPainter>
 #include <QRegularExpressionMatch>
 #include <QScrollBar>
 #include <QThread>
@@ -41,6 +43,9 @@
 // Frequency of status updates
 #define STATUS_REFRESH_DELAY 2*1000
 
+// Minimum time between edits of a progress message
+#define PROGRESS_UPDATE_DELAY 3*1000
+
 
 
 // ================================================================== Lifecycle
@@ -70,10 +75,26 @@ MainWindow::MainWindow()
         this, SLOT(CommandSeparateMessageReceived(qint64, qint64)));
     connect (th, SIGNAL(StickerSetReceived(const QString &)),
         this, SLOT(StickerSetReceived(const QString &)));
+    connect (th, SIGNAL(StickerSetFailed(const QString &, const bool)),
+        this, SLOT(StickerSetFailed(const QString &, const bool)));
+    connect (th, SIGNAL(StickerSetProgressChanged(const QString &)),
+        this, SLOT(StickerSetProgressChanged(const QString &)));
+
+    ContactSheetRenderer * csr = ContactSheetRenderer::Instance();
+    connect (csr, SIGNAL(SheetRendered(const qint64, const qint64,
+            const int, const QString &)),
+        this, SLOT(ContactSheetRendered(const qint64, const qint64,
+            const int, const QString &)));
+    connect (csr, SIGNAL(JobFinished(const qint64, const qint64, const int,
+            const int, const int)),
+        this, SLOT(ContactSheetJobFinished(const qint64, const qint64,
+            const int, const int, const int)));
 
     TelegramComms * tc = TelegramComms::Instance();
-    connect (tc, SIGNAL(StickerSetInfoFailed(const QString &)),
-        this, SLOT(StickerSetInfoFailed(const QString &)));
+    connect (tc, SIGNAL(MessageSent(const QString &, const qint64,
+            const qint64)),
+        this, SLOT(MessageSent(const QString &, const qint64,
+            const qint64)));
 
     // Initialize Widgets
     InitWidgets();
@@ -242,6 +263,13 @@ bool MainWindow::CommandsBeingExecuted() const
             break;
         }
 
+        // Contact sheets
+        if (!m_ContactSheetJobIDToUserID.isEmpty())
+        {
+            commands_being_executed = true;
+            break;
+        }
+
         // Nothing
         break;
     }
@@ -318,6 +346,11 @@ void MainWindow::MessageReceived(const qint64 mcChatID, qint64 mcMessageID)
     const QHash < QString, QString > message_info =
         tc -> GetMessageInfo(mcMessageID);
 
+    // Time stamps are kept in UTC; show local time
+    const QString date_time = QDateTime::fromSecsSinceEpoch(
+        tc -> GetMessageRecord(mcMessageID).m_Date)
+        .toString("yyyy-MM-dd hh:mm:ss");
+
     // Check if we have this chat already
     if (!m_ChatIDToTextEdit.contains(mcChatID))
     {
@@ -354,7 +387,7 @@ void MainWindow::MessageReceived(const qint64 mcChatID, qint64 mcMessageID)
                 "</td>"
                 "</tr>")
                 .arg(chat_name,
-                     message_info["date_time"]);
+                     date_time);
         m_TabWidget -> addTab(text_edit, chat_name);
     }
 
@@ -368,7 +401,6 @@ void MainWindow::MessageReceived(const qint64 mcChatID, qint64 mcMessageID)
         CALL_OUT(reason);
         return;
     }
-    const QString date_time = message_info["date_time"];
     const qint64 user_id = message_info["from_id"].toLongLong();
     const QHash < QString, QString > user_info =
         tc -> GetUserInfo(user_id);
@@ -670,7 +702,8 @@ void MainWindow::Command_Help(const qint64 mcUserID, const qint64 mcChatID,
             "- Or, to show current preferences.\n"
             "Parameters:\n"
             "- [parameter] is a preferences parameter: provide_sticker_set, "
-            "greedy\n"
+            "greedy, silent, sticker_format (original or converted: PNG "
+            "images and Lottie JSON animations)\n"
             "- If no parameter is provided (just /set by itself), the current "
             "preferences are shown.\n"
             "Result:\n"
@@ -878,7 +911,28 @@ void MainWindow::DownloadNewStickerSet(const qint64 mcUserID,
     {
         m_StickerSetNameToUserIDs[mcrStickerSetName] += mcUserID;
         m_StickerSetNameToChatIDs[mcrStickerSetName] += mcChatID;
-        th -> DownloadStickerSet(mcrStickerSetName, mcForce);
+        m_StickerSetNameToState[mcrStickerSetName] =
+            StickerSetState_Downloading;
+        m_StickerSetNameToFailureText.remove(mcrStickerSetName);
+        TelegramComms * tc = TelegramComms::Instance();
+        const bool convert =
+            (tc -> GetPreferenceValue(mcUserID, "sticker_format") ==
+                "converted");
+        th -> DownloadStickerSet(mcrStickerSetName, mcForce, convert);
+
+        // Progress message (unless we're done already); we'll know its
+        // message ID once the server has it
+        if (m_StickerSetNameToState[mcrStickerSetName] ==
+                StickerSetState_Downloading &&
+            tc -> GetPreferenceValue(mcUserID, "silent") == "no")
+        {
+            const QString message =
+                GetStickerSetProgressText(mcrStickerSetName);
+            tc -> SendMessage(mcChatID, message,
+                "stickerset_progress:" + mcrStickerSetName);
+            m_StickerSetNameToProgressText[mcrStickerSetName] = message;
+            m_StickerSetNameToProgressTimer[mcrStickerSetName].start();
+        }
     }
 
     CALL_OUT("");
@@ -936,19 +990,31 @@ void MainWindow::StickerSetReceived(const QString & mcrStickerSetName)
             }
         } else
         {
-            // Filename
+            // Send ZIP file (converted stickers if they're wanted and
+            // could be made)
             TelegramHelper * th = TelegramHelper::Instance();
-            const QString filename =
-                th -> GetStickerSetZIPFilename(mcrStickerSetName);
-            tc -> UploadFile(chat_id, filename);
+            const bool converted =
+                (tc -> GetPreferenceValue(user_id, "sticker_format") ==
+                    "converted") &&
+                th -> DoesStickerSetZIPFileExist(mcrStickerSetName, true);
+            th -> SendStickerSetZIPFile(chat_id, mcrStickerSetName,
+                converted);
             m_StickerSetNameHasBeenSentToUserIDs[mcrStickerSetName] +=
                 user_id;
         }
     }
 
+    // Final state of the progress messages
+    m_StickerSetNameToState[mcrStickerSetName] = StickerSetState_Done;
+    EditStickerSetProgress(mcrStickerSetName,
+        GetStickerSetProgressText(mcrStickerSetName));
+
     // No need to keep this around
     m_StickerSetNameToChatIDs.remove(mcrStickerSetName);
     m_StickerSetNameToUserIDs.remove(mcrStickerSetName);
+    m_StickerSetNameToProgressMessageIDs.remove(mcrStickerSetName);
+    m_StickerSetNameToProgressText.remove(mcrStickerSetName);
+    m_StickerSetNameToProgressTimer.remove(mcrStickerSetName);
 
     // Update status
     UpdateStatus();
@@ -966,30 +1032,272 @@ void MainWindow::StickerSetReceived(const QString & mcrStickerSetName)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Sticker set info failed
-void MainWindow::StickerSetInfoFailed(const QString & mcrStickerSetName)
+// Sticker set download failed
+void MainWindow::StickerSetFailed(const QString & mcrStickerSetName,
+    const bool mcDoesNotExist)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcDoesNotExist=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcDoesNotExist)));
+
+    TelegramComms * tc = TelegramComms::Instance();
+    QString message = tr("Sticker set \"%1\" does not exist.")
+        .arg(mcrStickerSetName);
+    if (!mcDoesNotExist)
+    {
+        message = tr("Sticker set \"%1\" could not be downloaded. Please "
+            "try again later.")
+            .arg(mcrStickerSetName);
+    }
+
+    // Chats with a progress message get it there (also those the server
+    // only confirms later)
+    m_StickerSetNameToState[mcrStickerSetName] = StickerSetState_Failed;
+    m_StickerSetNameToFailureText[mcrStickerSetName] = message;
+    EditStickerSetProgress(mcrStickerSetName, message);
+    const QHash < qint64, qint64 > chat_id_to_message_id =
+        m_StickerSetNameToProgressMessageIDs.take(mcrStickerSetName);
+    m_StickerSetNameToProgressText.remove(mcrStickerSetName);
+    m_StickerSetNameToProgressTimer.remove(mcrStickerSetName);
+
+    const QList < qint64 > chat_ids =
+        m_StickerSetNameToChatIDs.take(mcrStickerSetName);
+    m_StickerSetNameToUserIDs.remove(mcrStickerSetName);
+    for (const qint64 chat_id : chat_ids)
+    {
+        if (!chat_id_to_message_id.contains(chat_id))
+        {
+            tc -> SendMessage(chat_id, message);
+        }
+    }
+
+    // Update status
+    UpdateStatus();
+
+    // Check if there is current work going on
+    if (m_ShuttingDown &&
+        !CommandsBeingExecuted())
+    {
+        QTimer::singleShot(5000, this, &MainWindow::close);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Sticker set download made progress
+void MainWindow::StickerSetProgressChanged(const QString & mcrStickerSetName)
 {
     CALL_IN(QString("mcrStickerSetName=%1")
         .arg(CALL_SHOW(mcrStickerSetName)));
 
+    UpdateStickerSetProgress(mcrStickerSetName);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Server has a message we sent
+void MainWindow::MessageSent(const QString & mcrTag, const qint64 mcChatID,
+    const qint64 mcMessageID)
+{
+    CALL_IN(QString("mcrTag=%1, mcChatID=%2, mcMessageID=%3")
+        .arg(CALL_SHOW(mcrTag),
+             CALL_SHOW(mcChatID),
+             CALL_SHOW(mcMessageID)));
+
+    // Check if this is a contact sheet
+    if (mcrTag.startsWith("contact_sheet:"))
+    {
+        ContactSheetUploaded(mcrTag, mcMessageID);
+        CALL_OUT("");
+        return;
+    }
+
+    // Check if this is a progress message
+    static const QString progress_prefix = "stickerset_progress:";
+    if (!mcrTag.startsWith(progress_prefix))
+    {
+        CALL_OUT("");
+        return;
+    }
+    const QString sticker_set_name = mcrTag.mid(progress_prefix.size());
+
+    // Download may have finished (or failed) in the meantime
+    if (m_StickerSetNameToState.value(sticker_set_name) !=
+        StickerSetState_Downloading)
+    {
+        TelegramComms * tc = TelegramComms::Instance();
+        tc -> EditMessageText(mcChatID, mcMessageID,
+            GetStickerSetProgressText(sticker_set_name));
+        CALL_OUT("");
+        return;
+    }
+
+    // Keep it up to date from now on
+    m_StickerSetNameToProgressMessageIDs[sticker_set_name][mcChatID] =
+        mcMessageID;
+    UpdateStickerSetProgress(sticker_set_name);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update progress messages, but not more often than every few seconds
+void MainWindow::UpdateStickerSetProgress(const QString & mcrStickerSetName)
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
+    // Check if there is anything to update
+    if (!m_StickerSetNameToProgressMessageIDs.contains(mcrStickerSetName) ||
+        m_StickerSetNameToState.value(mcrStickerSetName) !=
+            StickerSetState_Downloading)
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    // Too soon; update later (with whatever the progress is by then)
+    const qint64 elapsed =
+        m_StickerSetNameToProgressTimer.contains(mcrStickerSetName) ?
+            m_StickerSetNameToProgressTimer[mcrStickerSetName].elapsed() :
+            PROGRESS_UPDATE_DELAY;
+    if (elapsed < PROGRESS_UPDATE_DELAY)
+    {
+        if (!m_StickerSetProgressUpdatePending.contains(mcrStickerSetName))
+        {
+            m_StickerSetProgressUpdatePending += mcrStickerSetName;
+            const QString sticker_set_name = mcrStickerSetName;
+            QTimer::singleShot(PROGRESS_UPDATE_DELAY - elapsed, this,
+                [this, sticker_set_name]()
+                {
+                    m_StickerSetProgressUpdatePending -= sticker_set_name;
+                    UpdateStickerSetProgress(sticker_set_name);
+                });
+        }
+        CALL_OUT("");
+        return;
+    }
+
+    EditStickerSetProgress(mcrStickerSetName,
+        GetStickerSetProgressText(mcrStickerSetName));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Edit progress messages (if the text changed)
+void MainWindow::EditStickerSetProgress(const QString & mcrStickerSetName,
+    const QString & mcrText)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcrText=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcrText)));
+
+    // Server doesn't like edits that don't change anything
+    if (!m_StickerSetNameToProgressMessageIDs.contains(mcrStickerSetName) ||
+        m_StickerSetNameToProgressText.value(mcrStickerSetName) == mcrText)
+    {
+        CALL_OUT("");
+        return;
+    }
+
     TelegramComms * tc = TelegramComms::Instance();
-    const QString message = tr("Sticker set \"%1\" does not exist.")
-        .arg(mcrStickerSetName);
-    for (auto chat_iterator =
-            m_StickerSetNameToChatIDs[mcrStickerSetName].constBegin();
-        chat_iterator !=
-            m_StickerSetNameToChatIDs[mcrStickerSetName].constEnd();
-        chat_iterator++)
-    {
-        const qint64 chat_id = *chat_iterator;
-        tc -> SendMessage(chat_id, message);
+    const QHash < qint64, qint64 > & chat_id_to_message_id =
+        m_StickerSetNameToProgressMessageIDs[mcrStickerSetName];
+    for (auto message_iterator = chat_id_to_message_id.constBegin();
+         message_iterator != chat_id_to_message_id.constEnd();
+         message_iterator++)
+    {
+        tc -> EditMessageText(message_iterator.key(),
+            message_iterator.value(), mcrText);
     }
+    m_StickerSetNameToProgressText[mcrStickerSetName] = mcrText;
+    m_StickerSetNameToProgressTimer[mcrStickerSetName].start();
 
     CALL_OUT("");
 }
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Text of a progress message
+QString MainWindow::GetStickerSetProgressText(
+    const QString & mcrStickerSetName) const
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
+    // Failed
+    const StickerSetState state = m_StickerSetNameToState.value(
+        mcrStickerSetName, StickerSetState_Downloading);
+    if (state == StickerSetState_Failed)
+    {
+        const QString text =
+            m_StickerSetNameToFailureText.value(mcrStickerSetName);
+        CALL_OUT("");
+        return text;
+    }
+
+    // Done
+    if (state == StickerSetState_Done)
+    {
+        const QString text = tr("Sticker set \"%1\" has been downloaded.")
+            .arg(mcrStickerSetName);
+        CALL_OUT("");
+        return text;
+    }
+
+    // Still waiting for the sticker set info
+    TelegramHelper * th = TelegramHelper::Instance();
+    if (!th -> IsStickerSetProgressAvailable(mcrStickerSetName))
+    {
+        const QString text = tr("Downloading sticker set \"%1\"...")
+            .arg(mcrStickerSetName);
+        CALL_OUT("");
+        return text;
+    }
+
+    // Stickers
+    const TelegramHelper::StickerSetProgress progress =
+        th -> GetStickerSetProgress(mcrStickerSetName);
+    QString text = tr("Downloading sticker set \"%1\": %2 of %3 stickers")
+        .arg(mcrStickerSetName,
+             QString::number(progress.m_FilesDone),
+             QString::number(progress.m_FilesTotal));
+    if (progress.m_BytesTotal > 0)
+    {
+        text += tr(" (%1 of %2)")
+            .arg(StringHelper::ConvertFileSize(progress.m_BytesDone),
+                 StringHelper::ConvertFileSize(progress.m_BytesTotal));
+    }
+    if (progress.m_SecondsLeft >= 60)
+    {
+        text += tr(", about %1 min %2 s left")
+            .arg(QString::number(progress.m_SecondsLeft / 60),
+                 QString::number(progress.m_SecondsLeft % 60));
+    } else if (progress.m_SecondsLeft >= 0)
+    {
+        text += tr(", about %1 s left")
+            .arg(QString::number(progress.m_SecondsLeft));
+    }
+    text += ".";
+
+    CALL_OUT("");
+    return text;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Command /contactsheets
 void MainWindow::Command_ContactSheets(const qint64 mcUserID,
@@ -1065,45 +1373,8 @@ void MainWindow::Command_ContactSheets_AllSets(const qint64 mcUserID,
              CALL_SHOW(mcRows),
              CALL_SHOW(mcColumns)));
 
-    // Dimensions
-    const int dim_sticker = 200;
-    const int dim_frame_n = 20;
-    const int dim_frame_e = 20;
-    const int dim_frame_s = 20;
-    const int dim_frame_w = 20;
-    const int dim_vertical_spacing = 20;
-    const int dim_horizontal_spacing = 20;
-    const int dim_text_height = 20;
-
     // Abbreviation
     TelegramComms * tc = TelegramComms::Instance();
-    const QString is_silent = tc -> GetPreferenceValue(mcUserID, "silent");
-
-    // Resolution
-    const int width = dim_frame_w
-        + mcColumns * dim_sticker
-        + (mcColumns - 1) * dim_horizontal_spacing
-        + dim_frame_e;
-    const int height = dim_frame_n
-        + mcRows * (dim_sticker + dim_text_height)
-        + (mcRows - 1) * dim_vertical_spacing
-        + dim_frame_s;
-
-    if (width * height > 20000000)
-    {
-        const QString message = tr("Maximum resolution is limited to 20MP.");
-        tc -> SendMessage(mcChatID, message);
-        CALL_OUT("");
-        return;
-    }
-
-    QString message = tr("Fitting %1x%2 stickers on the contact sheet.")
-        .arg(QString::number(mcColumns),
-             QString::number(mcRows));
-    if (is_silent == "no")
-    {
-        tc -> SendMessage(mcChatID, message);
-    }
 
     // Sort sticker sets
     const QStringList all_set_names = tc -> GetAllStickerSetNames();
@@ -1114,15 +1385,12 @@ void MainWindow::Command_ContactSheets_AllSets(const qint64 mcUserID,
     }
     const QStringList sorted_names = StringHelper::SortHash(sort_hash);
 
-    // Loop all available sticker sets
-    int row = 0;
-    int column = 0;
-    int sheet_count = 1;
-    int num_stickers = 0;
-    int num_animated = 0;
-    QPixmap sheet = QPixmap(width, height);
-    QPainter * painter = new QPainter(&sheet);
-    painter -> fillRect(0, 0, width, height, Qt::white);
+    // First sticker of all available sticker sets
+    ContactSheetRenderer::Job job;
+    job.m_ChatID = mcChatID;
+    job.m_IsOverview = true;
+    job.m_Rows = mcRows;
+    job.m_Columns = mcColumns;
     for (const QString & set_name : sorted_names)
     {
         if (!tc -> DoesStickerSetInfoExist(set_name))
@@ -1135,94 +1403,15 @@ void MainWindow::Command_ContactSheets_AllSets(const qint64 mcUserID,
         {
             continue;
         }
-
-        // Read picture; this will fail if sticker is animated because it
-        // then is in a file format we cannot read;
-        const QByteArray sticker_data = tc -> GetFile(first_file_id);
-        QImage image = QImage::fromData(sticker_data);
-        if (image.isNull())
-        {
-            num_animated++;
-            continue;
-        }
-        num_stickers++;
-
-        image = image.scaled(dim_sticker, dim_sticker,
-            Qt::KeepAspectRatio, Qt::SmoothTransformation);
-
-        // Render
-        const int base_x = dim_frame_e +
-            column * (dim_sticker + dim_horizontal_spacing);
-        const int sticker_x = base_x
-            + (dim_sticker - image.width())/2;
-        const int base_y = dim_frame_n +
-            row * (dim_sticker + dim_text_height + dim_vertical_spacing);
-        const int sticker_y = base_y
-            + (dim_sticker - image.height())/2;
-        painter -> drawImage(sticker_x, sticker_y, image);
-
-        // Set name
-        const int text_x = base_x;
-        const int text_y = base_y + dim_sticker + 2;
-        painter -> drawText(text_x, text_y, dim_sticker, 15,
-            Qt::AlignCenter, set_name.trimmed());
-
-        column++;
-        if (column == mcColumns)
-        {
-            column = 0;
-            row++;
-            if (row == mcRows)
-            {
-                row = 0;
-                const QString filename = USER_FILES + QString("Sheet %1.png")
-                    .arg(QString::number(sheet_count));
-                sheet.save(filename, "PNG");
-                tc -> UploadFile(mcChatID, filename);
-
-                // New sheet
-                delete painter;
-                sheet = QPixmap(width, height);
-                painter = new QPainter(&sheet);
-                painter -> fillRect(0, 0, width, height, Qt::white);
-                sheet_count++;
-            }
-        }
-    }
-
-    // Save last contact sheet
-    if (row !=0 ||
-        column !=0 )
-    {
-        const QString filename = USER_FILES + QString("Sheet %1.png")
-            .arg(QString::number(sheet_count));
-        sheet.save(filename, "PNG");
-        tc -> UploadFile(mcChatID, filename);
-        delete painter;
+        ContactSheetRenderer::Tile tile;
+        tile.m_UniqueID = tc -> GetFileUniqueID(first_file_id);
+        tile.m_Filename = tc -> GetLocalFilename(first_file_id);
+        tile.m_Caption = set_name.trimmed();
+        job.m_Tiles << tile;
     }
 
-    message = tr("Created %1 contact %2 with a total of %3 sticker %4.")
-        .arg(QString::number(sheet_count),
-             sheet_count == 1 ? tr("sheet") : tr("sheets"),
-             QString::number(num_stickers),
-             num_stickers == 1 ? tr("set") : tr("sets"));
-    if (num_animated > 0)
-    {
-        message += tr(" %1 sets with animated stickers were ignored.")
-            .arg(QString::number(num_animated));
-    }
-    if (is_silent == "no")
-    {
-        tc -> SendMessage(mcChatID, message);
-    }
-
-    // Check if there is current work going on
-    if (m_ShuttingDown &&
-        !CommandsBeingExecuted())
-    {
-        // We can quit after allowing the upload to complete
-        QTimer::singleShot(5000, this, &MainWindow::close);
-    }
+    // Render
+    Command_ContactSheets_Render(mcUserID, QString(), job);
 
     CALL_OUT("");
 }
@@ -1245,7 +1434,6 @@ void MainWindow::Command_ContactSheets_SingleSet(const qint64 mcUserID,
 
     // Abbreviation
     TelegramComms * tc = TelegramComms::Instance();
-    const QString is_silent = tc -> GetPreferenceValue(mcUserID, "silent");
 
     // Check if the set exists
     if (!tc -> DoesStickerSetInfoExist(mcrStickerSetName))
@@ -1262,6 +1450,12 @@ void MainWindow::Command_ContactSheets_SingleSet(const qint64 mcUserID,
     set_title.replace("\n", " ");
 
     // Get sticker file IDs
+    ContactSheetRenderer::Job job;
+    job.m_ChatID = mcChatID;
+    job.m_IsOverview = false;
+    job.m_Title = set_title;
+    job.m_Rows = mcRows;
+    job.m_Columns = mcColumns;
     const QStringList all_file_ids =
         tc -> GetStickerSetFileIDs(mcrStickerSetName);
     for (const QString & file_id : all_file_ids)
@@ -1286,137 +1480,299 @@ void MainWindow::Command_ContactSheets_SingleSet(const qint64 mcUserID,
             CALL_OUT("");
             return;
         }
+        ContactSheetRenderer::Tile tile;
+        tile.m_UniqueID = tc -> GetFileUniqueID(file_id);
+        tile.m_Filename = tc -> GetLocalFilename(file_id);
+        job.m_Tiles << tile;
     }
 
-    // Dimensions
-    const int dim_sticker = 200;
-    const int dim_title_height = 100;
-    const int dim_frame_n = 20;
-    const int dim_frame_e = 20;
-    const int dim_frame_s = 20;
-    const int dim_frame_w = 20;
-    const int dim_vertical_spacing = 20;
-    const int dim_horizontal_spacing = 20;
+    // Render
+    Command_ContactSheets_Render(mcUserID, mcrStickerSetName, job);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Contact sheet: start rendering
+void MainWindow::Command_ContactSheets_Render(const qint64 mcUserID,
+    const QString & mcrStickerSetName,
+    const ContactSheetRenderer::Job & mcrJob)
+{
+    CALL_IN(QString("mcUserID=%1, mcrStickerSetName=%2, mcrJob=%3")
+        .arg(CALL_SHOW(mcUserID),
+             CALL_SHOW(mcrStickerSetName),
+             "..."));
+
+    // Abbreviation
+    TelegramComms * tc = TelegramComms::Instance();
+    const QString is_silent = tc -> GetPreferenceValue(mcUserID, "silent");
 
     // Resolution
-    const int width = dim_frame_w
-        + mcColumns * dim_sticker
-        + (mcColumns - 1) * dim_horizontal_spacing
-        + dim_frame_e;
-    const int height = dim_title_height
-        + dim_frame_n
-        + mcRows * dim_sticker
-        + (mcRows - 1) * dim_vertical_spacing
-        + dim_frame_s;
-
-    if (width * height > 20000000)
+    const QSize sheet_size = ContactSheetRenderer::GetSheetSize(
+        mcrJob.m_Rows, mcrJob.m_Columns, mcrJob.m_IsOverview);
+    if (sheet_size.width() * sheet_size.height() >
+        ContactSheetRenderer::m_MaxPixels)
     {
         const QString message = tr("Maximum resolution is limited to 20MP.");
-        tc -> SendMessage(mcChatID, message);
+        tc -> SendMessage(mcrJob.m_ChatID, message);
         CALL_OUT("");
         return;
     }
 
-    QString message = tr("Fitting %1x%2 stickers on the contact sheet.")
-        .arg(QString::number(mcColumns),
-             QString::number(mcRows));
+    // Identical request before?
+    const QString key = ContactSheetRenderer::GetJobKey(mcrJob);
+    if (SendCachedContactSheets(mcUserID, mcrStickerSetName,
+        mcrJob.m_ChatID, key))
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    const QString message = tr("Fitting %1x%2 stickers on the contact sheet.")
+        .arg(QString::number(mcrJob.m_Columns),
+             QString::number(mcrJob.m_Rows));
     if (is_silent == "no")
     {
-        tc -> SendMessage(mcChatID, message);
+        tc -> SendMessage(mcrJob.m_ChatID, message);
     }
 
-    // Title font
-    QFont title_font("Georgia", 70);
+    // Sheets are rendered in the background; results come back in
+    // ContactSheetRendered() and ContactSheetJobFinished()
+    ContactSheetRenderer * csr = ContactSheetRenderer::Instance();
+    const qint64 job_id = csr -> Render(mcrJob);
+    m_ContactSheetJobIDToUserID[job_id] = mcUserID;
+    m_ContactSheetJobIDToKey[job_id] = key;
+    m_ContactSheetJobIDToStickerSetName[job_id] = mcrStickerSetName;
 
-    // Loop all stickers in this set
-    int row = 0;
-    int column = 0;
-    int sheet_count = 1;
-    QPixmap sheet;
-    QPainter * painter = nullptr;
-    for (const QString & file_id : all_file_ids)
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Contact sheet: single sheet is ready
+void MainWindow::ContactSheetRendered(const qint64 mcJobID,
+    const qint64 mcChatID, const int mcNumber, const QString & mcrFilename)
+{
+    CALL_IN(QString("mcJobID=%1, mcChatID=%2, mcNumber=%3, mcrFilename=%4")
+        .arg(CALL_SHOW(mcJobID),
+             CALL_SHOW(mcChatID),
+             CALL_SHOW(mcNumber),
+             CALL_SHOW(mcrFilename)));
+
+    // We'll remember the document file ID (tag is
+    // contact_sheet:<key>:<number>)
+    const QString tag = QString("contact_sheet:%1:%2")
+        .arg(m_ContactSheetJobIDToKey.value(mcJobID),
+             QString::number(mcNumber));
+    TelegramComms * tc = TelegramComms::Instance();
+    tc -> UploadFile(mcChatID, mcrFilename, tag);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Contact sheet: job is done
+void MainWindow::ContactSheetJobFinished(const qint64 mcJobID,
+    const qint64 mcChatID, const int mcNumSheets, const int mcNumTiles,
+    const int mcNumSkipped)
+{
+    CALL_IN(QString("mcJobID=%1, mcChatID=%2, mcNumSheets=%3, "
+        "mcNumTiles=%4, mcNumSkipped=%5")
+        .arg(CALL_SHOW(mcJobID),
+             CALL_SHOW(mcChatID),
+             CALL_SHOW(mcNumSheets),
+             CALL_SHOW(mcNumTiles),
+             CALL_SHOW(mcNumSkipped)));
+
+    // Check if we know this job
+    if (!m_ContactSheetJobIDToUserID.contains(mcJobID))
     {
-        // Title
-        if (row == 0 && column == 0)
-        {
-            // Generate new sheet
-            if (painter)
-            {
-                delete painter;
-            }
-            sheet = QPixmap(width, height);
-            painter = new QPainter(&sheet);
-            painter -> fillRect(0, 0, width, height, Qt::white);
-
-            // Set name
-            painter -> setFont(title_font);
-            painter -> drawText(0, dim_frame_n, width, dim_title_height,
-                Qt::AlignCenter, set_title);
-        }
+        const QString reason = tr("Unknown contact sheet job %1.")
+            .arg(QString::number(mcJobID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+    const qint64 user_id = m_ContactSheetJobIDToUserID.take(mcJobID);
+    const QString set_name =
+        m_ContactSheetJobIDToStickerSetName.take(mcJobID);
+    const QString key = m_ContactSheetJobIDToKey.take(mcJobID);
+
+    // Keep for identical requests (document file IDs of sheets that have
+    // been uploaded before are still good: same key, same sheets)
+    TelegramComms * tc = TelegramComms::Instance();
+    QHash < QString, QString > sheet_info = tc -> GetContactSheetInfo(key);
+    sheet_info["num_sheets"] = QString::number(mcNumSheets);
+    sheet_info["num_tiles"] = QString::number(mcNumTiles);
+    sheet_info["num_skipped"] = QString::number(mcNumSkipped);
+    tc -> SetContactSheetInfo(key, sheet_info);
+
+    SendContactSheetSummary(user_id, mcChatID, set_name, mcNumSheets,
+        mcNumTiles, mcNumSkipped);
+
+    // Check if there is current work going on
+    if (m_ShuttingDown &&
+        !CommandsBeingExecuted())
+    {
+        // We can quit after allowing the upload to complete
+        QTimer::singleShot(5000, this, &MainWindow::close);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Contact sheet: sheet has been uploaded
+void MainWindow::ContactSheetUploaded(const QString & mcrTag,
+    const qint64 mcMessageID)
+{
+    CALL_IN(QString("mcrTag=%1, mcMessageID=%2")
+        .arg(CALL_SHOW(mcrTag),
+             CALL_SHOW(mcMessageID)));
 
-        const QByteArray sticker_data = tc -> GetFile(file_id);
-        QImage image = QImage::fromData(sticker_data);
-        image = image.scaled(dim_sticker, dim_sticker,
-            Qt::KeepAspectRatio, Qt::SmoothTransformation);
-
-        // Render
-        const int base_x = dim_frame_e +
-            column * (dim_sticker + dim_horizontal_spacing);
-        const int sticker_x = base_x
-            + (dim_sticker - image.width())/2;
-        const int base_y = dim_frame_n + dim_title_height +
-            row * (dim_sticker + dim_vertical_spacing);
-        const int sticker_y = base_y
-            + (dim_sticker - image.height())/2;
-        painter -> drawImage(sticker_x, sticker_y, image);
-
-        column++;
-        if (column == mcColumns)
+    // Tag is contact_sheet:<key>:<number>
+    const QString key = mcrTag.section(':', 1, 1);
+    const QString number = mcrTag.section(':', 2, 2);
+    TelegramComms * tc = TelegramComms::Instance();
+    const MessageRecord message = tc -> GetMessageRecord(mcMessageID);
+    if (key.isEmpty() ||
+        message.m_DocumentID.isEmpty())
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    // Next time, we'll just send the document
+    QHash < QString, QString > sheet_info = tc -> GetContactSheetInfo(key);
+    sheet_info["document_file_id_" + number] = message.m_DocumentID;
+    tc -> SetContactSheetInfo(key, sheet_info);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Contact sheet: send sheets from an identical request
+bool MainWindow::SendCachedContactSheets(const qint64 mcUserID,
+    const QString & mcrStickerSetName, const qint64 mcChatID,
+    const QString & mcrKey)
+{
+    CALL_IN(QString("mcUserID=%1, mcrStickerSetName=%2, mcChatID=%3, "
+        "mcrKey=%4")
+        .arg(CALL_SHOW(mcUserID),
+             CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcChatID),
+             CALL_SHOW(mcrKey)));
+
+    // Check if we have them all (uploaded or on disk)
+    TelegramComms * tc = TelegramComms::Instance();
+    const QHash < QString, QString > sheet_info =
+        tc -> GetContactSheetInfo(mcrKey);
+    if (!sheet_info.contains("num_sheets"))
+    {
+        CALL_OUT("");
+        return false;
+    }
+    const int num_sheets = sheet_info["num_sheets"].toInt();
+    for (int number = 1; number <= num_sheets; number++)
+    {
+        const QString file_id =
+            sheet_info.value("document_file_id_" + QString::number(number));
+        if (file_id.isEmpty() &&
+            !QFile::exists(ContactSheetRenderer::GetSheetFilename(mcrKey,
+                number)))
         {
-            column = 0;
-            row++;
-            if (row == mcRows)
-            {
-                row = 0;
-                const QString filename = USER_FILES + QString("Sheet %1.png")
-                    .arg(QString::number(sheet_count));
-                sheet.save(filename, "PNG");
-                tc -> UploadFile(mcChatID, filename);
-                sheet_count++;
-            }
+            CALL_OUT("");
+            return false;
         }
     }
 
-    // Save last contact sheet
-    if (row !=0 ||
-        column !=0 )
+    // Send them
+    for (int number = 1; number <= num_sheets; number++)
     {
-        const QString filename = USER_FILES + QString("Sheet %1.png")
-            .arg(QString::number(sheet_count));
-        sheet.save(filename, "PNG");
-        tc -> UploadFile(mcChatID, filename);
-        delete painter;
+        const QString file_id =
+            sheet_info.value("document_file_id_" + QString::number(number));
+        if (file_id.isEmpty())
+        {
+            const QString tag = QString("contact_sheet:%1:%2")
+                .arg(mcrKey,
+                     QString::number(number));
+            tc -> UploadFile(mcChatID,
+                ContactSheetRenderer::GetSheetFilename(mcrKey, number), tag);
+        } else
+        {
+            tc -> SendDocument(mcChatID, file_id);
+        }
     }
 
-    message = tr("Created %1 contact %2 for set \"%3\" with a total "
-        "of %4 %5.")
-        .arg(QString::number(sheet_count),
-             sheet_count == 1 ? tr("sheet") : tr("sheets"),
-             mcrStickerSetName,
-             QString::number(all_file_ids.size()),
-             all_file_ids.size() == 1 ? tr("sticker") : tr("stickers"));
-    if (is_silent == "no")
+    SendContactSheetSummary(mcUserID, mcChatID, mcrStickerSetName,
+        num_sheets, sheet_info["num_tiles"].toInt(),
+        sheet_info["num_skipped"].toInt());
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Contact sheet: let the user know what has been sent
+void MainWindow::SendContactSheetSummary(const qint64 mcUserID,
+    const qint64 mcChatID, const QString & mcrStickerSetName,
+    const int mcNumSheets, const int mcNumTiles, const int mcNumSkipped)
+{
+    CALL_IN(QString("mcUserID=%1, mcChatID=%2, mcrStickerSetName=%3, "
+        "mcNumSheets=%4, mcNumTiles=%5, mcNumSkipped=%6")
+        .arg(CALL_SHOW(mcUserID),
+             CALL_SHOW(mcChatID),
+             CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcNumSheets),
+             CALL_SHOW(mcNumTiles),
+             CALL_SHOW(mcNumSkipped)));
+
+    // Abbreviation
+    TelegramComms * tc = TelegramComms::Instance();
+    const QString is_silent = tc -> GetPreferenceValue(mcUserID, "silent");
+    if (is_silent != "no")
     {
-        tc -> SendMessage(mcChatID, message);
+        CALL_OUT("");
+        return;
     }
 
-    // Check if there is current work going on
-    if (m_ShuttingDown &&
-        !CommandsBeingExecuted())
+    QString message;
+    if (mcrStickerSetName.isEmpty())
     {
-        // We can quit after allowing the upload to complete
-        QTimer::singleShot(5000, this, &MainWindow::close);
+        // All sets overview
+        message = tr("Created %1 contact %2 with a total of %3 sticker %4.")
+            .arg(QString::number(mcNumSheets),
+                 mcNumSheets == 1 ? tr("sheet") : tr("sheets"),
+                 QString::number(mcNumTiles),
+                 mcNumTiles == 1 ? tr("set") : tr("sets"));
+        if (mcNumSkipped > 0)
+        {
+            message += tr(" %1 sets with animated stickers were ignored.")
+                .arg(QString::number(mcNumSkipped));
+        }
+    } else
+    {
+        // Single set
+        message = tr("Created %1 contact %2 for set \"%3\" with a total "
+            "of %4 %5.")
+            .arg(QString::number(mcNumSheets),
+                 mcNumSheets == 1 ? tr("sheet") : tr("sheets"),
+                 mcrStickerSetName,
+                 QString::number(mcNumTiles),
+                 mcNumTiles == 1 ? tr("sticker") : tr("stickers"));
     }
+    tc -> SendMessage(mcChatID, message);
 
     CALL_OUT("");
 }
@@ -1541,6 +1897,28 @@ void MainWindow::Command_Set(const qint64 mcUserID, const qint64 mcChatID,
         return;
     }
 
+    // sticker_format
+    if (key == "sticker_format")
+    {
+        if (value != "original" &&
+            value != "converted")
+        {
+            const QString reason = tr("%1 should have one of the following "
+                "values: \"original\", \"converted\".")
+                .arg(key);
+            tc -> SendMessage(mcChatID, reason);
+        } else
+        {
+            tc -> SetPreferenceValue(mcUserID, key, value);
+            const QString reason = tr("%1 set to \"%2\".")
+                .arg(key,
+                     value);
+            tc -> SendMessage(mcChatID, reason);
+        }
+        CALL_OUT("");
+        return;
+    }
+
     // Unknown preference parameter
     const QString reason = tr("\"%1\" has not been handled.")
         .arg(key);
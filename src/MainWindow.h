@@ -4,7 +4,11 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+// Project includes
+#include "ContactSheetRenderer.h"
+
 // Qt includes
+#include <QElapsedTimer>
 #include <QLabel>
 #include <QMainWindow>
 #include <QTextEdit>
@@ -106,9 +110,38 @@ private:
     QHash < QString, QList < qint64 > > m_StickerSetNameToUserIDs;
     QHash < QString, QSet < qint64 > > m_StickerSetNameHasBeenSentToUserIDs;
 private slots:
-    void StickerSetInfoFailed(const QString & mcrStickerSetName);
+    void StickerSetFailed(const QString & mcrStickerSetName,
+        const bool mcDoesNotExist);
     void StickerSetReceived(const QString & mcrStickerSetName);
 
+    // Progress of sticker set downloads (one message per chat, edited in
+    // place)
+    void StickerSetProgressChanged(const QString & mcrStickerSetName);
+    void MessageSent(const QString & mcrTag, const qint64 mcChatID,
+        const qint64 mcMessageID);
+private:
+    void UpdateStickerSetProgress(const QString & mcrStickerSetName);
+    void EditStickerSetProgress(const QString & mcrStickerSetName,
+        const QString & mcrText);
+    QString GetStickerSetProgressText(const QString & mcrStickerSetName)
+        const;
+    QHash < QString, QHash < qint64, qint64 > >
+        m_StickerSetNameToProgressMessageIDs;
+    QHash < QString, QString > m_StickerSetNameToProgressText;
+    QHash < QString, QElapsedTimer > m_StickerSetNameToProgressTimer;
+    QSet < QString > m_StickerSetProgressUpdatePending;
+
+    // Where the last download of a sticker set got to (progress messages
+    // the server only confirms afterwards still get the right final text)
+    enum StickerSetState
+    {
+        StickerSetState_Downloading,
+        StickerSetState_Done,
+        StickerSetState_Failed
+    };
+    QHash < QString, StickerSetState > m_StickerSetNameToState;
+    QHash < QString, QString > m_StickerSetNameToFailureText;
+
 
 private:
     // == Command /contactsheets
@@ -120,10 +153,33 @@ private:
         const qint64 mcChatID, const QString & mcrStickerSetName,
         const int mcRows, const int mcColumns);
     void Command_ContactSheets_Render(const qint64 mcUserID,
-        const qint64 mcChatID, const int mcRows, const int mcColumns,
-        const QStringList & mcrStickerNames);
+        const QString & mcrStickerSetName,
+        const ContactSheetRenderer::Job & mcrJob);
+
+    // Rendering jobs that haven't finished yet (set name is empty for the
+    // all sets overview)
+    QHash < qint64, qint64 > m_ContactSheetJobIDToUserID;
+    QHash < qint64, QString > m_ContactSheetJobIDToStickerSetName;
+    QHash < qint64, QString > m_ContactSheetJobIDToKey;
+private slots:
+    void ContactSheetRendered(const qint64 mcJobID, const qint64 mcChatID,
+        const int mcNumber, const QString & mcrFilename);
+    void ContactSheetJobFinished(const qint64 mcJobID, const qint64 mcChatID,
+        const int mcNumSheets, const int mcNumTiles, const int mcNumSkipped);
+private:
+    // Sheets of identical requests are sent again (by document file ID once
+    // they have been uploaded)
+    void ContactSheetUploaded(const QString & mcrTag,
+        const qint64 mcMessageID);
+    bool SendCachedContactSheets(const qint64 mcUserID,
+        const QString & mcrStickerSetName, const qint64 mcChatID,
+        const QString & mcrKey);
+    void SendContactSheetSummary(const qint64 mcUserID,
+        const qint64 mcChatID, const QString & mcrStickerSetName,
+        const int mcNumSheets, const int mcNumTiles, const int mcNumSkipped);
 
 
+private:
     // == Command /set
     void Command_Set(const qint64 mcUserID, const qint64 mcChatID,
         const qint64 mcMessageID, const QString & mcrParameters);
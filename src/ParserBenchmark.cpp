@@ -0,0 +1,879 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// ParserBenchmark.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "MessageLogger.h"
+#include "ParserBenchmark.h"
+#include "StringPool.h"
+#include "TelegramComms.h"
+
+// Qt includes
+#include <QCborMap>
+#include <QCborValue>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QObject>
+
+// System includes
+#include <atomic>
+
+
+
+// Counting allocations means replacing malloc() and friends for the entire
+// program. That's only done on request (qmake CONFIG+=count_allocations),
+// and only with glibc, which makes the original functions available as
+// __libc_malloc() etc. Qt containers allocate with malloc(); operator new
+// uses it as well, so this catches everything. Bytes in use are tracked
+// with malloc_usable_size(); memory from the aligned allocation functions
+// isn't counted, so only differences over a short time are meaningful.
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+#include <malloc.h>
+
+static std::atomic < qint64 > allocation_count(0);
+static std::atomic < qint64 > allocated_bytes(0);
+
+extern "C"
+{
+    void * __libc_malloc(size_t mcSize);
+    void * __libc_calloc(size_t mcCount, size_t mcSize);
+    void * __libc_realloc(void * mpMemory, size_t mcSize);
+    void __libc_free(void * mpMemory);
+
+    void * malloc(size_t mcSize)
+    {
+        allocation_count++;
+        void * memory = __libc_malloc(mcSize);
+        allocated_bytes += malloc_usable_size(memory);
+        return memory;
+    }
+
+    void * calloc(size_t mcCount, size_t mcSize)
+    {
+        allocation_count++;
+        void * memory = __libc_calloc(mcCount, mcSize);
+        allocated_bytes += malloc_usable_size(memory);
+        return memory;
+    }
+
+    void * realloc(void * mpMemory, size_t mcSize)
+    {
+        allocation_count++;
+        const size_t previous_size = malloc_usable_size(mpMemory);
+        void * memory = __libc_realloc(mpMemory, mcSize);
+        if (memory ||
+            mcSize == 0)
+        {
+            // Either moved/resized, or freed
+            allocated_bytes += qint64(malloc_usable_size(memory)) -
+                qint64(previous_size);
+        }
+        return memory;
+    }
+
+    void free(void * mpMemory)
+    {
+        allocated_bytes -= malloc_usable_size(mpMemory);
+        __libc_free(mpMemory);
+    }
+}
+#endif
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Never to be instanciated
+ParserBenchmark::ParserBenchmark()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ParserBenchmark::~ParserBenchmark()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+// ================================================================== Benchmark
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Run benchmark (returns exit code)
+int ParserBenchmark::Run(const int mcIterations)
+{
+    CALL_IN(QString("mcIterations=%1")
+        .arg(CALL_SHOW(mcIterations)));
+
+    // Parsed data goes into a throw-away database
+    TelegramComms * tc = TelegramComms::Instance();
+    tc -> SetDatabaseFile(":memory:");
+    if (!tc -> OpenDatabase())
+    {
+        const QString reason = QObject::tr("Could not open database.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+
+    // Typed records vs. key/value info. This goes first: updates
+    // committed below would make users and chats known, and known entities
+    // are not parsed again.
+    RunRecords(mcIterations);
+
+    qDebug().noquote() << QObject::tr("%1  %2  %3")
+        .arg(QString().leftJustified(20, ' '),
+             QObject::tr("Parse_UpdateArray").leftJustified(28, ' '),
+             QObject::tr("Parse_Response (raw reply)"));
+
+    // Run all recorded updates
+    qint64 next_id = 1;
+    const QList < QPair < QString, QByteArray > > corpus = GetCorpus();
+    for (const QPair < QString, QByteArray > & entry : corpus)
+    {
+        const QJsonObject update =
+            QJsonDocument::fromJson(entry.second).object();
+        if (update.isEmpty())
+        {
+            const QString reason =
+                QObject::tr("Recorded update \"%1\" is not valid JSON.")
+                    .arg(entry.first);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return 1;
+        }
+
+        // Parsed updates
+        const QList < QJsonArray > batches =
+            GetBatches(update, mcIterations, next_id);
+        qint64 allocations = GetAllocationCount();
+        QElapsedTimer timer;
+        timer.start();
+        for (const QJsonArray & batch : batches)
+        {
+            tc -> Parse_UpdateArray(batch);
+        }
+        const qint64 update_ns = timer.nsecsElapsed();
+        const qint64 update_allocations = GetAllocationCount() - allocations;
+
+        // Entire getUpdates reply, starting with the raw bytes
+        QList < QByteArray > replies;
+        for (const QJsonArray & batch :
+            GetBatches(update, mcIterations, next_id))
+        {
+            QJsonObject reply;
+            reply["ok"] = true;
+            reply["result"] = batch;
+            replies << QJsonDocument(reply).toJson(QJsonDocument::Compact);
+        }
+        allocations = GetAllocationCount();
+        timer.start();
+        for (const QByteArray & reply : replies)
+        {
+            const QByteArray content = tc -> SkipKnownUpdates(reply);
+            tc -> Parse_Response(QJsonDocument::fromJson(content).object());
+        }
+        const qint64 response_ns = timer.nsecsElapsed();
+        const qint64 response_allocations =
+            GetAllocationCount() - allocations;
+
+        qDebug().noquote() << QString("%1  %2  %3")
+            .arg(entry.first.leftJustified(20, ' '),
+                 FormatResult(update_ns, update_allocations, mcIterations)
+                    .leftJustified(28, ' '),
+                 FormatResult(response_ns, response_allocations,
+                    mcIterations));
+    }
+
+    qDebug().noquote() << QObject::tr("(per update; includes saving to an "
+        "in-memory database)");
+    if (GetAllocationCount() < 0)
+    {
+        qDebug().noquote() << QObject::tr("(allocations are only counted "
+            "in builds with CONFIG+=count_allocations on glibc)");
+    }
+    StringPool::ShowStatistics();
+
+    // Internal formats
+    RunFormats(mcIterations);
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compare typed records and key/value info for parsed entities
+void ParserBenchmark::RunRecords(const int mcIterations)
+{
+    CALL_IN(QString("mcIterations=%1")
+        .arg(CALL_SHOW(mcIterations)));
+
+    TelegramComms * tc = TelegramComms::Instance();
+
+    qDebug().noquote() << QObject::tr("%1  %2  %3  %4")
+        .arg(QString().leftJustified(20, ' '),
+             QObject::tr("Parse (info/typed)").leftJustified(22, ' '),
+             QObject::tr("Access (info/typed)").leftJustified(22, ' '),
+             QObject::tr("Memory (info/typed)"));
+
+    // The checksum is only there so reading fields can't be optimized away
+    qint64 checksum = 0;
+    const QList < QPair < QString, QByteArray > > corpus = GetCorpus();
+    for (const QPair < QString, QByteArray > & entry : corpus)
+    {
+        const QJsonObject update =
+            QJsonDocument::fromJson(entry.second).object();
+
+        // Parsing: typed records are what the parser produces; key/value
+        // info used to be produced instead, which costs the same parsing
+        // plus putting together the info
+        QElapsedTimer timer;
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            ParsedEntities parsed;
+            tc -> Parse_Update(update, parsed);
+        }
+        const qint64 parse_typed_ns = timer.nsecsElapsed() / mcIterations;
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            ParsedEntities parsed;
+            tc -> Parse_Update(update, parsed);
+            ToHashed(parsed);
+        }
+        const qint64 parse_hashed_ns = timer.nsecsElapsed() / mcIterations;
+
+        // Reading fields
+        ParsedEntities parsed;
+        tc -> Parse_Update(update, parsed);
+        const HashedEntities hashed = ToHashed(parsed);
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            checksum += ReadFields(parsed);
+        }
+        const qint64 access_typed_ns = timer.nsecsElapsed() / mcIterations;
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            checksum += ReadFields(hashed);
+        }
+        const qint64 access_hashed_ns = timer.nsecsElapsed() / mcIterations;
+
+        // Memory: keep the results of parsing the update repeatedly (each
+        // parse has its own copies of the data)
+        QString memory = QObject::tr("n/a");
+        if (GetAllocatedBytes() >= 0)
+        {
+            QList < ParsedEntities > all_parsed;
+            all_parsed.reserve(mcIterations);
+            qint64 bytes = GetAllocatedBytes();
+            for (int count = 0; count < mcIterations; count++)
+            {
+                all_parsed << ParsedEntities();
+                tc -> Parse_Update(update, all_parsed.last());
+            }
+            const qint64 typed_bytes = GetAllocatedBytes() - bytes;
+            all_parsed.clear();
+
+            QList < HashedEntities > all_hashed;
+            all_hashed.reserve(mcIterations);
+            bytes = GetAllocatedBytes();
+            for (int count = 0; count < mcIterations; count++)
+            {
+                ParsedEntities temporary;
+                tc -> Parse_Update(update, temporary);
+                all_hashed << ToHashed(temporary);
+            }
+            const qint64 hashed_bytes = GetAllocatedBytes() - bytes;
+            all_hashed.clear();
+
+            memory = QObject::tr("%1/%2 bytes")
+                .arg(QString::number(hashed_bytes / mcIterations),
+                     QString::number(typed_bytes / mcIterations));
+        }
+
+        qDebug().noquote() << QString("%1  %2  %3  %4")
+            .arg(entry.first.leftJustified(20, ' '),
+                 QObject::tr("%1/%2 ns")
+                    .arg(QString::number(parse_hashed_ns),
+                         QString::number(parse_typed_ns))
+                    .leftJustified(22, ' '),
+                 QObject::tr("%1/%2 ns")
+                    .arg(QString::number(access_hashed_ns),
+                         QString::number(access_typed_ns))
+                    .leftJustified(22, ' '),
+                 memory);
+    }
+    qDebug().noquote() << QObject::tr("(per update, all entities in it; "
+        "checksum %1)").arg(QString::number(checksum));
+    if (GetAllocatedBytes() < 0)
+    {
+        qDebug().noquote() << QObject::tr("(memory is only measured in "
+            "builds with CONFIG+=count_allocations on glibc)");
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compare JSON text and CBOR for recorded updates and parsed entities
+void ParserBenchmark::RunFormats(const int mcIterations)
+{
+    CALL_IN(QString("mcIterations=%1")
+        .arg(CALL_SHOW(mcIterations)));
+
+    TelegramComms * tc = TelegramComms::Instance();
+
+    qDebug().noquote() << QObject::tr("%1  %2  %3")
+        .arg(QString().leftJustified(20, ' '),
+             QObject::tr("Update (JSON/CBOR)").leftJustified(32, ' '),
+             QObject::tr("Parsed entities (JSON/CBOR)"));
+
+    const QList < QPair < QString, QByteArray > > corpus = GetCorpus();
+    for (const QPair < QString, QByteArray > & entry : corpus)
+    {
+        // Update as received
+        const QJsonObject update =
+            QJsonDocument::fromJson(entry.second).object();
+        const QByteArray update_json =
+            QJsonDocument(update).toJson(QJsonDocument::Compact);
+        const QByteArray update_cbor =
+            QCborValue::fromJsonValue(update).toCbor();
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            QJsonDocument::fromJson(update_json).object();
+        }
+        const qint64 update_json_ns = timer.nsecsElapsed() / mcIterations;
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            QCborValue::fromCbor(update_cbor).toMap();
+        }
+        const qint64 update_cbor_ns = timer.nsecsElapsed() / mcIterations;
+
+        // Same thing after parsing
+        ParsedEntities parsed;
+        tc -> Parse_Update(update, parsed);
+        const QCborMap parsed_cbor_map = parsed.ToCbor();
+        const QByteArray parsed_json = QJsonDocument(
+            parsed_cbor_map.toJsonObject()).toJson(QJsonDocument::Compact);
+        const QByteArray parsed_cbor = parsed_cbor_map.toCborValue().toCbor();
+
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            ParsedEntities::FromCbor(QCborMap::fromJsonObject(
+                QJsonDocument::fromJson(parsed_json).object()));
+        }
+        const qint64 parsed_json_ns = timer.nsecsElapsed() / mcIterations;
+        timer.start();
+        for (int count = 0; count < mcIterations; count++)
+        {
+            ParsedEntities::FromCbor(
+                QCborValue::fromCbor(parsed_cbor).toMap());
+        }
+        const qint64 parsed_cbor_ns = timer.nsecsElapsed() / mcIterations;
+
+        qDebug().noquote() << QString("%1  %2  %3")
+            .arg(entry.first.leftJustified(20, ' '),
+                 QObject::tr("%1/%2 bytes, %3/%4 ns")
+                    .arg(QString::number(update_json.size()),
+                         QString::number(update_cbor.size()),
+                         QString::number(update_json_ns),
+                         QString::number(update_cbor_ns))
+                    .leftJustified(32, ' '),
+                 QObject::tr("%1/%2 bytes, %3/%4 ns")
+                    .arg(QString::number(parsed_json.size()),
+                         QString::number(parsed_cbor.size()),
+                         QString::number(parsed_json_ns),
+                         QString::number(parsed_cbor_ns)));
+    }
+    qDebug().noquote() << QObject::tr("(size and time to decode)");
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert parsed entities to key/value info
+ParserBenchmark::HashedEntities ParserBenchmark::ToHashed(
+    const ParsedEntities & mcrParsed)
+{
+    // No CALL_IN()/CALL_OUT(); this is what's being measured
+
+    HashedEntities hashed;
+    for (const UpdateRecord & update : mcrParsed.m_Updates)
+    {
+        hashed.m_Updates << update.ToHash();
+    }
+    for (const MessageRecord & message : mcrParsed.m_Messages)
+    {
+        hashed.m_Messages << message.ToHash();
+    }
+    for (const MessageRecord & message : mcrParsed.m_EditedMessages)
+    {
+        hashed.m_Messages << message.ToHash();
+    }
+    for (const UserRecord & user : mcrParsed.m_Users)
+    {
+        hashed.m_Users << user.ToHash();
+    }
+    for (const ChatRecord & chat : mcrParsed.m_Chats)
+    {
+        hashed.m_Chats << chat.ToHash();
+    }
+    for (const MyChatMemberRecord & my_chat_member :
+        mcrParsed.m_MyChatMembers)
+    {
+        hashed.m_MyChatMembers << my_chat_member.ToHash();
+    }
+    for (const FileRecord & file : mcrParsed.m_Files)
+    {
+        hashed.m_Files << file.ToHash();
+    }
+    for (const ChannelPostRecord & channel_post : mcrParsed.m_ChannelPosts)
+    {
+        hashed.m_ChannelPosts << channel_post.ToHash();
+    }
+    return hashed;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read the fields the bot commonly looks at (typed records)
+qint64 ParserBenchmark::ReadFields(const ParsedEntities & mcrParsed)
+{
+    // No CALL_IN()/CALL_OUT(); this is what's being measured
+
+    qint64 checksum = 0;
+    for (const UpdateRecord & update : mcrParsed.m_Updates)
+    {
+        checksum += update.m_ID + update.m_MessageID + update.m_ChatID +
+            update.m_Type.size();
+    }
+    for (const QList < MessageRecord > * messages :
+        { &mcrParsed.m_Messages, &mcrParsed.m_EditedMessages })
+    {
+        for (const MessageRecord & message : *messages)
+        {
+            checksum += message.m_ID + message.m_ChatID + message.m_FromID +
+                message.m_Date + message.m_Text.size();
+        }
+    }
+    for (const UserRecord & user : mcrParsed.m_Users)
+    {
+        checksum += user.m_ID + (user.m_IsBot ? 1 : 0) +
+            user.m_Username.size();
+    }
+    for (const ChatRecord & chat : mcrParsed.m_Chats)
+    {
+        checksum += chat.m_ID + chat.m_Type.size();
+    }
+    for (const MyChatMemberRecord & my_chat_member :
+        mcrParsed.m_MyChatMembers)
+    {
+        checksum += my_chat_member.m_ID + my_chat_member.m_ChatID +
+            my_chat_member.m_Date;
+    }
+    for (const FileRecord & file : mcrParsed.m_Files)
+    {
+        checksum += file.m_FileSize + file.m_Width + file.m_Height +
+            (file.m_IsAnimated ? 1 : 0) + file.m_SetName.size();
+    }
+    for (const ChannelPostRecord & channel_post : mcrParsed.m_ChannelPosts)
+    {
+        checksum += channel_post.m_ID + channel_post.m_ChatID +
+            channel_post.m_Date + channel_post.m_Caption.size();
+    }
+    return checksum;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read the fields the bot commonly looks at (key/value info)
+qint64 ParserBenchmark::ReadFields(const HashedEntities & mcrHashed)
+{
+    // No CALL_IN()/CALL_OUT(); this is what's being measured
+
+    // Time stamps are kept as text in key/value info
+    auto date = [](const QHash < QString, QString > & mcrInfo)
+    {
+        return QDateTime::fromString(mcrInfo.value("date_time"),
+            Qt::ISODate).toSecsSinceEpoch();
+    };
+
+    qint64 checksum = 0;
+    for (const QHash < QString, QString > & update : mcrHashed.m_Updates)
+    {
+        checksum += update.value("id").toLongLong() +
+            update.value("message_id").toLongLong() +
+            update.value("chat_id").toLongLong() +
+            update.value("type").size();
+    }
+    for (const QHash < QString, QString > & message : mcrHashed.m_Messages)
+    {
+        checksum += message.value("id").toLongLong() +
+            message.value("chat_id").toLongLong() +
+            message.value("from_id").toLongLong() +
+            date(message) +
+            message.value("text").size();
+    }
+    for (const QHash < QString, QString > & user : mcrHashed.m_Users)
+    {
+        checksum += user.value("id").toLongLong() +
+            (user.value("is_bot") == "true" ? 1 : 0) +
+            user.value("username").size();
+    }
+    for (const QHash < QString, QString > & chat : mcrHashed.m_Chats)
+    {
+        checksum += chat.value("id").toLongLong() +
+            chat.value("type").size();
+    }
+    for (const QHash < QString, QString > & my_chat_member :
+        mcrHashed.m_MyChatMembers)
+    {
+        checksum += my_chat_member.value("id").toLongLong() +
+            my_chat_member.value("chat_id").toLongLong() +
+            date(my_chat_member);
+    }
+    for (const QHash < QString, QString > & file : mcrHashed.m_Files)
+    {
+        checksum += file.value("file_size").toLongLong() +
+            file.value("width").toInt() +
+            file.value("height").toInt() +
+            (file.value("is_animated") == "true" ? 1 : 0) +
+            file.value("set_name").size();
+    }
+    for (const QHash < QString, QString > & channel_post :
+        mcrHashed.m_ChannelPosts)
+    {
+        checksum += channel_post.value("id").toLongLong() +
+            channel_post.value("chat_id").toLongLong() +
+            date(channel_post) +
+            channel_post.value("caption").size();
+    }
+    return checksum;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Copies of an update with new IDs, in batches like getUpdates returns them
+QList < QJsonArray > ParserBenchmark::GetBatches(const QJsonObject & mcrUpdate,
+    const int mcCount, qint64 & mrNextID)
+{
+    CALL_IN_LAZY(QString("mcrUpdate=%1, mcCount=%2, mrNextID=%3")
+        .arg(CALL_SHOW(mcrUpdate),
+             CALL_SHOW(mcCount),
+             CALL_SHOW(mrNextID)));
+
+    // getUpdates returns up to 100 updates at a time
+    const int batch_size = 100;
+
+    // Every update needs its own IDs; otherwise we'd only measure
+    // the lookup of previously parsed updates.
+    QList < QJsonArray > batches;
+    QJsonArray batch;
+    for (int count = 0; count < mcCount; count++)
+    {
+        batch << WithNewIDs(mcrUpdate, mrNextID);
+        mrNextID++;
+        if (batch.size() == batch_size)
+        {
+            batches << batch;
+            batch = QJsonArray();
+        }
+    }
+    if (!batch.isEmpty())
+    {
+        batches << batch;
+    }
+
+    CALL_OUT("");
+    return batches;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Time and allocations per update
+QString ParserBenchmark::FormatResult(const qint64 mcNanoseconds,
+    const qint64 mcAllocations, const int mcCount)
+{
+    CALL_IN(QString("mcNanoseconds=%1, mcAllocations=%2, mcCount=%3")
+        .arg(CALL_SHOW(mcNanoseconds),
+             CALL_SHOW(mcAllocations),
+             CALL_SHOW(mcCount)));
+
+    QString result = QObject::tr("%1 ns")
+        .arg(QString::number(mcNanoseconds / mcCount));
+    if (mcAllocations >= 0)
+    {
+        result += QObject::tr(", %1 allocs")
+            .arg(QString::number(double(mcAllocations) / mcCount, 'f', 1));
+    }
+
+    CALL_OUT("");
+    return result;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Recorded updates (name, JSON)
+QList < QPair < QString, QByteArray > > ParserBenchmark::GetCorpus()
+{
+    CALL_IN("");
+
+    QList < QPair < QString, QByteArray > > corpus;
+
+    corpus << QPair < QString, QByteArray >("text message", R"({
+        "update_id":494953278,
+        "message":{
+            "message_id":5,
+            "from":{"id":725804777,"is_bot":false,"is_premium":true,
+                "first_name":"Shimaron","last_name":"Greywolf",
+                "username":"shimarongreywolf","language_code":"en"},
+            "chat":{"id":725804777,"first_name":"Shimaron",
+                "last_name":"Greywolf","username":"shimarongreywolf",
+                "type":"private"},
+            "date":1737148752,
+            "text":"Hey there!"
+        }
+    })");
+
+    corpus << QPair < QString, QByteArray >("sticker", R"({
+        "update_id":494953279,
+        "message":{
+            "message_id":6,
+            "from":{"id":725804777,"is_bot":false,"is_premium":true,
+                "first_name":"Shimaron","last_name":"Greywolf",
+                "username":"shimarongreywolf","language_code":"en"},
+            "chat":{"id":725804777,"first_name":"Shimaron",
+                "last_name":"Greywolf","username":"shimarongreywolf",
+                "type":"private"},
+            "date":1737148760,
+            "sticker":{"width":512,"height":512,"emoji":"\ud83d\ude04",
+                "set_name":"shimarongreywolf","is_animated":false,
+                "is_video":false,"type":"regular",
+                "thumbnail":{"file_id":"AAMCAgADGQEAAQ","file_size":5416,
+                    "file_unique_id":"AQADx1QAAnN","width":128,"height":128},
+                "file_id":"CAACAgIAAxkBAAEBZ2VnnJ",
+                "file_unique_id":"AgADx1QAAnN","file_size":25946}
+        }
+    })");
+
+    corpus << QPair < QString, QByteArray >("photo", R"({
+        "update_id":494953282,
+        "message":{
+            "message_id":7,
+            "from":{"id":725804777,"is_bot":false,"is_premium":true,
+                "first_name":"Shimaron","last_name":"Greywolf",
+                "username":"shimarongreywolf","language_code":"en"},
+            "chat":{"id":725804777,"first_name":"Shimaron",
+                "last_name":"Greywolf","username":"shimarongreywolf",
+                "type":"private"},
+            "date":1737148770,
+            "caption":"Look at this",
+            "photo":[
+                {"file_id":"AgACAgIAAxkBAAIBB1","file_size":1203,
+                    "file_unique_id":"AQADv9kxG1","height":67,"width":90},
+                {"file_id":"AgACAgIAAxkBAAIBB2","file_size":16874,
+                    "file_unique_id":"AQADv9kxG2","height":240,"width":320},
+                {"file_id":"AgACAgIAAxkBAAIBB3","file_size":70432,
+                    "file_unique_id":"AQADv9kxG3","height":600,"width":800}
+            ]
+        }
+    })");
+
+    corpus << QPair < QString, QByteArray >("document", R"({
+        "update_id":494953283,
+        "message":{
+            "message_id":8,
+            "from":{"id":725804777,"is_bot":false,"is_premium":true,
+                "first_name":"Shimaron","last_name":"Greywolf",
+                "username":"shimarongreywolf","language_code":"en"},
+            "chat":{"id":725804777,"first_name":"Shimaron",
+                "last_name":"Greywolf","username":"shimarongreywolf",
+                "type":"private"},
+            "date":1737148780,
+            "document":{"file_name":"report.pdf",
+                "mime_type":"application/pdf",
+                "thumbnail":{"file_id":"AAMCAQADGQEAAgEI","file_size":9104,
+                    "file_unique_id":"AQADqAUAAk1","width":226,"height":320},
+                "file_id":"BQACAgEAAxkBAAIBCGec","file_unique_id":"AgADqAUAAk",
+                "file_size":222334}
+        }
+    })");
+
+    corpus << QPair < QString, QByteArray >("channel post", R"({
+        "update_id":494953280,
+        "channel_post":{
+            "caption":"Post caption",
+            "caption_entities":[{"length":13,"offset":26,"type":"mention"}],
+            "chat":{"id":-1001732480834,"title":"Feral Temptation",
+                "type":"channel","username":"feraltemptation"},
+            "date":1746077870,
+            "message_id":73,
+            "photo":[
+                {"file_id":"AgACAgQAAx0Ccm1","file_size":434,
+                    "file_unique_id":"AQADs7gxG1","height":18,"width":90},
+                {"file_id":"AgACAgQAAx0Ccm2","file_size":35270,
+                    "file_unique_id":"AQADs7gxG2","height":253,"width":1280}
+            ],
+            "sender_chat":{"id":-1001732480834,"title":"Feral Temptation",
+                "type":"channel","username":"feraltemptation"}
+        }
+    })");
+
+    corpus << QPair < QString, QByteArray >("my_chat_member", R"({
+        "update_id":494953281,
+        "my_chat_member":{
+            "chat":{"id":-1002375397830,"title":"ShimaTest",
+                "type":"supergroup"},
+            "from":{"id":725804777,"is_bot":false,"is_premium":true,
+                "first_name":"Shimaron","last_name":"Greywolf",
+                "username":"shimarongreywolf","language_code":"en"},
+            "date":1737146726,
+            "old_chat_member":{
+                "user":{"id":7654321,"is_bot":true,"first_name":"Bot",
+                    "username":"simple_bot"},
+                "status":"member"},
+            "new_chat_member":{
+                "user":{"id":7654321,"is_bot":true,"first_name":"Bot",
+                    "username":"simple_bot"},
+                "status":"administrator","can_be_edited":false,
+                "can_change_info":true,"can_delete_messages":true,
+                "can_invite_users":true,"can_manage_chat":true,
+                "can_pin_messages":true,"is_anonymous":false,
+                "until_date":0}
+        }
+    })");
+
+    CALL_OUT("");
+    return corpus;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Copy of an update with new IDs (so it will actually be parsed)
+QJsonObject ParserBenchmark::WithNewIDs(const QJsonObject & mcrUpdate,
+    const qint64 mcID)
+{
+    CALL_IN_LAZY(QString("mcrUpdate=%1, mcID=%2")
+        .arg(CALL_SHOW(mcrUpdate),
+             CALL_SHOW(mcID)));
+
+    QJsonObject update = mcrUpdate;
+    update["update_id"] = mcID;
+
+    // Messages and channel posts are identified by their message ID
+    static const QStringList message_keys =
+    {
+        "channel_post",
+        "edited_channel_post",
+        "edited_message",
+        "message"
+    };
+    for (const QString & key : message_keys)
+    {
+        if (update.contains(key))
+        {
+            QJsonObject message = update[key].toObject();
+            message["message_id"] = mcID;
+            update[key] = message;
+        }
+    }
+
+    // Chat member updates by their date
+    if (update.contains("my_chat_member"))
+    {
+        QJsonObject my_chat_member = update["my_chat_member"].toObject();
+        my_chat_member["date"] = mcID;
+        update["my_chat_member"] = my_chat_member;
+    }
+
+    CALL_OUT("");
+    return update;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocations so far (-1 if they're not counted)
+qint64 ParserBenchmark::GetAllocationCount()
+{
+    // No CALL_IN()/CALL_OUT(); they would allocate themselves
+
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+    return allocation_count.load();
+#else
+    return -1;
+#endif
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Bytes currently allocated (-1 if they're not counted)
+qint64 ParserBenchmark::GetAllocatedBytes()
+{
+    // No CALL_IN()/CALL_OUT(); they would allocate themselves
+
+#if defined(COUNT_ALLOCATIONS) && defined(__GLIBC__)
+    return allocated_bytes.load();
+#else
+    return -1;
+#endif
+}
@@ -0,0 +1,99 @@
+// ParserBenchmark.h
+// Class definition
+
+// Measures how long it takes to parse typical updates, both as parsed
+// updates (Parse_UpdateArray) and as raw getUpdates replies
+// (Parse_Response). Run the bot with --benchmark to use it. Allocations
+// per update are reported in builds with CONFIG+=count_allocations (glibc
+// only). Also compares typed records with the key/value info they replaced
+// (parse cost, field access, memory) and JSON text and CBOR as internal
+// formats.
+
+#ifndef PARSERBENCHMARK_H
+#define PARSERBENCHMARK_H
+
+// Project includes
+#include "TelegramRecords.h"
+
+// Qt includes
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+// Class definition
+class ParserBenchmark
+{
+    // ============================================================== Lifecycle
+private:
+    // Never to be instanciated
+    ParserBenchmark();
+
+public:
+    // Destructor
+    ~ParserBenchmark();
+
+
+
+    // ============================================================== Benchmark
+public:
+    // Run benchmark (returns exit code)
+    static int Run(const int mcIterations);
+
+private:
+    // Compare typed records and key/value info for parsed entities
+    static void RunRecords(const int mcIterations);
+
+    // Compare JSON text and CBOR for recorded updates and parsed entities
+    static void RunFormats(const int mcIterations);
+
+private:
+    // Parsed entities as key/value info (the way they were kept before
+    // there were typed records)
+    struct HashedEntities
+    {
+        QList < QHash < QString, QString > > m_Updates;
+        QList < QHash < QString, QString > > m_Messages;
+        QList < QHash < QString, QString > > m_Users;
+        QList < QHash < QString, QString > > m_Chats;
+        QList < QHash < QString, QString > > m_MyChatMembers;
+        QList < QHash < QString, QString > > m_Files;
+        QList < QHash < QString, QString > > m_ChannelPosts;
+    };
+
+    // Convert parsed entities to key/value info
+    static HashedEntities ToHashed(const ParsedEntities & mcrParsed);
+
+    // Read the fields the bot commonly looks at (returns a checksum, so
+    // the compiler can't skip reading them)
+    static qint64 ReadFields(const ParsedEntities & mcrParsed);
+    static qint64 ReadFields(const HashedEntities & mcrHashed);
+
+private:
+    // Recorded updates (name, JSON)
+    static QList < QPair < QString, QByteArray > > GetCorpus();
+
+    // Copies of an update with new IDs, in batches like getUpdates
+    // returns them
+    static QList < QJsonArray > GetBatches(const QJsonObject & mcrUpdate,
+        const int mcCount, qint64 & mrNextID);
+
+    // Copy of an update with new IDs (so it will actually be parsed)
+    static QJsonObject WithNewIDs(const QJsonObject & mcrUpdate,
+        const qint64 mcID);
+
+    // Time and allocations per update
+    static QString FormatResult(const qint64 mcNanoseconds,
+        const qint64 mcAllocations, const int mcCount);
+
+    // Allocations so far (-1 if they're not counted)
+    static qint64 GetAllocationCount();
+
+    // Bytes currently allocated (-1 if they're not counted)
+    static qint64 GetAllocatedBytes();
+};
+
+#endif
@@ -0,0 +1,173 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// ParserFuzzer.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "ParserFuzzer.h"
+#include "TelegramComms.h"
+
+// Qt includes
+#include <QCoreApplication>
+#include <QJsonDocument>
+
+// System includes
+#include <cstddef>
+#include <cstdint>
+
+
+
+// libFuzzer entry point
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * mcpData,
+    size_t mcSize)
+{
+    ParserFuzzer::TestOneInput(QByteArray(
+        reinterpret_cast < const char * >(mcpData), qsizetype(mcSize)));
+    return 0;
+}
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Never to be instanciated
+ParserFuzzer::ParserFuzzer()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ParserFuzzer::~ParserFuzzer()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+// ==================================================================== Fuzzing
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Feed one input to the parser
+void ParserFuzzer::TestOneInput(const QByteArray & mcrData)
+{
+    CALL_IN(QString("mcrData=%1")
+        .arg(CALL_SHOW(mcrData)));
+
+    Initialize();
+    TelegramComms * tc = TelegramComms::Instance();
+
+    // Same path as a getUpdates reply
+    const QByteArray content = tc -> SkipKnownUpdates(mcrData);
+    const QJsonDocument document = QJsonDocument::fromJson(content);
+    if (!document.isObject())
+    {
+        // Not for us.
+        CALL_OUT("");
+        return;
+    }
+    const QJsonObject response = document.object();
+
+    // File info would start a download; parse it without one
+    const QJsonObject result = response["result"].toObject();
+    if (result.contains("file_path"))
+    {
+        ParsedEntities parsed;
+        tc -> Parse_File(result, parsed);
+        tc -> CommitParsedEntities(parsed);
+    } else
+    {
+        tc -> Parse_Response(response);
+    }
+
+    // Also try it as a single update
+    ParsedEntities parsed;
+    tc -> Parse_Update(response, parsed);
+    tc -> CommitParsedEntities(parsed);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// One-time setup
+void ParserFuzzer::Initialize()
+{
+    CALL_IN("");
+
+    if (m_Initialized)
+    {
+        // Nothing to do.
+        CALL_OUT("");
+        return;
+    }
+    m_Initialized = true;
+
+    // Qt needs an application object (e.g. for the SQL driver); libFuzzer
+    // owns the actual command line
+    static int argc = 1;
+    static char name[] = "ParserFuzzer";
+    static char * argv[] = { name, nullptr };
+    new QCoreApplication(argc, argv);
+    qInstallMessageHandler(DiscardMessage);
+
+    // Parsed data goes into a throw-away database
+    TelegramComms * tc = TelegramComms::Instance();
+    tc -> SetDatabaseFile(":memory:");
+    tc -> OpenDatabase();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Initialized
+bool ParserFuzzer::m_Initialized = false;
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Discard log output
+void ParserFuzzer::DiscardMessage(QtMsgType mType,
+    const QMessageLogContext & mcrContext, const QString & mcrMessage)
+{
+    // No CALL_IN()/CALL_OUT(); this may be called from within CallTracer
+
+    Q_UNUSED(mType);
+    Q_UNUSED(mcrContext);
+    Q_UNUSED(mcrMessage);
+}
@@ -0,0 +1,46 @@
+// ParserFuzzer.h
+// Class definition
+
+// Entry point for fuzzing the Telegram response parser with libFuzzer.
+// Build with qmake CONFIG+=fuzz (needs clang); the resulting binary takes
+// the usual libFuzzer arguments (e.g. a corpus directory) instead of
+// running the bot.
+
+#ifndef PARSERFUZZER_H
+#define PARSERFUZZER_H
+
+// Qt includes
+#include <QByteArray>
+#include <QtGlobal>
+#include <QString>
+
+// Class definition
+class ParserFuzzer
+{
+    // ============================================================== Lifecycle
+private:
+    // Never to be instanciated
+    ParserFuzzer();
+
+public:
+    // Destructor
+    ~ParserFuzzer();
+
+
+
+    // ================================================================ Fuzzing
+public:
+    // Feed one input to the parser
+    static void TestOneInput(const QByteArray & mcrData);
+
+private:
+    // One-time setup (application, database)
+    static void Initialize();
+    static bool m_Initialized;
+
+    // Parse errors are expected; don't flood the console with them
+    static void DiscardMessage(QtMsgType mType,
+        const QMessageLogContext & mcrContext, const QString & mcrMessage);
+};
+
+#endif
@@ -0,0 +1,290 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// ScalerBenchmark.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Config.h"
+#include "ImageScaler.h"
+#include "MessageLogger.h"
+#include "ScalerBenchmark.h"
+
+// Qt includes
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QtMath>
+
+// Size of contact sheet tiles
+#define TILE_SIZE 200
+
+// Number of downloaded stickers to include
+#define MAX_STICKERS 10
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Never to be instanciated
+ScalerBenchmark::ScalerBenchmark()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+ScalerBenchmark::~ScalerBenchmark()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+// ================================================================== Benchmark
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Run benchmark (returns exit code)
+int ScalerBenchmark::Run(const int mcIterations)
+{
+    CALL_IN(QString("mcIterations=%1")
+        .arg(CALL_SHOW(mcIterations)));
+
+    // Implementations available on this CPU
+    QList < ImageScaler::Implementation > implementations;
+    implementations << ImageScaler::Implementation_Scalar
+        << ImageScaler::Implementation_SSE2
+        << ImageScaler::Implementation_AVX2;
+    for (int index = implementations.size() - 1; index >= 0; index--)
+    {
+        if (!ImageScaler::IsAvailable(implementations[index]))
+        {
+            implementations.removeAt(index);
+        }
+    }
+
+    QString header = QString().leftJustified(24, ' ') + "  " +
+        QObject::tr("Qt").leftJustified(10, ' ');
+    for (const ImageScaler::Implementation implementation : implementations)
+    {
+        header += "  " + ImageScaler::GetImplementationName(implementation)
+            .leftJustified(10, ' ');
+    }
+    header += "  " + QObject::tr("Difference to Qt (max/mean)");
+    qDebug().noquote() << header;
+
+    const QList < QPair < QString, QImage > > images = GetImages();
+    for (const QPair < QString, QImage > & entry : images)
+    {
+        // Qt
+        const QImage & image = entry.second;
+        QElapsedTimer timer;
+        timer.start();
+        QImage reference;
+        for (int count = 0; count < mcIterations; count++)
+        {
+            reference = image.scaled(TILE_SIZE, TILE_SIZE,
+                Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+        const qint64 reference_ns = timer.nsecsElapsed() / mcIterations;
+        reference =
+            reference.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QString line = entry.first.leftJustified(24, ' ') + "  " +
+            QObject::tr("%1 us")
+                .arg(QString::number(reference_ns / 1000))
+                .leftJustified(10, ' ');
+
+        // Area averaging; all implementations must agree
+        QImage first_result;
+        for (const ImageScaler::Implementation implementation :
+            implementations)
+        {
+            QImage result;
+            timer.start();
+            for (int count = 0; count < mcIterations; count++)
+            {
+                result = ImageScaler::ScaleToFit(image, TILE_SIZE,
+                    implementation);
+            }
+            const qint64 result_ns = timer.nsecsElapsed() / mcIterations;
+            line += "  " + QObject::tr("%1 us")
+                .arg(QString::number(result_ns / 1000))
+                .leftJustified(10, ' ');
+
+            if (first_result.isNull())
+            {
+                first_result = result;
+            } else if (result != first_result)
+            {
+                const QString reason = QObject::tr("%1 and %2 results differ "
+                    "for \"%3\".")
+                    .arg(ImageScaler::GetImplementationName(
+                            implementations.first()),
+                         ImageScaler::GetImplementationName(implementation),
+                         entry.first);
+                MessageLogger::Error(CALL_METHOD, reason);
+                CALL_OUT(reason);
+                return 1;
+            }
+        }
+        line += "  " + Compare(first_result, reference);
+        qDebug().noquote() << line;
+    }
+    qDebug().noquote() << QObject::tr("(per image, scaled to fit %1x%1; "
+        "differences per channel, premultiplied)")
+        .arg(QString::number(TILE_SIZE));
+
+    CALL_OUT("");
+    return 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Images to scale (name, image)
+QList < QPair < QString, QImage > > ScalerBenchmark::GetImages()
+{
+    CALL_IN("");
+
+    QList < QPair < QString, QImage > > images;
+
+    // Sharp edges and noise (fixed seed, so runs are comparable)
+    QImage noise(512, 512, QImage::Format_ARGB32_Premultiplied);
+    quint32 seed = 1;
+    for (int y = 0; y < noise.height(); y++)
+    {
+        QRgb * line = reinterpret_cast < QRgb * >(noise.scanLine(y));
+        for (int x = 0; x < noise.width(); x++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            const int alpha = (seed >> 24) & 0xFF;
+            line[x] = qPremultiply(qRgba((seed >> 16) & 0xFF,
+                (seed >> 8) & 0xFF, x / 2, alpha));
+        }
+    }
+    images << qMakePair(QObject::tr("noise 512x512"), noise);
+
+    // Smooth gradient with transparent corners, like most stickers
+    QImage gradient(512, 512, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < gradient.height(); y++)
+    {
+        QRgb * line = reinterpret_cast < QRgb * >(gradient.scanLine(y));
+        for (int x = 0; x < gradient.width(); x++)
+        {
+            const int distance = qMin(255,
+                int(qSqrt((x - 256) * (x - 256) + (y - 256) * (y - 256))));
+            line[x] = qPremultiply(qRgba(x / 2, y / 2, 255 - x / 2,
+                255 - distance));
+        }
+    }
+    images << qMakePair(QObject::tr("gradient 512x512"), gradient);
+    images << qMakePair(QObject::tr("gradient 512x300"),
+        gradient.copy(0, 100, 512, 300));
+
+    // Downloaded stickers (those we can read)
+    QDir files(BOT_FILES);
+    const QStringList filenames = files.entryList(QDir::Files, QDir::Name);
+    int num_stickers = 0;
+    for (const QString & filename : filenames)
+    {
+        if (num_stickers == MAX_STICKERS)
+        {
+            break;
+        }
+        QFile file(BOT_FILES + filename);
+        if (!file.open(QIODevice::ReadOnly))
+        {
+            continue;
+        }
+        const QImage sticker = QImage::fromData(file.readAll());
+        if (sticker.isNull() ||
+            sticker.width() < TILE_SIZE ||
+            sticker.height() < TILE_SIZE)
+        {
+            continue;
+        }
+        images << qMakePair(QObject::tr("sticker %1x%2")
+                .arg(QString::number(sticker.width()),
+                     QString::number(sticker.height())),
+            sticker.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+        num_stickers++;
+    }
+
+    CALL_OUT("");
+    return images;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Largest and average difference per channel
+QString ScalerBenchmark::Compare(const QImage & mcrImage,
+    const QImage & mcrReference)
+{
+    CALL_IN(QString("mcrImage=%1, mcrReference=%2")
+        .arg(CALL_SHOW(mcrImage),
+             CALL_SHOW(mcrReference)));
+
+    if (mcrImage.size() != mcrReference.size())
+    {
+        const QString result = QObject::tr("different sizes");
+        CALL_OUT("");
+        return result;
+    }
+
+    int max_difference = 0;
+    qint64 total_difference = 0;
+    for (int y = 0; y < mcrImage.height(); y++)
+    {
+        const uchar * image_line = mcrImage.constScanLine(y);
+        const uchar * reference_line = mcrReference.constScanLine(y);
+        for (int index = 0; index < 4 * mcrImage.width(); index++)
+        {
+            const int difference =
+                qAbs(int(image_line[index]) - int(reference_line[index]));
+            max_difference = qMax(max_difference, difference);
+            total_difference += difference;
+        }
+    }
+    const double mean_difference = double(total_difference) /
+        (4.0 * mcrImage.width() * mcrImage.height());
+    const QString result = QString("%1/%2")
+        .arg(QString::number(max_difference),
+             QString::number(mean_difference, 'f', 2));
+
+    CALL_OUT("");
+    return result;
+}
@@ -0,0 +1,48 @@
+// ScalerBenchmark.h
+// Class definition
+
+// Measures how long it takes to scale stickers down to contact sheet tiles,
+// with Qt (SmoothTransformation) and with each ImageScaler implementation
+// available on this CPU, and how far the results are from Qt's. Uses a
+// few generated images and (if there are any) downloaded stickers. Run the
+// bot with --benchmark-scaler to use it. Fails if the implementations
+// don't give identical results.
+
+#ifndef SCALERBENCHMARK_H
+#define SCALERBENCHMARK_H
+
+// Qt includes
+#include <QImage>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+// Class definition
+class ScalerBenchmark
+{
+    // ============================================================== Lifecycle
+private:
+    // Never to be instanciated
+    ScalerBenchmark();
+
+public:
+    // Destructor
+    ~ScalerBenchmark();
+
+
+
+    // ============================================================== Benchmark
+public:
+    // Run benchmark (returns exit code)
+    static int Run(const int mcIterations);
+
+private:
+    // Images to scale (name, image)
+    static QList < QPair < QString, QImage > > GetImages();
+
+    // Largest and average difference per channel
+    static QString Compare(const QImage & mcrImage,
+        const QImage & mcrReference);
+};
+
+#endif
@@ -0,0 +1,215 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// StickerSetCheck.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "MessageLogger.h"
+#include "StickerSetCheck.h"
+#include "TelegramComms.h"
+#include "TelegramHelper.h"
+
+// Qt includes
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QObject>
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Never to be instanciated
+StickerSetCheck::StickerSetCheck()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+StickerSetCheck::~StickerSetCheck()
+{
+    CALL_IN("");
+
+    // Do nothing.
+
+    CALL_OUT("");
+}
+
+
+
+// ===================================================================== Checks
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Run checks (returns exit code)
+int StickerSetCheck::Run()
+{
+    CALL_IN("");
+
+    // Nothing goes to the server without a token; everything else goes
+    // into a throw-away database
+    TelegramComms * tc = TelegramComms::Instance();
+    tc -> SetDatabaseFile(":memory:");
+    if (!tc -> OpenDatabase())
+    {
+        const QString reason = QObject::tr("Could not open database.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return 1;
+    }
+    TelegramHelper * th = TelegramHelper::Instance();
+    int num_failed_sets = 0;
+    QObject::connect(th, &TelegramHelper::StickerSetFailed,
+        [&num_failed_sets](const QString &, const bool)
+        {
+            num_failed_sets++;
+        });
+    int num_received_sets = 0;
+    QObject::connect(th, &TelegramHelper::StickerSetReceived,
+        [&num_received_sets](const QString &)
+        {
+            num_received_sets++;
+        });
+
+    bool success = true;
+
+    // Prefetching a set that doesn't exist
+    const QString missing_set = "SimpleTelegramBot_Check_Missing";
+    th -> PrefetchStickerSet(missing_set);
+    success &= Check(th -> IsStickerSetBeingPrefetched(missing_set),
+        QObject::tr("Prefetch starts"));
+    emit tc -> StickerSetInfoFailed(missing_set, true);
+    success &= Check(!th -> IsStickerSetBeingPrefetched(missing_set) &&
+        !th -> IsStickerSetBeingDownloaded(missing_set),
+        QObject::tr("Failed info request releases prefetch"));
+    th -> PrefetchStickerSet(missing_set);
+    success &= Check(!th -> IsStickerSetBeingPrefetched(missing_set),
+        QObject::tr("Set that doesn't exist isn't prefetched again"));
+
+    // Asking for it anyway
+    th -> DownloadStickerSet(missing_set);
+    success &= Check(th -> IsStickerSetBeingDownloaded(missing_set),
+        QObject::tr("Download starts after failed prefetch"));
+    emit tc -> StickerSetInfoFailed(missing_set, true);
+    success &= Check(!th -> IsStickerSetBeingDownloaded(missing_set),
+        QObject::tr("Failed info request releases download"));
+
+    // Prefetching when the request fails for other reasons
+    const QString other_set = "SimpleTelegramBot_Check_Other";
+    th -> PrefetchStickerSet(other_set);
+    emit tc -> StickerSetInfoFailed(other_set, false);
+    success &= Check(!th -> IsStickerSetBeingPrefetched(other_set),
+        QObject::tr("Failed info request releases prefetch (network)"));
+    th -> PrefetchStickerSet(other_set);
+    success &= Check(th -> IsStickerSetBeingPrefetched(other_set),
+        QObject::tr("Prefetch can be tried again"));
+
+    // Prefetch turned into a download, which fails
+    th -> DownloadStickerSet(other_set);
+    success &= Check(th -> IsStickerSetBeingDownloaded(other_set) &&
+        !th -> IsStickerSetBeingPrefetched(other_set),
+        QObject::tr("Asking promotes prefetch to download"));
+    emit tc -> StickerSetInfoFailed(other_set, false);
+    success &= Check(!th -> IsStickerSetBeingDownloaded(other_set) &&
+        !th -> IsStickerSetBeingPrefetched(other_set),
+        QObject::tr("Failed info request releases promoted prefetch"));
+
+    // Prefetch turned into a download while its stickers are still on
+    // their way (sticker set info as the server would send it)
+    const QString pending_set = "SimpleTelegramBot_Check_Pending";
+    th -> PrefetchStickerSet(pending_set);
+    QJsonArray stickers;
+    for (int number = 1; number <= 2; number++)
+    {
+        QJsonObject sticker;
+        sticker["file_id"] = QString("SimpleTelegramBot_Check_File_%1")
+            .arg(number);
+        sticker["file_unique_id"] =
+            QString("SimpleTelegramBot_Check_Unique_%1").arg(number);
+        sticker["file_size"] = 1000;
+        sticker["width"] = 512;
+        sticker["height"] = 512;
+        sticker["is_animated"] = false;
+        sticker["is_video"] = false;
+        sticker["type"] = "regular";
+        sticker["set_name"] = pending_set;
+        stickers.append(sticker);
+    }
+    QJsonObject sticker_set;
+    sticker_set["name"] = pending_set;
+    sticker_set["title"] = pending_set;
+    sticker_set["sticker_type"] = "regular";
+    sticker_set["stickers"] = stickers;
+    tc -> Parse_StickerSet(sticker_set);
+    success &= Check(th -> IsStickerSetBeingPrefetched(pending_set),
+        QObject::tr("Prefetch waits for its stickers"));
+    th -> DownloadStickerSet(pending_set);
+    success &= Check(th -> IsStickerSetBeingDownloaded(pending_set) &&
+        !th -> IsStickerSetBeingPrefetched(pending_set),
+        QObject::tr("Asking promotes prefetch with stickers pending"));
+    success &= Check(num_received_sets == 0 &&
+        !th -> DoesStickerSetZIPFileExist(pending_set),
+        QObject::tr("Promoted prefetch isn't finished before its stickers "
+            "are there"));
+
+    // Every download that was given up has been reported
+    success &= Check(num_failed_sets == 4,
+        QObject::tr("Failures reported (%1 of 4)")
+            .arg(QString::number(num_failed_sets)));
+
+    CALL_OUT("");
+    return success ? 0 : 1;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Report the result of a single check
+bool StickerSetCheck::Check(const bool mcSuccess,
+    const QString & mcrDescription)
+{
+    CALL_IN(QString("mcSuccess=%1, mcrDescription=%2")
+        .arg(CALL_SHOW(mcSuccess),
+             CALL_SHOW(mcrDescription)));
+
+    if (!mcSuccess)
+    {
+        const QString reason = QObject::tr("Check failed: %1")
+            .arg(mcrDescription);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    qDebug().noquote() << QObject::tr("OK: %1").arg(mcrDescription);
+
+    CALL_OUT("");
+    return true;
+}
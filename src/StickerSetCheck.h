@@ -0,0 +1,41 @@
+// StickerSetCheck.h
+// Class definition
+
+// Checks that sticker set downloads and prefetches are released when the
+// sticker set info can't be had (the set doesn't exist, or the request
+// failed), so they can be asked for again, and that a prefetch somebody
+// asks for isn't finished before its stickers are there. Runs without a
+// token (nothing is sent to the server) on a throw-away database; server
+// responses are simulated. Run the bot with --check-sticker-sets to use it.
+
+#ifndef STICKERSETCHECK_H
+#define STICKERSETCHECK_H
+
+// Qt includes
+#include <QString>
+
+// Class definition
+class StickerSetCheck
+{
+    // ============================================================== Lifecycle
+private:
+    // Never to be instanciated
+    StickerSetCheck();
+
+public:
+    // Destructor
+    ~StickerSetCheck();
+
+
+
+    // ================================================================= Checks
+public:
+    // Run checks (returns exit code)
+    static int Run();
+
+private:
+    // Report the result of a single check
+    static bool Check(const bool mcSuccess, const QString & mcrDescription);
+};
+
+#endif
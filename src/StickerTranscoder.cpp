@@ -0,0 +1,372 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// StickerTranscoder.cpp
+// Class implementation
+
+// Project includes
+#include "CallTracer.h"
+#include "Config.h"
+#include "MessageLogger.h"
+#include "StickerTranscoder.h"
+#include "TelegramComms.h"
+
+// Qt includes
+#include <QDir>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+// System includes
+#include <zlib.h>
+
+// Where converted stickers are stored
+#define TRANSCODED_FILES (BOT_FILES + "Converted/")
+
+
+
+// ================================================================== Lifecycle
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Constructor
+StickerTranscoder::StickerTranscoder()
+{
+    CALL_IN("");
+
+    // Create directory
+    QDir files("/");
+    if (!files.exists(TRANSCODED_FILES))
+    {
+        files.mkpath(TRANSCODED_FILES);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Destructor
+StickerTranscoder::~StickerTranscoder()
+{
+    CALL_IN("");
+
+    // Let running conversions finish
+    m_ThreadPool.waitForDone();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instanciator
+StickerTranscoder * StickerTranscoder::Instance()
+{
+    CALL_IN("");
+
+    // Check if we already have an instance
+    if (!m_Instance)
+    {
+        // Nope. Create one.
+        m_Instance = new StickerTranscoder;
+    }
+
+    // Return instance
+    CALL_OUT("");
+    return m_Instance;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Instance
+StickerTranscoder * StickerTranscoder::m_Instance = nullptr;
+
+
+
+// ================================================================ Transcoding
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert a downloaded sticker
+void StickerTranscoder::Transcode(const QString & mcrFileID)
+{
+    CALL_IN(QString("mcrFileID=%1")
+        .arg(CALL_SHOW(mcrFileID)));
+
+    // We need the sticker itself
+    TelegramComms * tc = TelegramComms::Instance();
+    if (!tc -> HasFileBeenDownloaded(mcrFileID))
+    {
+        const QString reason = tr("File %1 has not been downloaded yet.")
+            .arg(mcrFileID);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return;
+    }
+
+    // Video stickers stay as they are
+    const FileRecord file = tc -> GetFileRecord(mcrFileID);
+    if (file.m_IsVideo)
+    {
+        emit FileTranscoded(mcrFileID, false);
+        CALL_OUT("");
+        return;
+    }
+
+    // Check if it's been done already (or is being done; the same file may
+    // have different file IDs)
+    const QString output_filename = GetTranscodedFilename(mcrFileID);
+    if (QFile::exists(output_filename))
+    {
+        emit FileTranscoded(mcrFileID, true);
+        CALL_OUT("");
+        return;
+    }
+    if (m_BeingTranscoded.contains(output_filename))
+    {
+        // Reported along with the conversion already under way
+        if (!m_BeingTranscoded[output_filename].contains(mcrFileID))
+        {
+            m_BeingTranscoded[output_filename] << mcrFileID;
+        }
+        CALL_OUT("");
+        return;
+    }
+    m_BeingTranscoded[output_filename] = QStringList(mcrFileID);
+
+    // Convert on the thread pool; results come back here (for all file IDs
+    // that asked for it in the meantime)
+    const QString input_filename = tc -> GetLocalFilename(mcrFileID);
+    QFutureWatcher < bool > * watcher = new QFutureWatcher < bool >(this);
+    connect (watcher, &QFutureWatcher < bool >::finished, this,
+        [this, watcher, output_filename]()
+        {
+            const QStringList file_ids =
+                m_BeingTranscoded.take(output_filename);
+            const bool success = watcher -> result();
+            watcher -> deleteLater();
+            for (const QString & file_id : file_ids)
+            {
+                emit FileTranscoded(file_id, success);
+            }
+        });
+    watcher -> setFuture(QtConcurrent::run(&m_ThreadPool,
+        &StickerTranscoder::TranscodeFile, input_filename, output_filename,
+        bool(file.m_IsAnimated)));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if a sticker has been converted
+bool StickerTranscoder::IsTranscoded(const QString & mcrFileID) const
+{
+    CALL_IN(QString("mcrFileID=%1")
+        .arg(CALL_SHOW(mcrFileID)));
+
+    const bool is_transcoded = QFile::exists(GetTranscodedFilename(mcrFileID));
+
+    CALL_OUT("");
+    return is_transcoded;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Where the converted sticker is stored
+QString StickerTranscoder::GetTranscodedFilename(const QString & mcrFileID)
+    const
+{
+    CALL_IN(QString("mcrFileID=%1")
+        .arg(CALL_SHOW(mcrFileID)));
+
+    // Lottie JSON for animated stickers, PNG otherwise
+    TelegramComms * tc = TelegramComms::Instance();
+    const FileRecord file = tc -> GetFileRecord(mcrFileID);
+    const QString extension = (file.m_IsAnimated ? "json" : "png");
+    const QString filename = TRANSCODED_FILES +
+        tc -> GetFileUniqueID(mcrFileID) + "." + extension;
+
+    CALL_OUT("");
+    return filename;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Number of conversions that haven't finished yet
+int StickerTranscoder::GetWorkListSize() const
+{
+    CALL_IN("");
+
+    const int size = m_BeingTranscoded.size();
+
+    CALL_OUT("");
+    return size;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert file (runs on the thread pool)
+bool StickerTranscoder::TranscodeFile(const QString & mcrInputFilename,
+    const QString & mcrOutputFilename, const bool mcIsAnimated)
+{
+    CALL_IN(QString("mcrInputFilename=%1, mcrOutputFilename=%2, "
+        "mcIsAnimated=%3")
+        .arg(CALL_SHOW(mcrInputFilename),
+             CALL_SHOW(mcrOutputFilename),
+             CALL_SHOW(mcIsAnimated)));
+
+    // Read sticker
+    QFile in_file(mcrInputFilename);
+    if (!in_file.open(QIODevice::ReadOnly))
+    {
+        const QString reason = tr("Could not open file \"%1\".")
+            .arg(mcrInputFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    const QByteArray data = in_file.readAll();
+    in_file.close();
+
+    // Converted file only appears once it's complete
+    QSaveFile out_file(mcrOutputFilename);
+    if (!out_file.open(QIODevice::WriteOnly))
+    {
+        const QString reason = tr("Could not open file \"%1\" for writing.")
+            .arg(mcrOutputFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    if (mcIsAnimated)
+    {
+        // .tgs is gzip compressed Lottie JSON
+        QByteArray json;
+        if (!GUnzip(data, json))
+        {
+            // Error has been reported elsewhere.
+            CALL_OUT("");
+            return false;
+        }
+        if (out_file.write(json) != json.size())
+        {
+            const QString reason = tr("Could not write file \"%1\".")
+                .arg(mcrOutputFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    } else
+    {
+        // WebP to PNG (QImage is fine outside the GUI thread)
+        const QImage image = QImage::fromData(data);
+        if (image.isNull())
+        {
+            const QString reason = tr("Could not read image \"%1\".")
+                .arg(mcrInputFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+        if (!image.save(&out_file, "PNG"))
+        {
+            const QString reason = tr("Could not write file \"%1\".")
+                .arg(mcrOutputFilename);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+
+    if (!out_file.commit())
+    {
+        const QString reason = tr("Could not save file \"%1\".")
+            .arg(mcrOutputFilename);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Decompress gzip data
+bool StickerTranscoder::GUnzip(const QByteArray & mcrData,
+    QByteArray & mrUncompressed)
+{
+    CALL_IN(QString("mcrData=%1, mrUncompressed=%2")
+        .arg(CALL_SHOW(mcrData),
+             CALL_SHOW(mrUncompressed)));
+
+    // qUncompress() only knows zlib streams, not gzip
+    z_stream stream = {};
+    // 16: gzip header
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        const QString reason = tr("Could not initialize decompression.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+    char * input = const_cast < char * >(mcrData.constData());
+    stream.next_in = reinterpret_cast < Bytef * >(input);
+    stream.avail_in = uInt(mcrData.size());
+
+    mrUncompressed.clear();
+    static const int chunk_size = 64 * 1024;
+    int result = Z_OK;
+    while (result == Z_OK)
+    {
+        const qsizetype previous_size = mrUncompressed.size();
+        mrUncompressed.resize(previous_size + chunk_size);
+        char * output = mrUncompressed.data() + previous_size;
+        stream.next_out = reinterpret_cast < Bytef * >(output);
+        stream.avail_out = chunk_size;
+        result = inflate(&stream, Z_NO_FLUSH);
+        mrUncompressed.resize(previous_size + chunk_size - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END)
+    {
+        const QString reason = tr("Data is not valid gzip data (error %1).")
+            .arg(QString::number(result));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
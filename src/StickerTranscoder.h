@@ -0,0 +1,84 @@
+// StickerTranscoder.h
+// Class definition
+
+// Converts downloaded stickers to formats that are easier to use outside
+// of Telegram: WebP stickers to PNG, animated (.tgs) stickers to the
+// Lottie JSON they contain (.tgs is gzip compressed Lottie JSON). Files
+// are converted on a thread pool of their own as they arrive, so
+// conversions run alongside downloads and ZIP files being made. Converted
+// files are kept by file unique ID.
+
+#ifndef STICKERTRANSCODER_H
+#define STICKERTRANSCODER_H
+
+// Qt includes
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+
+
+// Class definition
+class StickerTranscoder
+    : public QObject
+{
+    Q_OBJECT
+
+
+
+    // ============================================================== Lifecycle
+private:
+    // Constructor
+    StickerTranscoder();
+
+public:
+    // Destructor
+    virtual ~StickerTranscoder();
+
+    // Instanciator
+    static StickerTranscoder * Instance();
+
+private:
+    // Instance
+    static StickerTranscoder * m_Instance;
+
+
+
+    // ============================================================ Transcoding
+public:
+    // Convert a downloaded sticker (detaches; FileTranscoded() is emitted
+    // when it's done, also if the same sticker was already being converted
+    // under another file ID)
+    void Transcode(const QString & mcrFileID);
+
+    // Check if a sticker has been converted
+    bool IsTranscoded(const QString & mcrFileID) const;
+
+    // Where the converted sticker is stored
+    QString GetTranscodedFilename(const QString & mcrFileID) const;
+
+    // Number of conversions that haven't finished yet
+    int GetWorkListSize() const;
+signals:
+    void FileTranscoded(const QString & mcrFileID, const bool mcSuccess);
+
+private:
+    // Convert file (runs on the thread pool)
+    static bool TranscodeFile(const QString & mcrInputFilename,
+        const QString & mcrOutputFilename, const bool mcIsAnimated);
+
+    // Decompress gzip data
+    static bool GUnzip(const QByteArray & mcrData,
+        QByteArray & mrUncompressed);
+
+    QThreadPool m_ThreadPool;
+
+    // Conversions that haven't finished yet (output filename to the file
+    // IDs waiting for it)
+    QHash < QString, QStringList > m_BeingTranscoded;
+};
+
+#endif
@@ -25,9 +25,11 @@
 #include "DatabaseHelper.h"
 #include "MessageLogger.h"
 #include "StringHelper.h"
+#include "StringPool.h"
 #include "TelegramComms.h"
 
 // Qt includes
+#include <QByteArrayView>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
@@ -37,6 +39,7 @@
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QTimer>
+#include <QtConcurrent>
 
 #define DEBUG false
 
@@ -56,6 +59,7 @@ TelegramComms::TelegramComms()
     m_DefaultPreferences["greedy"] = "no";
     m_DefaultPreferences["provide_sticker_set"] = "always";
     m_DefaultPreferences["silent"] = "no";
+    m_DefaultPreferences["sticker_format"] = "original";
 
     // Create some directories
     QDir dir("/");
@@ -77,9 +81,11 @@ TelegramComms::TelegramComms()
     // No previous updates
     m_OffsetSet = false;
 
-    // Start with 0 with button list and button IDs
-    m_NextButtonListID = 0;
-    m_NextButtonID = 0;
+    // No sticker set info requests yet
+    m_ResultStickerSetInvalid = false;
+
+    // Keyboard IDs start with 1
+    m_NextKeyboardID = 1;
 
     // Set up network access
     m_NetworkAccessManager = new QNetworkAccessManager(this);
@@ -264,14 +270,16 @@ bool TelegramComms::CreateDatabase()
 
     // Create tables for Telegram data
     bool success =
-        CreateDatabase_Table("button_info")
-        && CreateDatabase_Table("button_list_info")
-        && CreateDatabase_Table("channel_post_info")
+        CreateDatabase_Table("channel_post_info")
         && CreateDatabase_Table("chat_info")
+        && CreateDatabase_Table("contact_sheet_info", "text")
         && CreateDatabase_Table("file_info", "text")
+        && CreateDatabase_Table_Keyboard()
         && CreateDatabase_Table("message_info")
+        && CreateDatabase_Table_MessageEdit()
         && CreateDatabase_Table("my_chat_member_info")
         && CreateDatabase_Table_StickerSet("sticker_set_info")
+        && CreateDatabase_Table("sticker_set_zip_info", "text")
         && CreateDatabase_Table("update_info")
         && CreateDatabase_Table("user_info");
 
@@ -349,6 +357,62 @@ bool TelegramComms::CreateDatabase_Table_StickerSet(
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Create keyboard table
+bool TelegramComms::CreateDatabase_Table_Keyboard()
+{
+    CALL_IN("");
+
+    // Create table
+    QSqlQuery query;
+    query.exec(QString("CREATE TABLE keyboard_info ("
+       "id bigint, "
+       "hash text, "
+       "keyboard text);"));
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error creating table \"keyboard_info\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Create message edit table (one row per changed key and version; removed
+// keys have a NULL value)
+bool TelegramComms::CreateDatabase_Table_MessageEdit()
+{
+    CALL_IN("");
+
+    // Create table
+    QSqlQuery query;
+    query.exec(QString("CREATE TABLE message_edit_info ("
+       "message_id bigint, "
+       "version int, "
+       "key text, "
+       "value text);"));
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error creating table \"message_edit_info\"");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Create table for user preferences
 bool TelegramComms::CreateDatabase_Preferences()
@@ -393,17 +457,21 @@ bool TelegramComms::ReadDatabase()
 
     // Read tables
     bool success =
-        ReadDatabase_Table("button_info", m_ButtonIDToInfo) &&
-        ReadDatabase_Table("button_list_info", m_ButtonListIDToInfo) &&
-        ReadDatabase_Table("channel_post_info",
+        ReadDatabase_Records("channel_post_info",
             m_MessageIDToChannelPostInfo) &&
-        ReadDatabase_Table("chat_info", m_ChatIDToInfo) &&
-        ReadDatabase_Table("file_info", m_FileIDToInfo) &&
-        ReadDatabase_Table("message_info", m_MessageIDToInfo) &&
-        ReadDatabase_Table("my_chat_member_info", m_MyChatMemberIDToInfo) &&
+        ReadDatabase_Records("chat_info", m_ChatIDToInfo) &&
+        ReadDatabase_Table("contact_sheet_info", m_ContactSheetKeyToInfo) &&
+        ReadDatabase_Records("file_info", m_FileIDToInfo) &&
+        ReadDatabase_Table_Keyboard() &&
+        ReadDatabase_Records("message_info", m_MessageIDToInfo) &&
+        ReadDatabase_Table_MessageEdit() &&
+        ReadDatabase_Records("my_chat_member_info",
+            m_MyChatMemberIDToInfo) &&
         ReadDatabase_Table_StickerSet("sticker_set_info") &&
-        ReadDatabase_Table("update_info", m_UpdateIDToInfo) &&
-        ReadDatabase_Table("user_info", m_UserIDToInfo);
+        ReadDatabase_Table("sticker_set_zip_info",
+            m_StickerSetNameToZIPInfo) &&
+        ReadDatabase_Records("update_info", m_UpdateIDToInfo) &&
+        ReadDatabase_Records("user_info", m_UserIDToInfo);
     success = success &&
         ReadDatabase_Table_Preferences();
     if (!success)
@@ -413,6 +481,21 @@ bool TelegramComms::ReadDatabase()
         return false;
     }
 
+    // How much memory shared strings saved us
+    StringPool::ShowStatistics();
+
+    // File IDs of the same file
+    for (auto file_iterator = m_FileIDToInfo.constBegin();
+         file_iterator != m_FileIDToInfo.constEnd();
+         file_iterator++)
+    {
+        const QString & unique_id = file_iterator.value().m_FileUniqueID;
+        if (!unique_id.isEmpty())
+        {
+            m_FileUniqueIDToFileIDs[unique_id] << file_iterator.key();
+        }
+    }
+
     // Next offset
     QList < qint64 > ids;
     ids = QList < qint64 >(m_UpdateIDToInfo.keyBegin(),
@@ -428,28 +511,16 @@ bool TelegramComms::ReadDatabase()
         m_OffsetSet = true;
     }
 
-    // Next button list ID
-    ids = QList < qint64 >(m_ButtonListIDToInfo.keyBegin(),
-        m_ButtonListIDToInfo.keyEnd());
-    if (ids.isEmpty())
-    {
-        m_NextButtonListID = 0;
-    } else
-    {
-        std::sort(ids.begin(), ids.end());
-        m_NextButtonListID = ids.last() + 1;
-    }
-
-    // Next button ID
-    ids = QList < qint64 >(m_ButtonIDToInfo.keyBegin(),
-        m_ButtonIDToInfo.keyEnd());
+    // Next keyboard ID
+    ids = QList < qint64 >(m_KeyboardIDToInfo.keyBegin(),
+        m_KeyboardIDToInfo.keyEnd());
     if (ids.isEmpty())
     {
-        m_NextButtonID = 0;
+        m_NextKeyboardID = 1;
     } else
     {
         std::sort(ids.begin(), ids.end());
-        m_NextButtonID = ids.last() + 1;
+        m_NextKeyboardID = ids.last() + 1;
     }
 
     CALL_OUT("");
@@ -496,8 +567,8 @@ bool TelegramComms::ReadDatabase_Table(const QString & mcrTableName,
     while (query.next())
     {
         const qint64 id = query.value(0).toLongLong();
-        const QString key = query.value(1).toString();
-        const QString value = query.value(2).toString();
+        const QString key = StringPool::Intern(query.value(1).toString());
+        const QString value = StringPool::Intern(query.value(2).toString());
         mrInfoData[id][key] = value;
     }
 
@@ -551,8 +622,8 @@ bool TelegramComms::ReadDatabase_Table(const QString & mcrTableName,
     while (query.next())
     {
         const QString id = query.value(0).toString();
-        const QString key = query.value(1).toString();
-        const QString value = query.value(2).toString();
+        const QString key = StringPool::Intern(query.value(1).toString());
+        const QString value = StringPool::Intern(query.value(2).toString());
         mrInfoData[id][key] = value;
     }
 
@@ -568,6 +639,42 @@ bool TelegramComms::ReadDatabase_Table(const QString & mcrTableName,
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Read any table into typed records
+template < typename Key, typename Record >
+bool TelegramComms::ReadDatabase_Records(const QString & mcrTableName,
+    QHash < Key, Record > & mrRecords)
+{
+    CALL_IN(QString("mcrTableName=%1, mrRecords=%2")
+        .arg(CALL_SHOW(mcrTableName),
+             "..."));
+
+    // Read key/value info
+    QHash < Key, QHash < QString, QString > > info_data;
+    const bool success = ReadDatabase_Table(mcrTableName, info_data);
+    if (!success)
+    {
+        // Error has been reported elsewhere.
+        CALL_OUT("");
+        return false;
+    }
+
+    // Convert to records
+    mrRecords.reserve(info_data.size());
+    for (auto info_iterator = info_data.constBegin();
+         info_iterator != info_data.constEnd();
+         info_iterator++)
+    {
+        mrRecords[info_iterator.key()] =
+            Record::FromHash(info_iterator.value());
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Read sticker_set_info table
 bool TelegramComms::ReadDatabase_Table_StickerSet(const QString & mcrTableName)
@@ -616,6 +723,116 @@ bool TelegramComms::ReadDatabase_Table_StickerSet(const QString & mcrTableName)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Read keyboard_info table
+bool TelegramComms::ReadDatabase_Table_Keyboard()
+{
+    CALL_IN("");
+
+    // Read entire table
+    QSqlQuery query;
+    query.exec(QString("SELECT id, hash, keyboard FROM keyboard_info"));
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error reading table \"keyboard_info\".");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Collect results
+    while (query.next())
+    {
+        KeyboardRecord keyboard =
+            KeyboardRecord::FromJson(query.value(2).toByteArray());
+        keyboard.m_ID = query.value(0).toLongLong();
+        keyboard.m_ContentHash = query.value(1).toString();
+        m_KeyboardIDToInfo[keyboard.m_ID] = keyboard;
+        m_KeyboardHashToID[keyboard.m_ContentHash] = keyboard.m_ID;
+    }
+
+    // Simple statistics
+    qDebug().noquote() << tr("Read table keyboard_info: %1 keyboards")
+        .arg(QString::number(m_KeyboardIDToInfo.size()));
+
+    // Done
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Read message_edit_info table and apply edits to the messages read before
+bool TelegramComms::ReadDatabase_Table_MessageEdit()
+{
+    CALL_IN("");
+
+    // Read entire table, oldest versions first
+    QSqlQuery query;
+    query.exec(QString("SELECT message_id, version, key, value "
+        "FROM message_edit_info ORDER BY message_id, version"));
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error reading table \"message_edit_info\".");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Collect changes
+    QHash < qint64, QHash < QString, QString > > info_data;
+    int number_of_changes = 0;
+    while (query.next())
+    {
+        const qint64 message_id = query.value(0).toLongLong();
+        const int version = query.value(1).toInt();
+        const QString key = StringPool::Intern(query.value(2).toString());
+        if (!info_data.contains(message_id))
+        {
+            if (!m_MessageIDToInfo.contains(message_id))
+            {
+                // Edit of a message we don't have (shouldn't happen)
+                continue;
+            }
+            info_data[message_id] = m_MessageIDToInfo[message_id].ToHash();
+        }
+        if (query.value(3).isNull())
+        {
+            info_data[message_id].remove(key);
+        } else
+        {
+            info_data[message_id][key] =
+                StringPool::Intern(query.value(3).toString());
+        }
+        m_MessageIDToVersion[message_id] = version;
+        number_of_changes++;
+    }
+
+    // Apply to messages
+    for (auto info_iterator = info_data.constBegin();
+         info_iterator != info_data.constEnd();
+         info_iterator++)
+    {
+        m_MessageIDToInfo[info_iterator.key()] =
+            MessageRecord::FromHash(info_iterator.value());
+    }
+
+    // Simple statistics
+    qDebug().noquote() << tr("Read table message_edit_info: %1 changes "
+        "in %2 messages")
+        .arg(QString::number(number_of_changes),
+             QString::number(info_data.size()));
+
+    // Done
+    CALL_OUT("");
+    return true;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Read preferences table
 bool TelegramComms::ReadDatabase_Table_Preferences()
@@ -655,7 +872,8 @@ bool TelegramComms::ReadDatabase_Table_Preferences()
 bool TelegramComms::SaveInfoData(const QString & mcrTableName,
     const QHash < QString, QString > & mcrInfoData, const QString & mcrIDType)
 {
-    CALL_IN(QString("mcrTableName=%1, mcrInfoData=%2, mcrIDType=%3")
+    CALL_IN_LAZY(
+        QString("mcrTableName=%1, mcrInfoData=%2, mcrIDType=%3")
         .arg(CALL_SHOW(mcrTableName),
              CALL_SHOW(mcrInfoData),
              CALL_SHOW(mcrIDType)));
@@ -817,98 +1035,378 @@ bool TelegramComms::SaveInfoData_StickerSet(const QString & mcrTableName,
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Update database
-void TelegramComms::UpdateDatabase()
+// Save keyboard (keyboards never change)
+bool TelegramComms::SaveKeyboard(const KeyboardRecord & mcrKeyboard)
 {
-    CALL_IN("");
+    CALL_IN(QString("mcrKeyboard=%1")
+        .arg(CALL_SHOW(mcrKeyboard.m_ID)));
 
-    // 01 May 2025
-    // CreateDatabase_Table("channel_post_info");
-
-    // 14 May 2025
-    // CreateDatabase_Preferences();
+    QSqlQuery query;
+    query.prepare("INSERT INTO keyboard_info (id, hash, keyboard) "
+        "VALUES (:id, :hash, :keyboard);");
+    query.bindValue(":id", mcrKeyboard.m_ID);
+    query.bindValue(":hash", mcrKeyboard.m_ContentHash);
+    query.bindValue(":keyboard", QString::fromUtf8(mcrKeyboard.ToJson()));
+    query.exec();
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+    {
+        const QString reason =
+            tr("SQL error saving keyboard ID %1 to table \"keyboard_info\".")
+                .arg(QString::number(mcrKeyboard.m_ID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
 
     CALL_OUT("");
+    return true;
 }
 
 
 
-// ====================================================================== Setup
+///////////////////////////////////////////////////////////////////////////////
+// Save the fields of a message that changed in an edit as a new version
+bool TelegramComms::SaveMessageEdit(const MessageRecord & mcrOldMessage,
+    const MessageRecord & mcrNewMessage)
+{
+    CALL_IN(QString("mcrOldMessage=%1, mcrNewMessage=%2")
+        .arg(CALL_SHOW(mcrOldMessage.m_ID),
+             CALL_SHOW(mcrNewMessage.m_ID)));
+
+    // Changed and new keys, then removed ones (NULL value)
+    const QHash < QString, QString > old_info = mcrOldMessage.ToHash();
+    const QHash < QString, QString > new_info = mcrNewMessage.ToHash();
+    QList < QPair < QString, QVariant > > changes;
+    for (auto info_iterator = new_info.constBegin();
+         info_iterator != new_info.constEnd();
+         info_iterator++)
+    {
+        const auto old_iterator = old_info.constFind(info_iterator.key());
+        if (old_iterator == old_info.constEnd() ||
+            old_iterator.value() != info_iterator.value())
+        {
+            changes << qMakePair(info_iterator.key(),
+                QVariant(info_iterator.value()));
+        }
+    }
+    for (auto key_iterator = old_info.keyBegin();
+         key_iterator != old_info.keyEnd();
+         key_iterator++)
+    {
+        if (!new_info.contains(*key_iterator))
+        {
+            changes << qMakePair(*key_iterator, QVariant());
+        }
+    }
+    if (changes.isEmpty())
+    {
+        // Nothing to do here.
+        CALL_OUT("");
+        return true;
+    }
+
+    // Save new version
+    const qint64 message_id = mcrNewMessage.m_ID;
+    const int version = m_MessageIDToVersion.value(message_id, 0) + 1;
+    QSqlQuery query;
+    query.prepare("INSERT INTO message_edit_info "
+        "(message_id, version, key, value) "
+        "VALUES (:message_id, :version, :key, :value);");
+    query.bindValue(":message_id", message_id);
+    query.bindValue(":version", version);
+    for (const QPair < QString, QVariant > & change : changes)
+    {
+        query.bindValue(":key", change.first);
+        query.bindValue(":value", change.second);
+        query.exec();
+        if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+        {
+            const QString reason =
+                tr("SQL error saving version %1 of message ID %2 (key: %3) "
+                "to table \"message_edit_info\".")
+                    .arg(QString::number(version),
+                         QString::number(message_id),
+                         change.first);
+            MessageLogger::Error(CALL_METHOD, reason);
+            CALL_OUT(reason);
+            return false;
+        }
+    }
+    m_MessageIDToVersion[message_id] = version;
+
+    CALL_OUT("");
+    return true;
+}
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Bot name
-bool TelegramComms::SetBotName(const QString & mcrBotName)
+// Update database
+void TelegramComms::UpdateDatabase()
 {
-    CALL_IN(QString("mcrBotName=%1")
-        .arg(CALL_SHOW(mcrBotName)));
+    CALL_IN("");
 
-    // Can't be empty
-    if (mcrBotName.isEmpty())
+    // 01 May 2025
+    // CreateDatabase_Table("channel_post_info");
+
+    // 14 May 2025
+    // CreateDatabase_Preferences();
+
+    // 17 Oct 2026: keyboards replace button_list_info and button_info
+    // (the old tables are not read anymore, but messages still pointing
+    // to them get their keyboards moved)
+    if (!QSqlDatabase::database().tables().contains("keyboard_info"))
     {
-        const QString reason = tr("Telegram bot name cannot be empty.");
-        MessageLogger::Error(CALL_METHOD, reason);
-        CALL_OUT(reason);
-        return false;
+        CreateDatabase_Table_Keyboard();
+    }
+    if (QSqlDatabase::database().tables().contains("button_list_info"))
+    {
+        UpdateDatabase_Keyboards();
     }
 
-    // Can't be set already
-    if (!m_BotName.isEmpty())
+    // 17 Oct 2026: edited messages are saved as versions
+    if (!QSqlDatabase::database().tables().contains("message_edit_info"))
     {
-        const QString reason = tr("Telegram bot has already been set.");
-        MessageLogger::Error(CALL_METHOD, reason);
-        CALL_OUT(reason);
-        return false;
+        CreateDatabase_Table_MessageEdit();
     }
 
-    m_BotName = mcrBotName;
+    // 17 Oct 2026: sticker set ZIP files are versioned
+    if (!QSqlDatabase::database().tables().contains("sticker_set_zip_info"))
+    {
+        CreateDatabase_Table("sticker_set_zip_info", "text");
+    }
+
+    // 17 Oct 2026: rendered contact sheets are kept
+    if (!QSqlDatabase::database().tables().contains("contact_sheet_info"))
+    {
+        CreateDatabase_Table("contact_sheet_info", "text");
+    }
 
     CALL_OUT("");
-    return true;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Set bot token
-bool TelegramComms::SetToken(const QString & mcrToken)
+// Move keyboards from button_list_info and button_info to keyboard_info
+bool TelegramComms::UpdateDatabase_Keyboards()
 {
-    CALL_IN(QString("mcrToken=%1")
-        .arg(CALL_SHOW(mcrToken)));
+    CALL_IN("");
 
-    // Catch empty token
-    if (mcrToken.isEmpty())
+    // Anything left to do?
+    QSqlQuery query;
+    query.exec("SELECT id FROM message_info "
+        "WHERE key='button_list_id' LIMIT 1;");
+    if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
     {
-        const QString reason = tr("Empty token provided.");
+        const QString reason =
+            tr("SQL error reading table \"message_info\".");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
         return false;
     }
+    if (!query.next())
+    {
+        // Nothing to do here.
+        CALL_OUT("");
+        return true;
+    }
 
-    // Can't be set already
-    if (!m_Token.isEmpty())
+    // Old button lists and buttons
+    // (button list: num_rows, row_<n>_num_cols, row_<n>_col_<m>_button_id;
+    // button: text, callback_data)
+    QHash < qint64, QHash < QString, QString > > button_list_id_to_info;
+    QHash < qint64, QHash < QString, QString > > button_id_to_info;
+    if (!ReadDatabase_Table("button_list_info", button_list_id_to_info) ||
+        !ReadDatabase_Table("button_info", button_id_to_info))
     {
-        const QString reason = tr("Telegram bot has already been set.");
+        const QString reason = tr("Could not read old keyboards.");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
         return false;
     }
 
-    // Check if token is valid
-    static const QRegularExpression format_token(
-        "^[0-9]+:[A-Za-z0-9\\-_]+$");
-    QRegularExpressionMatch match_token = format_token.match(mcrToken);
-    if (!match_token.hasMatch())
+    // Keyboards we have already (identical keyboards are only stored once)
+    if (!ReadDatabase_Table_Keyboard())
     {
-        const QString reason = tr("Token does not have a valid format: \"%1\"")
-            .arg(mcrToken);
+        const QString reason = tr("Could not read keyboards.");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
         return false;
     }
-
-    // Set new token
+    QList < qint64 > ids = m_KeyboardIDToInfo.keys();
+    std::sort(ids.begin(), ids.end());
+    qint64 next_keyboard_id = (ids.isEmpty() ? 1 : ids.last() + 1);
+
+    QSqlDatabase::database().transaction();
+    query.prepare("UPDATE message_info "
+        "SET key='keyboard_id', value=:keyboard_id "
+        "WHERE key='button_list_id' AND value=:button_list_id;");
+    int num_migrated = 0;
+    for (auto list_iterator = button_list_id_to_info.constBegin();
+         list_iterator != button_list_id_to_info.constEnd();
+         list_iterator++)
+    {
+        // Put keyboard together
+        const QHash < QString, QString > & button_list =
+            list_iterator.value();
+        KeyboardRecord keyboard;
+        const int num_rows = button_list.value("num_rows").toInt();
+        for (int row = 0; row < num_rows; row++)
+        {
+            const QString row_name = QString("row_%1")
+                .arg(QString::number(row));
+            const int num_cols =
+                button_list.value(row_name + "_num_cols").toInt();
+            QList < KeyboardRecord::Button > buttons;
+            for (int column = 0; column < num_cols; column++)
+            {
+                const qint64 button_id = button_list.value(
+                    QString("%1_col_%2_button_id")
+                        .arg(row_name,
+                             QString::number(column))).toLongLong();
+                const QHash < QString, QString > button_info =
+                    button_id_to_info.value(button_id);
+                KeyboardRecord::Button button;
+                button.m_Text = button_info.value("text");
+                button.m_CallbackData = button_info.value("callback_data");
+                buttons << button;
+            }
+            keyboard.m_Rows << buttons;
+        }
+        if (keyboard.IsEmpty())
+        {
+            const QString reason = tr("Button list ID %1 is empty; messages "
+                "using it keep their button_list_id.")
+                .arg(QString::number(list_iterator.key()));
+            MessageLogger::Error(CALL_METHOD, reason);
+            continue;
+        }
+        keyboard.m_ContentHash = keyboard.ComputeContentHash();
+
+        // Save it (unless we have it already)
+        qint64 keyboard_id =
+            m_KeyboardHashToID.value(keyboard.m_ContentHash, 0);
+        if (keyboard_id == 0)
+        {
+            keyboard_id = next_keyboard_id++;
+            keyboard.m_ID = keyboard_id;
+            m_KeyboardIDToInfo[keyboard_id] = keyboard;
+            m_KeyboardHashToID[keyboard.m_ContentHash] = keyboard_id;
+            SaveKeyboard(keyboard);
+        }
+
+        // Messages using it
+        query.bindValue(":keyboard_id", QString::number(keyboard_id));
+        query.bindValue(":button_list_id",
+            QString::number(list_iterator.key()));
+        query.exec();
+        if (DatabaseHelper::HasSQLError(query, __FILE__, __LINE__))
+        {
+            QSqlDatabase::database().rollback();
+            const QString reason = tr("SQL error moving messages from "
+                "button list ID %1 to keyboard ID %2.")
+                .arg(QString::number(list_iterator.key()),
+                     QString::number(keyboard_id));
+            MessageLogger::Error(CALL_METHOD, reason);
+            m_KeyboardIDToInfo.clear();
+            m_KeyboardHashToID.clear();
+            CALL_OUT(reason);
+            return false;
+        }
+        num_migrated++;
+    }
+    QSqlDatabase::database().commit();
+
+    // ReadDatabase() reads them again
+    m_KeyboardIDToInfo.clear();
+    m_KeyboardHashToID.clear();
+
+    qDebug().noquote() << tr("Moved %1 button lists to keyboard_info")
+        .arg(QString::number(num_migrated));
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+// ====================================================================== Setup
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Bot name
+bool TelegramComms::SetBotName(const QString & mcrBotName)
+{
+    CALL_IN(QString("mcrBotName=%1")
+        .arg(CALL_SHOW(mcrBotName)));
+
+    // Can't be empty
+    if (mcrBotName.isEmpty())
+    {
+        const QString reason = tr("Telegram bot name cannot be empty.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Can't be set already
+    if (!m_BotName.isEmpty())
+    {
+        const QString reason = tr("Telegram bot has already been set.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    m_BotName = mcrBotName;
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Set bot token
+bool TelegramComms::SetToken(const QString & mcrToken)
+{
+    CALL_IN(QString("mcrToken=%1")
+        .arg(CALL_SHOW(mcrToken)));
+
+    // Catch empty token
+    if (mcrToken.isEmpty())
+    {
+        const QString reason = tr("Empty token provided.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Can't be set already
+    if (!m_Token.isEmpty())
+    {
+        const QString reason = tr("Telegram bot has already been set.");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Check if token is valid
+    static const QRegularExpression format_token(
+        "^[0-9]+:[A-Za-z0-9\\-_]+$");
+    QRegularExpressionMatch match_token = format_token.match(mcrToken);
+    if (!match_token.hasMatch())
+    {
+        const QString reason = tr("Token does not have a valid format: \"%1\"")
+            .arg(mcrToken);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return false;
+    }
+
+    // Set new token
     m_Token = mcrToken;
 
     CALL_OUT("");
@@ -1222,6 +1720,54 @@ bool TelegramComms::HandleResponse(QNetworkReply * mpResponse)
     CALL_IN(QString("mpResponse=%1")
         .arg(CALL_SHOW(mpResponse)));
 
+    // Sticker set info requests know which sticker set they were for
+    const QString sticker_set_name =
+        mpResponse -> property("sticker_set_name").toString();
+    m_ResultMessage = MessageRecord();
+    m_ResultStickerSetInvalid = false;
+    const bool success = ProcessResponse(mpResponse, sticker_set_name);
+
+    // Tagged messages are reported once we know their message ID
+    const QString message_tag =
+        mpResponse -> property("message_tag").toString();
+    if (success &&
+        !message_tag.isEmpty() &&
+        !m_ResultMessage.IsEmpty())
+    {
+        emit MessageSent(message_tag, m_ResultMessage.m_ChatID,
+            m_ResultMessage.m_ID);
+    }
+    if (!sticker_set_name.isEmpty())
+    {
+        // Done with this one (whatever happened); next one, please.
+        m_StickerSetInfoBeingDownloaded -= sticker_set_name;
+        if (!success)
+        {
+            // Let the world know
+            emit StickerSetInfoFailed(sticker_set_name,
+                m_ResultStickerSetInvalid);
+        }
+        StartStickerSetInfoDownloads();
+    }
+
+    // We're done with the reply
+    mpResponse -> deleteLater();
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Process response
+bool TelegramComms::ProcessResponse(QNetworkReply * mpResponse,
+    const QString & mcrStickerSetName)
+{
+    CALL_IN(QString("mpResponse=%1, mcrStickerSetName=%2")
+        .arg(CALL_SHOW(mpResponse),
+             CALL_SHOW(mcrStickerSetName)));
+
 
     // Keep error
     const int nework_error = mpResponse -> error();
@@ -1266,8 +1812,15 @@ bool TelegramComms::HandleResponse(QNetworkReply * mpResponse)
 
     // == Otherwise, result will be in JSON
 
+    // Don't build JSON objects for updates we have already seen
+    QByteArray json_content = content;
+    if (url.contains("/getUpdates"))
+    {
+        json_content = SkipKnownUpdates(content);
+    }
+
     // Parse JSON
-    QJsonDocument doc_response = QJsonDocument::fromJson(content);
+    QJsonDocument doc_response = QJsonDocument::fromJson(json_content);
     if (doc_response.isNull())
     {
         // Not JSON format
@@ -1283,7 +1836,7 @@ bool TelegramComms::HandleResponse(QNetworkReply * mpResponse)
 
     // Parse response
     QJsonObject response = doc_response.object();
-    bool success = Parse_Response(response);
+    bool success = Parse_Response(response, mcrStickerSetName);
 
     CALL_OUT("");
     return success;
@@ -1291,12 +1844,232 @@ bool TelegramComms::HandleResponse(QNetworkReply * mpResponse)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Remove updates we have already seen from a getUpdates response
+QByteArray TelegramComms::SkipKnownUpdates(const QByteArray & mcrContent)
+{
+    CALL_IN(QString("mcrContent=%1")
+        .arg(CALL_SHOW(mcrContent)));
+
+    // This is a quick byte level scan of the raw response; no JSON objects
+    // are built. We're looking for the elements of the result array and the
+    // update_id on the top level of each element:
+    // {"ok":true,"result":[{"update_id":494953278,...},{...}]}
+
+    const char * data = mcrContent.constData();
+    const int size = mcrContent.size();
+
+    // Depth 1: response, 2: result array, 3: single update
+    int depth = 0;
+    QByteArrayView last_string;
+    int array_start = -1;
+    int array_end = -1;
+    int element_start = -1;
+    qint64 element_update_id = 0;
+    QList < QPair < int, int > > element_ranges;
+    QList < qint64 > element_update_ids;
+    for (int position = 0; position < size; position++)
+    {
+        const char current = data[position];
+        switch (current)
+        {
+        case '"':
+        {
+            // Skip string (escaped characters included)
+            int end = position + 1;
+            while (end < size &&
+                data[end] != '"')
+            {
+                if (data[end] == '\\' &&
+                    end + 1 < size)
+                {
+                    end++;
+                }
+                end++;
+            }
+
+            // Response ends in the middle of a string; don't skip anything
+            // and leave it to the JSON parser
+            if (end >= size)
+            {
+                CALL_OUT("");
+                return mcrContent;
+            }
+            last_string = QByteArrayView(data + position + 1,
+                end - position - 1);
+            position = end;
+            break;
+        }
+
+        case ':':
+        {
+            // Value of update_id
+            if (depth == 3 &&
+                element_start != -1 &&
+                last_string == "update_id")
+            {
+                int number_start = position + 1;
+                while (number_start < size &&
+                    (data[number_start] == ' ' ||
+                     data[number_start] == '\t' ||
+                     data[number_start] == '\r' ||
+                     data[number_start] == '\n'))
+                {
+                    number_start++;
+                }
+                int number_end = number_start;
+                while (number_end < size &&
+                    data[number_end] >= '0' &&
+                    data[number_end] <= '9')
+                {
+                    number_end++;
+                }
+                element_update_id = QByteArrayView(data + number_start,
+                    number_end - number_start).toLongLong();
+                position = number_end - 1;
+            }
+            break;
+        }
+
+        case '{':
+        case '[':
+            if (current == '[' &&
+                depth == 1 &&
+                array_start == -1 &&
+                last_string == "result")
+            {
+                array_start = position;
+            }
+            if (current == '{' &&
+                depth == 2 &&
+                array_start != -1 &&
+                array_end == -1)
+            {
+                element_start = position;
+                element_update_id = 0;
+            }
+            depth++;
+            break;
+
+        case '}':
+        case ']':
+            depth--;
+            if (current == '}' &&
+                depth == 2 &&
+                element_start != -1)
+            {
+                element_ranges << QPair < int, int >(element_start,
+                    position + 1);
+                element_update_ids << element_update_id;
+                element_start = -1;
+            }
+            if (current == ']' &&
+                depth == 1 &&
+                array_start != -1 &&
+                array_end == -1)
+            {
+                array_end = position;
+            }
+            break;
+
+        default:
+            // Nothing to do.
+            break;
+        }
+    }
+
+    // Anything unexpected is left to the JSON parser
+    if (array_start == -1 ||
+        array_end == -1)
+    {
+        CALL_OUT("");
+        return mcrContent;
+    }
+
+    // Keep updates we don't know yet
+    QList < QByteArrayView > new_elements;
+    QList < qint64 > known_update_ids;
+    qint64 first_new_update_id = -1;
+    bool all_new_have_ids = true;
+    for (int index = 0; index < element_ranges.size(); index++)
+    {
+        const qint64 update_id = element_update_ids[index];
+        if (update_id != 0 &&
+            m_UpdateIDToInfo.contains(update_id))
+        {
+            known_update_ids << update_id;
+            continue;
+        }
+        if (update_id == 0)
+        {
+            all_new_have_ids = false;
+        } else if (first_new_update_id == -1 ||
+            update_id < first_new_update_id)
+        {
+            first_new_update_id = update_id;
+        }
+        const QPair < int, int > & range = element_ranges[index];
+        new_elements << QByteArrayView(data + range.first,
+            range.second - range.first);
+    }
+    if (known_update_ids.isEmpty())
+    {
+        // Nothing to skip
+        CALL_OUT("");
+        return mcrContent;
+    }
+
+    // Skipped updates won't go through Parse_UpdateArray(), so they need to
+    // be acknowledged here - but only those before the first update that
+    // is left. If that one fails to parse, it has to come again; known
+    // updates after it are simply skipped again next time.
+    qint64 last_skipped_update_id = -1;
+    if (all_new_have_ids)
+    {
+        for (const qint64 update_id : known_update_ids)
+        {
+            if (first_new_update_id == -1 ||
+                update_id < first_new_update_id)
+            {
+                last_skipped_update_id =
+                    qMax(last_skipped_update_id, update_id);
+            }
+        }
+    }
+    if (last_skipped_update_id != -1 &&
+        (!m_OffsetSet ||
+         m_Offset <= last_skipped_update_id))
+    {
+        m_Offset = last_skipped_update_id + 1;
+        m_OffsetSet = true;
+    }
+
+    // Put response back together
+    QByteArray filtered_content = mcrContent.left(array_start + 1);
+    for (int index = 0; index < new_elements.size(); index++)
+    {
+        if (index > 0)
+        {
+            filtered_content += ',';
+        }
+        filtered_content.append(new_elements[index]);
+    }
+    filtered_content += mcrContent.mid(array_end);
+
+    CALL_OUT("");
+    return filtered_content;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Original server response
-bool TelegramComms::Parse_Response(const QJsonObject & mcrResponse)
+bool TelegramComms::Parse_Response(const QJsonObject & mcrResponse,
+    const QString & mcrStickerSetName)
 {
-    CALL_IN(QString("mcrResponse=%1")
-        .arg(CALL_SHOW(mcrResponse)));
+    CALL_IN_LAZY(QString("mcrResponse=%1, mcrStickerSetName=%2")
+        .arg(CALL_SHOW(mcrResponse),
+             CALL_SHOW(mcrStickerSetName)));
 
     // {
     //   "ok":true,
@@ -1362,7 +2135,7 @@ bool TelegramComms::Parse_Response(const QJsonObject & mcrResponse)
             description == "Bad Request: STICKERSET_INVALID")
         {
             // Unknown sticker set
-            Error_StickerSetInvalid();
+            Error_StickerSetInvalid(mcrStickerSetName);
         } else
         {
             // Unhandled problem
@@ -1407,9 +2180,11 @@ bool TelegramComms::Parse_Response(const QJsonObject & mcrResponse)
         result_obj.contains("from") &&
         result_obj.contains("message_id"))
     {
-        const QHash < QString, QString > message_info =
-            Parse_Message(result_obj);
-        const bool success = !message_info.isEmpty();
+        ParsedEntities parsed;
+        const MessageRecord message = Parse_Message(result_obj, parsed);
+        CommitParsedEntities(parsed);
+        m_ResultMessage = message;
+        const bool success = !message.IsEmpty();
         CALL_OUT("");
         return success;
     }
@@ -1419,17 +2194,21 @@ bool TelegramComms::Parse_Response(const QJsonObject & mcrResponse)
         result_obj.contains("file_unique_id") &&
         result_obj.contains("file_size"))
     {
-        QHash < QString, QString > file_info = Parse_File(result_obj);
+        ParsedEntities parsed;
+        const FileRecord file = Parse_File(result_obj, parsed);
+        CommitParsedEntities(parsed);
         bool success = true;
 
         // Download file if we have one
-        if (file_info.contains("file_path"))
+        if (file.m_Extras.contains("file_path"))
         {
-            const QString id = file_info["id"];
-            const QString file_path = file_info["file_path"];
-            success = Download_FilePath(id, file_path);
-            file_info.remove("file_path");
-            SaveInfoData("file_info", file_info, "text");
+            const QString file_path = file.m_Extras["file_path"];
+            success = Download_FilePath(file.m_ID, file_path);
+
+            // Path is only valid for a while; don't keep it
+            FileRecord & stored_file = m_FileIDToInfo[file.m_ID];
+            stored_file.m_Extras.remove("file_path");
+            SaveInfoData("file_info", stored_file.ToHash(), "text");
         }
         CALL_OUT("");
         return success;
@@ -1472,32 +2251,75 @@ bool TelegramComms::Parse_Response(const QJsonObject & mcrResponse)
 // Parse an array of updates
 bool TelegramComms::Parse_UpdateArray(const QJsonArray & mcrUpdates)
 {
-    CALL_IN(QString("mcrUpdates=%1")
+    CALL_IN_LAZY(QString("mcrUpdates=%1")
         .arg(CALL_SHOW(mcrUpdates)));
 
-    // Loop elements of the array
+    // Result of parsing a single update
+    struct ParsedUpdate
+    {
+        // From the JSON (also set if the update could not be parsed)
+        qint64 m_UpdateID = 0;
+        UpdateRecord m_Update;
+        ParsedEntities m_Entities;
+    };
+
+    // Parsing doesn't change anything, so updates can be parsed in
+    // parallel. Everything is committed afterwards, in order.
+    QList < QJsonObject > all_updates;
+    all_updates.reserve(mcrUpdates.size());
     for (auto update_iterator = mcrUpdates.begin();
          update_iterator != mcrUpdates.end();
          update_iterator++)
     {
-        const QJsonObject & update = update_iterator -> toObject();
-        const QHash < QString, QString > update_info = Parse_Update(update);
-        if (update_info.isEmpty())
+        all_updates << update_iterator -> toObject();
+    }
+    auto parse_update = [this](const QJsonObject & mcrUpdate)
+    {
+        ParsedUpdate parsed_update;
+        parsed_update.m_UpdateID = mcrUpdate["update_id"].toInteger();
+        parsed_update.m_Update =
+            Parse_Update(mcrUpdate, parsed_update.m_Entities);
+        return parsed_update;
+    };
+    QList < ParsedUpdate > parsed_updates;
+    if (all_updates.size() > 1)
+    {
+        parsed_updates = QtConcurrent::blockingMapped <
+            QList < ParsedUpdate > >(all_updates, parse_update);
+    } else
+    {
+        for (const QJsonObject & update : all_updates)
+        {
+            parsed_updates << parse_update(update);
+        }
+    }
+
+    // Telegram sends updates in order, but let's make sure
+    std::stable_sort(parsed_updates.begin(), parsed_updates.end(),
+        [](const ParsedUpdate & mcrFirst, const ParsedUpdate & mcrSecond)
+        {
+            return mcrFirst.m_UpdateID < mcrSecond.m_UpdateID;
+        });
+
+    // Commit
+    for (const ParsedUpdate & parsed_update : parsed_updates)
+    {
+        const UpdateRecord & update_record = parsed_update.m_Update;
+        if (update_record.IsEmpty())
         {
             const QString reason = tr("Update could not be parsed.");
             MessageLogger::Error(CALL_METHOD, reason);
             CALL_OUT(reason);
             return false;
         }
+        CommitParsedEntities(parsed_update.m_Entities);
 
         // Update last update ID
-        const qint64 update_id = update_info["id"].toLongLong();
-        m_Offset = update_id + 1;
+        m_Offset = update_record.m_ID + 1;
         m_OffsetSet = true;
 
         // Send signal for update
-        const qint64 chat_id = update_info["chat_id"].toLongLong();
-        emit UpdateReceived(chat_id, update_id);
+        emit UpdateReceived(update_record.m_ChatID, update_record.m_ID);
     }
 
     CALL_OUT("");
@@ -1506,12 +2328,173 @@ bool TelegramComms::Parse_UpdateArray(const QJsonArray & mcrUpdates)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Save everything that has been parsed, and let everybody know
+void TelegramComms::CommitParsedEntities(const ParsedEntities & mcrParsed)
+{
+    CALL_IN(QString("mcrParsed=%1")
+        .arg(CALL_SHOW(&mcrParsed)));
+
+    // The same entity may have been parsed more than once (e.g. the sender
+    // of several messages); first one wins, like it would have when parsing
+    // one after the other.
+
+    // Users
+    for (const UserRecord & user : mcrParsed.m_Users)
+    {
+        if (!m_UserIDToInfo.contains(user.m_ID))
+        {
+            m_UserIDToInfo[user.m_ID] = user;
+            SaveInfoData("user_info", user.ToHash());
+        }
+    }
+
+    // Chats
+    for (const ChatRecord & chat : mcrParsed.m_Chats)
+    {
+        if (!m_ChatIDToInfo.contains(chat.m_ID))
+        {
+            m_ChatIDToInfo[chat.m_ID] = chat;
+            SaveInfoData("chat_info", chat.ToHash());
+        }
+    }
+
+    // Files
+    for (const FileRecord & file : mcrParsed.m_Files)
+    {
+        // If there was a previous file info, existing information takes
+        // precedence; we only fill in what we didn't know yet
+        FileRecord & stored_file = m_FileIDToInfo[file.m_ID];
+        stored_file.Merge(file);
+        SaveInfoData("file_info", stored_file.ToHash(), "text");
+
+        // File IDs of the same file
+        if (!stored_file.m_FileUniqueID.isEmpty())
+        {
+            QStringList & file_ids =
+                m_FileUniqueIDToFileIDs[stored_file.m_FileUniqueID];
+            if (!file_ids.contains(file.m_ID))
+            {
+                file_ids << file.m_ID;
+            }
+        }
+    }
+
+    // MyChatMember
+    for (const MyChatMemberRecord & my_chat_member :
+        mcrParsed.m_MyChatMembers)
+    {
+        if (!m_MyChatMemberIDToInfo.contains(my_chat_member.m_ID))
+        {
+            m_MyChatMemberIDToInfo[my_chat_member.m_ID] = my_chat_member;
+            SaveInfoData("my_chat_member_info", my_chat_member.ToHash());
+        }
+    }
+
+    // Keyboards (message ID, keyboard); identical keyboards are only
+    // stored once
+    QHash < qint64, qint64 > message_id_to_keyboard_id;
+    for (const QPair < qint64, KeyboardRecord > & message_keyboard :
+        mcrParsed.m_Keyboards)
+    {
+        const KeyboardRecord & keyboard = message_keyboard.second;
+        qint64 keyboard_id =
+            m_KeyboardHashToID.value(keyboard.m_ContentHash, 0);
+        if (keyboard_id == 0)
+        {
+            keyboard_id = m_NextKeyboardID++;
+            KeyboardRecord & stored_keyboard =
+                m_KeyboardIDToInfo[keyboard_id];
+            stored_keyboard = keyboard;
+            stored_keyboard.m_ID = keyboard_id;
+            m_KeyboardHashToID[keyboard.m_ContentHash] = keyboard_id;
+            SaveKeyboard(stored_keyboard);
+        }
+        message_id_to_keyboard_id[message_keyboard.first] = keyboard_id;
+    }
+
+    // Messages
+    for (const MessageRecord & parsed_message : mcrParsed.m_Messages)
+    {
+        if (m_MessageIDToInfo.contains(parsed_message.m_ID))
+        {
+            continue;
+        }
+        MessageRecord message = parsed_message;
+        if (message_id_to_keyboard_id.contains(message.m_ID))
+        {
+            message.m_Extras["keyboard_id"] =
+                QString::number(message_id_to_keyboard_id[message.m_ID]);
+        }
+        m_MessageIDToInfo[message.m_ID] = message;
+        SaveInfoData("message_info", message.ToHash());
+
+        // Add chat to active ones
+        m_ActiveChats += message.m_ChatID;
+
+        // Let everybody know
+        emit MessageReceived(message.m_ChatID, message.m_ID);
+    }
+
+    // Edited messages; only the changes are saved
+    for (const MessageRecord & parsed_message : mcrParsed.m_EditedMessages)
+    {
+        MessageRecord message = parsed_message;
+        if (message_id_to_keyboard_id.contains(message.m_ID))
+        {
+            message.m_Extras["keyboard_id"] =
+                QString::number(message_id_to_keyboard_id[message.m_ID]);
+        }
+        if (!m_MessageIDToInfo.contains(message.m_ID))
+        {
+            // We never saw the original message; this is as good as a new
+            // one (commands may come in this way)
+            m_MessageIDToInfo[message.m_ID] = message;
+            SaveInfoData("message_info", message.ToHash());
+            m_ActiveChats += message.m_ChatID;
+            emit MessageReceived(message.m_ChatID, message.m_ID);
+            continue;
+        }
+        MessageRecord & stored_message = m_MessageIDToInfo[message.m_ID];
+        SaveMessageEdit(stored_message, message);
+        stored_message = message;
+    }
+
+    // Channel posts
+    for (const ChannelPostRecord & channel_post : mcrParsed.m_ChannelPosts)
+    {
+        if (m_MessageIDToChannelPostInfo.contains(channel_post.m_ID))
+        {
+            continue;
+        }
+        m_MessageIDToChannelPostInfo[channel_post.m_ID] = channel_post;
+        SaveInfoData("channel_post_info", channel_post.ToHash());
+
+        // Let everybody know
+        emit ChannelPostReceived(channel_post.m_ChatID, channel_post.m_ID);
+    }
+
+    // Updates
+    for (const UpdateRecord & update : mcrParsed.m_Updates)
+    {
+        if (!m_UpdateIDToInfo.contains(update.m_ID))
+        {
+            m_UpdateIDToInfo[update.m_ID] = update;
+            SaveInfoData("update_info", update.ToHash());
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Parse update
-QHash < QString, QString > TelegramComms::Parse_Update(
-    const QJsonObject & mcrUpdate)
+UpdateRecord TelegramComms::Parse_Update(const QJsonObject & mcrUpdate,
+    ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrUpdate=%1")
+    CALL_IN_LAZY(QString("mcrUpdate=%1")
         .arg(CALL_SHOW_FULL(mcrUpdate)));
 
     // {
@@ -1538,128 +2521,138 @@ QHash < QString, QString > TelegramComms::Parse_Update(
         return m_UpdateIDToInfo[update_id];
     }
 
-    // Parse the new update
-    QHash < QString, QString > update_info;
+    // Known keys
+    enum Key
+    {
+        Key_ChannelPost,
+        Key_EditedChannelPost,
+        Key_EditedMessage,
+        Key_Message,
+        Key_MyChatMember,
+        Key_UpdateId
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "channel_post", Key_ChannelPost },
+        { "edited_channel_post", Key_EditedChannelPost },
+        { "edited_message", Key_EditedMessage },
+        { "message", Key_Message },
+        { "my_chat_member", Key_MyChatMember },
+        { "update_id", Key_UpdateId }
+    };
 
-    const QStringList all_keys = mcrUpdate.keys();
-    for (const QString & key : all_keys)
+    // Parse the new update
+    UpdateRecord update;
+    for (auto key_iterator = mcrUpdate.constBegin();
+         key_iterator != mcrUpdate.constEnd();
+         key_iterator++)
     {
-        if (key == "channel_post")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
         {
-            const QHash < QString, QString > channel_post_info =
-                Parse_ChannelPost(mcrUpdate[key].toObject());
-            if (channel_post_info.isEmpty())
-            {
-                const QString reason =
-                    tr("Error parsing update (channel post)");
-                MessageLogger::Error(CALL_METHOD, reason);
-                CALL_OUT(reason);
-                return QHash < QString, QString >();
-            }
-            update_info["type"] = "channel post";
-            update_info["message_id"] = channel_post_info["id"];
-            update_info["chat_id"] = channel_post_info["chat_id"];
-            continue;
-        }
-
-        if (key == "edited_channel_post")
+        case Key_ChannelPost:
+        case Key_EditedChannelPost:
         {
-            const QHash < QString, QString > channel_post_info =
-                Parse_ChannelPost(mcrUpdate[key].toObject());
-            if (channel_post_info.isEmpty())
+            const ChannelPostRecord channel_post =
+                Parse_ChannelPost(value.toObject(), mrParsed);
+            if (channel_post.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing update (channel post)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return UpdateRecord();
             }
-            update_info["type"] = "channel post";
-            update_info["message_id"] = channel_post_info["id"];
-            update_info["chat_id"] = channel_post_info["chat_id"];
+            update.m_Type = StringPool::Intern("channel post");
+            update.m_MessageID = channel_post.m_ID;
+            update.m_ChatID = channel_post.m_ChatID;
             continue;
         }
 
-        if (key == "edited_message")
+        case Key_EditedMessage:
         {
-            const QHash < QString, QString > message_info =
-                Parse_Message(mcrUpdate[key].toObject());
-            if (message_info.isEmpty())
+            const MessageRecord message =
+                Parse_Message(value.toObject(), mrParsed, true);
+            if (message.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing update (edited message)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return UpdateRecord();
             }
-            update_info["type"] = "message";
-            update_info["message_id"] = message_info["id"];
-            update_info["chat_id"] = message_info["chat_id"];
+            update.m_Type = StringPool::Intern("message");
+            update.m_MessageID = message.m_ID;
+            update.m_ChatID = message.m_ChatID;
             continue;
         }
 
-        if (key == "message")
+        case Key_Message:
         {
-            const QHash < QString, QString > message_info =
-                Parse_Message(mcrUpdate[key].toObject());
-            if (message_info.isEmpty())
+            const MessageRecord message =
+                Parse_Message(value.toObject(), mrParsed);
+            if (message.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing update (message)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return UpdateRecord();
             }
-            update_info["type"] = "message";
-            update_info["message_id"] = message_info["id"];
-            update_info["chat_id"] = message_info["chat_id"];
+            update.m_Type = StringPool::Intern("message");
+            update.m_MessageID = message.m_ID;
+            update.m_ChatID = message.m_ChatID;
             continue;
         }
 
-        if (key == "my_chat_member")
+        case Key_MyChatMember:
         {
-            const QHash < QString, QString > mychatmember_info =
-                Parse_MyChatMember(mcrUpdate[key].toObject());
-            if (mychatmember_info.isEmpty())
+            const MyChatMemberRecord my_chat_member =
+                Parse_MyChatMember(value.toObject(), mrParsed);
+            if (my_chat_member.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing update (my_chat_member)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return UpdateRecord();
             }
-            update_info["type"] = "my_chat_member";
-            update_info["my_chat_member_id"] = mychatmember_info["id"];
-            update_info["chat_id"] = mychatmember_info["chat_id"];
+            update.m_Type = StringPool::Intern("my_chat_member");
+            update.m_MyChatMemberID = my_chat_member.m_ID;
+            update.m_ChatID = my_chat_member.m_ChatID;
             continue;
         }
 
-        if (key == "update_id")
+        case Key_UpdateId:
         {
-            update_info["id"] =
-                QString::number(mcrUpdate[key].toInteger());
+            update.m_ID = value.toInteger();
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in update")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message = tr("Unknown key \"%1\" in update")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
     // Save update info
-    if (!update_info.contains("id"))
+    if (update.IsEmpty())
     {
         const QString reason = tr("Update is missing an ID");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return UpdateRecord();
     }
-    m_UpdateIDToInfo[update_id] = update_info;
-    SaveInfoData("update_info", update_info);
+    mrParsed.m_Updates << update;
 
     CALL_OUT("");
-    return update_info;
+    return update;
 }
 
 
@@ -1697,6 +2690,29 @@ QHash < QString, QString > TelegramComms::GetUpdateInfo(
         return QHash < QString, QString >();
     }
 
+    CALL_OUT("");
+    return m_UpdateIDToInfo[mcUpdateID].ToHash();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Update (typed)
+UpdateRecord TelegramComms::GetUpdateRecord(const qint64 mcUpdateID) const
+{
+    CALL_IN(QString("mcUpdateID=%1")
+        .arg(CALL_SHOW(mcUpdateID)));
+
+    // Check if we have this update
+    if (!m_UpdateIDToInfo.contains(mcUpdateID))
+    {
+        const QString reason = tr("Update ID %1 does not exist")
+            .arg(QString::number(mcUpdateID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return UpdateRecord();
+    }
+
     CALL_OUT("");
     return m_UpdateIDToInfo[mcUpdateID];
 }
@@ -1705,11 +2721,12 @@ QHash < QString, QString > TelegramComms::GetUpdateInfo(
 
 ///////////////////////////////////////////////////////////////////////////////
 // Parse response: Message
-QHash < QString, QString > TelegramComms::Parse_Message(
-    const QJsonObject & mcrMessage)
+MessageRecord TelegramComms::Parse_Message(const QJsonObject & mcrMessage,
+    ParsedEntities & mrParsed, const bool mcIsEdit) const
 {
-    CALL_IN(QString("mcrMessage=%1")
-        .arg(CALL_SHOW_FULL(mcrMessage)));
+    CALL_IN_LAZY(QString("mcrMessage=%1, mcIsEdit=%2")
+        .arg(CALL_SHOW_FULL(mcrMessage),
+             CALL_SHOW(mcIsEdit)));
 
     // General message
     // {
@@ -1785,9 +2802,11 @@ QHash < QString, QString > TelegramComms::Parse_Message(
 
 
 
-    // Check if we have parsed this message previously
+    // Check if we have parsed this message previously (edits of a known
+    // message are parsed again; the changes are saved when committing)
     const qint64 message_id = mcrMessage["message_id"].toInteger();
-    if (m_MessageIDToInfo.contains(message_id))
+    if (!mcIsEdit &&
+        m_MessageIDToInfo.contains(message_id))
     {
         // Nothing to do here.
         CALL_OUT("");
@@ -1796,78 +2815,137 @@ QHash < QString, QString > TelegramComms::Parse_Message(
 
     // Parse the new message
 
+    // Known keys
+    enum Key
+    {
+        Key_Animation,
+        Key_Caption,
+        Key_Chat,
+        Key_Date,
+        Key_Document,
+        Key_EditDate,
+        Key_Entities,
+        Key_ForwardDate,
+        Key_ForwardFrom,
+        Key_ForwardFromChat,
+        Key_ForwardFromMessageId,
+        Key_ForwardOrigin,
+        Key_ForwardSenderName,
+        Key_ForwardSignature,
+        Key_From,
+        Key_LinkPreviewOptions,
+        Key_MessageId,
+        Key_MessageThreadId,
+        Key_NewChatMember,
+        Key_NewChatPhoto,
+        Key_NewChatMembers,
+        Key_NewChatParticipant,
+        Key_NewChatTitle,
+        Key_Photo,
+        Key_ReplyMarkup,
+        Key_ReplyToMessage,
+        Key_SenderChat,
+        Key_Sticker,
+        Key_Text
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "animation", Key_Animation },
+        { "caption", Key_Caption },
+        { "chat", Key_Chat },
+        { "date", Key_Date },
+        { "document", Key_Document },
+        { "edit_date", Key_EditDate },
+        { "entities", Key_Entities },
+        { "forward_date", Key_ForwardDate },
+        { "forward_from", Key_ForwardFrom },
+        { "forward_from_chat", Key_ForwardFromChat },
+        { "forward_from_message_id", Key_ForwardFromMessageId },
+        { "forward_origin", Key_ForwardOrigin },
+        { "forward_sender_name", Key_ForwardSenderName },
+        { "forward_signature", Key_ForwardSignature },
+        { "from", Key_From },
+        { "link_preview_options", Key_LinkPreviewOptions },
+        { "message_id", Key_MessageId },
+        { "message_thread_id", Key_MessageThreadId },
+        { "new_chat_member", Key_NewChatMember },
+        { "new_chat_members", Key_NewChatMembers },
+        { "new_chat_participant", Key_NewChatParticipant },
+        { "new_chat_photo", Key_NewChatPhoto },
+        { "new_chat_title", Key_NewChatTitle },
+        { "photo", Key_Photo },
+        { "reply_markup", Key_ReplyMarkup },
+        { "reply_to_message", Key_ReplyToMessage },
+        { "sender_chat", Key_SenderChat },
+        { "sticker", Key_Sticker },
+        { "text", Key_Text }
+    };
+
     // Loop contents
-    QHash < QString, QString > message_info;
-    const QStringList all_keys = mcrMessage.keys();
-    for (const QString & key : all_keys)
+    MessageRecord message;
+    for (auto key_iterator = mcrMessage.constBegin();
+         key_iterator != mcrMessage.constEnd();
+         key_iterator++)
     {
-        if (key == "animation")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
         {
-            const QHash < QString, QString > animation_info =
-                Parse_File(mcrMessage[key].toObject());
-            message_info["animation_file_id"] = animation_info["id"];
+        case Key_Animation:
+        {
+            const FileRecord animation =
+                Parse_File(value.toObject(), mrParsed);
+            message.m_Extras["animation_file_id"] = animation.m_ID;
             continue;
         }
 
-        if (key == "caption")
+        case Key_Caption:
         {
-            message_info["caption"] = mcrMessage[key].toString();
+            message.m_Caption = value.toString();
             continue;
         }
 
-        if (key == "chat")
+        case Key_Chat:
         {
-            const QHash < QString, QString > chat_info =
-                Parse_Chat(mcrMessage[key].toObject());
-            if (chat_info.isEmpty())
+            const ChatRecord chat = Parse_Chat(value.toObject(), mrParsed);
+            if (chat.IsEmpty())
             {
                 const QString reason = tr("Error parsing chat info");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["chat_id"] = chat_info["id"];
-
-            // Add chat to active ones
-            m_ActiveChats += chat_info["id"].toLongLong();
-
+            message.m_ChatID = chat.m_ID;
             continue;
         }
 
-        if (key == "date")
+        case Key_Date:
         {
-            const QDateTime date =
-                QDateTime::fromSecsSinceEpoch(mcrMessage[key].toInt());
-            message_info["date_time"] =
-                date.toString("yyyy-MM-dd hh:mm:ss");
+            message.m_Date = value.toInteger();
             continue;
         }
 
-        if (key == "document")
+        case Key_Document:
         {
-            const QHash < QString, QString > document_info =
-                Parse_File(mcrMessage[key].toObject());
-            if (document_info.isEmpty())
+            const FileRecord document = Parse_File(value.toObject(), mrParsed);
+            if (document.IsEmpty())
             {
                 const QString reason = tr("Error parsing document info");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["document_id"] = document_info["id"];
+            message.m_DocumentID = document.m_ID;
             continue;
         }
 
-        if (key == "edit_date")
+        case Key_EditDate:
         {
-            const QDateTime date =
-                QDateTime::fromSecsSinceEpoch(mcrMessage[key].toInt());
-            message_info["edit_date_time"] =
-                date.toString("yyyy-MM-dd hh:mm:ss");
+            message.m_EditDate = value.toInteger();
             continue;
         }
 
-        if (key == "entities")
+        case Key_Entities:
         {
             // [
             //   {
@@ -1880,55 +2958,50 @@ QHash < QString, QString > TelegramComms::Parse_Message(
             continue;
         }
 
-        if (key == "forward_date")
+        case Key_ForwardDate:
         {
-            const QDateTime date =
-                QDateTime::fromSecsSinceEpoch(mcrMessage[key].toInt());
-            message_info["forward_date_time"] =
-                date.toString("yyyy-MM-dd hh:mm:ss");
+            message.m_ForwardDate = value.toInteger();
             continue;
         }
 
-        if (key == "forward_from")
+        case Key_ForwardFrom:
         {
-            const QHash < QString, QString > user_info =
-                Parse_User(mcrMessage[key].toObject());
-            if (user_info.isEmpty())
+            const UserRecord user = Parse_User(value.toObject(), mrParsed);
+            if (user.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing user info (forward_from)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["forward_from_id"] = user_info["id"];
+            message.m_ForwardFromID = user.m_ID;
             continue;
         }
 
-        if (key == "forward_from_chat")
+        case Key_ForwardFromChat:
         {
-            const QHash < QString, QString > chat_info =
-                Parse_Chat(mcrMessage[key].toObject());
-            if (chat_info.isEmpty())
+            const ChatRecord chat = Parse_Chat(value.toObject(), mrParsed);
+            if (chat.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing chat info (forward_from_chat)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["forward_from_chat_id"] = chat_info["id"];
+            message.m_ForwardFromChatID = chat.m_ID;
             continue;
         }
 
-        if (key == "forward_from_message_id")
+        case Key_ForwardFromMessageId:
         {
-            message_info["forward_from_message_id"] =
-                QString::number(mcrMessage[key].toInteger());
+            message.m_Extras["forward_from_message_id"] =
+                QString::number(value.toInteger());
             continue;
         }
 
-        if (key == "forward_origin")
+        case Key_ForwardOrigin:
         {
             // Combines the following:
             // - forward_signature
@@ -1956,34 +3029,33 @@ QHash < QString, QString > TelegramComms::Parse_Message(
             continue;
         }
 
-        if (key == "forward_sender_name")
+        case Key_ForwardSenderName:
         {
-            message_info["forward_sender_name"] = mcrMessage[key].toString();
+            message.m_Extras["forward_sender_name"] = value.toString();
             continue;
         }
 
-        if (key == "forward_signature")
+        case Key_ForwardSignature:
         {
-            message_info["forward_singature"] = mcrMessage[key].toString();
+            message.m_Extras["forward_singature"] = value.toString();
             continue;
         }
 
-        if (key == "from")
+        case Key_From:
         {
-            const QHash < QString, QString > user_info =
-                Parse_User(mcrMessage[key].toObject());
-            if (user_info.isEmpty())
+            const UserRecord user = Parse_User(value.toObject(), mrParsed);
+            if (user.IsEmpty())
             {
                 const QString reason = tr("Error parsing user info (from)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["from_id"] = user_info["id"];
+            message.m_FromID = user.m_ID;
             continue;
         }
 
-        if (key == "link_preview_options")
+        case Key_LinkPreviewOptions:
         {
             // "link_preview_options":
             // {
@@ -1991,43 +3063,42 @@ QHash < QString, QString > TelegramComms::Parse_Message(
             // }
             // !!! Ignore for now
             qDebug().noquote() << key
-                << QJsonDocument(mcrMessage[key].toArray()).toJson();
+                << QJsonDocument(value.toArray()).toJson();
             continue;
         }
 
-        if (key == "message_id")
+        case Key_MessageId:
         {
-            const qint64 message_id = mcrMessage[key].toInteger();
-            message_info["id"] = QString::number(message_id);
+            message.m_ID = value.toInteger();
             continue;
         }
 
-        if (key == "message_thread_id")
+        case Key_MessageThreadId:
         {
-            const qint64 message_id = mcrMessage[key].toInteger();
-            message_info["message_thread_id"] = QString::number(message_id);
+            const qint64 thread_id = value.toInteger();
+            message.m_Extras["message_thread_id"] = QString::number(thread_id);
             continue;
         }
 
-        if (key == "new_chat_member")
+        case Key_NewChatMember:
         {
-            const QHash < QString, QString > user_info =
-                Parse_User(mcrMessage[key].toObject());
-            if (user_info.isEmpty())
+            const UserRecord user = Parse_User(value.toObject(), mrParsed);
+            if (user.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing user info (new_chat_member)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["new_chat_member_id"] = user_info["id"];
+            message.m_Extras["new_chat_member_id"] =
+                QString::number(user.m_ID);
             continue;
         }
 
-        if (key == "new_chat_photo")
+        case Key_NewChatPhoto:
         {
-            QJsonArray photos = mcrMessage[key].toArray();
+            QJsonArray photos = value.toArray();
             QJsonObject last_photo = photos.last().toObject();
             if (last_photo.isEmpty())
             {
@@ -2036,41 +3107,40 @@ QHash < QString, QString > TelegramComms::Parse_Message(
                     tr("New channel photo array did not have a last entry.");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            const QHash < QString, QString > photo_info =
-                Parse_File(last_photo);
-            if (photo_info.isEmpty())
+            const FileRecord photo = Parse_File(last_photo, mrParsed);
+            if (photo.IsEmpty())
             {
                 const QString reason = tr("Error parsing in picture list "
                     "(new channel photo)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["new_chat_photo_id"] = photo_info["id"];
+            message.m_Extras["new_chat_photo_id"] = photo.m_ID;
             continue;
         }
 
-        if (key == "new_chat_members")
+        case Key_NewChatMembers:
         {
             // Ignored because redundant with new_chat_member
             continue;
         }
 
-        if (key == "new_chat_participant")
+        case Key_NewChatParticipant:
         {
             // Ignored because redundant with new_chat_member
             continue;
         }
 
-        if (key == "new_chat_title")
+        case Key_NewChatTitle:
         {
-            message_info[key] = mcrMessage[key].toString();
+            message.m_Extras[StringPool::Intern(key)] = value.toString();
             continue;
         }
 
-        if (key == "photo")
+        case Key_Photo:
         {
             // Contains an array of the picture in various sizes
             // [
@@ -2100,7 +3170,7 @@ QHash < QString, QString > TelegramComms::Parse_Message(
             //     "width":1280
             //   }
             // ]
-            QJsonArray photos = mcrMessage[key].toArray();
+            QJsonArray photos = value.toArray();
             QJsonObject last_photo = photos.last().toObject();
             if (last_photo.isEmpty())
             {
@@ -2109,105 +3179,112 @@ QHash < QString, QString > TelegramComms::Parse_Message(
                     tr("photo array did not have a last entry.");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            const QHash < QString, QString > photo_info =
-                Parse_File(last_photo);
-            if (photo_info.isEmpty())
+            const FileRecord photo = Parse_File(last_photo, mrParsed);
+            if (photo.IsEmpty())
             {
                 const QString reason = tr("Error parsing in photos list "
                     "(photo)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["photo_file_id"] = photo_info["id"];
+            message.m_PhotoFileID = photo.m_ID;
             continue;
         }
 
-        if (key == "reply_markup")
+        case Key_ReplyMarkup:
         {
-            const QHash < QString, QString > button_list =
-                Parse_ButtonList(mcrMessage[key].toObject());
-            message_info["button_list_id"] = button_list["id"];
+            // Keyboards get their IDs when they are committed
+            const KeyboardRecord keyboard = Parse_Keyboard(value.toObject());
+            if (!keyboard.IsEmpty())
+            {
+                mrParsed.m_Keyboards << QPair < qint64, KeyboardRecord >(
+                    message_id, keyboard);
+            }
             continue;
         }
 
-        if (key == "reply_to_message")
+        case Key_ReplyToMessage:
         {
-            const QHash < QString, QString > reply_to_message_info =
-                Parse_Message(mcrMessage[key].toObject());
-            if (reply_to_message_info.isEmpty())
+            const MessageRecord reply_to_message =
+                Parse_Message(value.toObject(), mrParsed);
+            if (reply_to_message.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing message info (reply_to)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["reply_to_message_id"] = reply_to_message_info["id"];
+            message.m_ReplyToMessageID = reply_to_message.m_ID;
             continue;
         }
 
-        if (key == "sender_chat")
+        case Key_SenderChat:
         {
-            const QHash < QString, QString > chat_info =
-                Parse_Chat(mcrMessage[key].toObject());
-            if (chat_info.isEmpty())
+            const ChatRecord chat = Parse_Chat(value.toObject(), mrParsed);
+            if (chat.IsEmpty())
             {
                 const QString reason = tr("Error parsing sender_chat info");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["sender_chat_id"] = chat_info["id"];
+            message.m_SenderChatID = chat.m_ID;
             continue;
         }
 
-        if (key == "sticker")
+        case Key_Sticker:
         {
-            const QHash < QString, QString > sticker_info =
-                Parse_File(mcrMessage[key].toObject());
-            if (sticker_info.isEmpty())
+            const FileRecord sticker = Parse_File(value.toObject(), mrParsed);
+            if (sticker.IsEmpty())
             {
                 const QString reason = tr("Error parsing sticker info");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MessageRecord();
             }
-            message_info["sticker_id"] = sticker_info["id"];
+            message.m_StickerID = sticker.m_ID;
             continue;
         }
 
-        if (key == "text")
+        case Key_Text:
         {
-            message_info["text"] = mcrMessage[key].toString();
+            message.m_Text = value.toString();
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in message")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString reason = tr("Unknown key \"%1\" in message")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, reason);
+            continue;
+        }
+        }
     }
 
     // Save message info
-    if (!message_info.contains("id"))
+    if (message.IsEmpty())
     {
         const QString reason = tr("Message is missing an ID");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return MessageRecord();
+    }
+    if (mcIsEdit)
+    {
+        mrParsed.m_EditedMessages << message;
+    } else
+    {
+        mrParsed.m_Messages << message;
     }
-    m_MessageIDToInfo[message_id] = message_info;
-    SaveInfoData("message_info", message_info);
-
-    // Let everybody know
-    const qint64 chat_id = message_info["chat_id"].toLongLong();
-    emit MessageReceived(chat_id, message_id);
 
     CALL_OUT("");
-    return message_info;
+    return message;
 }
 
 
@@ -2242,7 +3319,30 @@ QHash < QString, QString > TelegramComms::GetMessageInfo(
             .arg(QString::number(mcMessageID));
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return MessageRecord();
+    }
+
+    CALL_OUT("");
+    return m_MessageIDToInfo[mcMessageID].ToHash();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Message (typed)
+MessageRecord TelegramComms::GetMessageRecord(const qint64 mcMessageID) const
+{
+    CALL_IN(QString("mcMessageID=%1")
+        .arg(CALL_SHOW(mcMessageID)));
+
+    // Check if we have this message
+    if (!m_MessageIDToInfo.contains(mcMessageID))
+    {
+        const QString reason = tr("Message ID %1 does not exist")
+            .arg(QString::number(mcMessageID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return MessageRecord();
     }
 
     CALL_OUT("");
@@ -2253,10 +3353,10 @@ QHash < QString, QString > TelegramComms::GetMessageInfo(
 
 ///////////////////////////////////////////////////////////////////////////////
 // Parse response: User
-QHash < QString, QString > TelegramComms::Parse_User(
-    const QJsonObject & mcrUser)
+UserRecord TelegramComms::Parse_User(const QJsonObject & mcrUser,
+    ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrUser=%1")
+    CALL_IN_LAZY(QString("mcrUser=%1")
         .arg(CALL_SHOW_FULL(mcrUser)));
 
     // {
@@ -2280,68 +3380,103 @@ QHash < QString, QString > TelegramComms::Parse_User(
 
     // Parse the new user
 
+    // Known keys
+    enum Key
+    {
+        Key_FirstName,
+        Key_Id,
+        Key_IsBot,
+        Key_IsPremium,
+        Key_LanguageCode,
+        Key_LastName,
+        Key_Username
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "first_name", Key_FirstName },
+        { "id", Key_Id },
+        { "is_bot", Key_IsBot },
+        { "is_premium", Key_IsPremium },
+        { "language_code", Key_LanguageCode },
+        { "last_name", Key_LastName },
+        { "username", Key_Username }
+    };
+
     // Loop contents
-    QHash < QString, QString > user_info;
-    const QStringList all_keys = mcrUser.keys();
-    for (const QString & key : all_keys)
+    UserRecord user;
+    for (auto key_iterator = mcrUser.constBegin();
+         key_iterator != mcrUser.constEnd();
+         key_iterator++)
     {
-        if (key == "first_name")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
+        {
+        case Key_FirstName:
         {
-            user_info["first_name"] = mcrUser[key].toString();
+            user.m_FirstName = value.toString();
             continue;
         }
-        if (key == "id")
+
+        case Key_Id:
         {
-            user_info["id"] = QString::number(mcrUser[key].toInteger());
+            user.m_ID = value.toInteger();
             continue;
         }
-        if (key == "is_bot")
+
+        case Key_IsBot:
         {
-            user_info["is_bot"] =
-                mcrUser[key].toBool() ? "true" : "false";
+            user.m_IsBot = value.toBool();
             continue;
         }
-        if (key == "is_premium")
+
+        case Key_IsPremium:
         {
-            user_info["is_premium"] =
-                mcrUser[key].toBool() ? "true" : "false";
+            user.m_IsPremium = value.toBool();
             continue;
         }
-        if (key == "language_code")
+
+        case Key_LanguageCode:
         {
-            user_info["language_code"] = mcrUser[key].toString();
+            user.m_LanguageCode = StringPool::Intern(value.toString());
             continue;
         }
-        if (key == "last_name")
+
+        case Key_LastName:
         {
-            user_info["last_name"] = mcrUser[key].toString();
+            user.m_LastName = value.toString();
             continue;
         }
-        if (key == "username")
+
+        case Key_Username:
         {
-            user_info["username"] = mcrUser[key].toString();
+            user.m_Username = value.toString();
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in user")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message = tr("Unknown key \"%1\" in user")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
     // Save user info
-    if (!user_info.contains("id"))
+    if (user.IsEmpty())
     {
         const QString reason = tr("User is missing an ID");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return UserRecord();
     }
-    m_UserIDToInfo[user_id] = user_info;
-    SaveInfoData("user_info", user_info);
+    mrParsed.m_Users << user;
 
     CALL_OUT("");
-    return user_info;
+    return user;
 }
 
 
@@ -2378,6 +3513,29 @@ QHash < QString, QString > TelegramComms::GetUserInfo(const qint64 mcUserID)
         return QHash < QString, QString >();
     }
 
+    CALL_OUT("");
+    return m_UserIDToInfo[mcUserID].ToHash();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// User (typed)
+UserRecord TelegramComms::GetUserRecord(const qint64 mcUserID) const
+{
+    CALL_IN(QString("mcUserID=%1")
+        .arg(CALL_SHOW(mcUserID)));
+
+    // Check if we have this user
+    if (!m_UserIDToInfo.contains(mcUserID))
+    {
+        const QString reason = tr("User ID %1 does not exist")
+            .arg(QString::number(mcUserID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return UserRecord();
+    }
+
     CALL_OUT("");
     return m_UserIDToInfo[mcUserID];
 }
@@ -2386,10 +3544,10 @@ QHash < QString, QString > TelegramComms::GetUserInfo(const qint64 mcUserID)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Parse response: Chat
-QHash < QString, QString > TelegramComms::Parse_Chat(
-    const QJsonObject & mcrChat)
+ChatRecord TelegramComms::Parse_Chat(const QJsonObject & mcrChat,
+    ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrChat=%1")
+    CALL_IN_LAZY(QString("mcrChat=%1")
         .arg(CALL_SHOW_FULL(mcrChat)));
 
     // Group
@@ -2421,75 +3579,112 @@ QHash < QString, QString > TelegramComms::Parse_Chat(
 
     // Parse the new chat
 
+    // Known keys
+    enum Key
+    {
+        Key_AllMembersAreAdministrators,
+        Key_FirstName,
+        Key_Id,
+        Key_Title,
+        Key_Type,
+        Key_IsBot,
+        Key_LastName,
+        Key_Username
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "all_members_are_administrators", Key_AllMembersAreAdministrators },
+        { "first_name", Key_FirstName },
+        { "id", Key_Id },
+        { "is_bot", Key_IsBot },
+        { "last_name", Key_LastName },
+        { "title", Key_Title },
+        { "type", Key_Type },
+        { "username", Key_Username }
+    };
+
     // Loop contents
-    QHash < QString, QString > chat_info;
-    const QStringList all_keys = mcrChat.keys();
-    for (const QString & key : all_keys)
+    ChatRecord chat;
+    for (auto key_iterator = mcrChat.constBegin();
+         key_iterator != mcrChat.constEnd();
+         key_iterator++)
     {
-        if (key == "all_members_are_administrators")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
+        {
+        case Key_AllMembersAreAdministrators:
         {
-            chat_info["all_members_are_administrators"] =
-                mcrChat[key].toBool() ? "true" : "false";
+            chat.m_Extras["all_members_are_administrators"] =
+                value.toBool() ? "true" : "false";
             continue;
         }
 
-        if (key == "first_name")
+        case Key_FirstName:
         {
-            chat_info["first_name"] = mcrChat[key].toString();
+            chat.m_FirstName = value.toString();
             continue;
         }
-        if (key == "id")
+
+        case Key_Id:
         {
-            chat_info["id"] =
-                QString::number(mcrChat[key].toInteger());
+            chat.m_ID = value.toInteger();
             continue;
         }
-        if (key == "title")
+
+        case Key_Title:
         {
-            chat_info["title"] = mcrChat[key].toString();
+            chat.m_Title = value.toString();
             continue;
         }
-        if (key == "type")
+
+        case Key_Type:
         {
-            chat_info["type"] = mcrChat[key].toString();
+            chat.m_Type = StringPool::Intern(value.toString());
             continue;
         }
-        if (key == "is_bot")
+
+        case Key_IsBot:
         {
-            chat_info["first_name"] =
-                mcrChat[key].toBool() ? "true" : "false";
+            chat.m_Extras["is_bot"] = value.toBool() ? "true" : "false";
             continue;
         }
-        if (key == "last_name")
+
+        case Key_LastName:
         {
-            chat_info["last_name"] = mcrChat[key].toString();
+            chat.m_LastName = value.toString();
             continue;
         }
-        if (key == "username")
+
+        case Key_Username:
         {
-            chat_info["username"] = mcrChat[key].toString();
+            chat.m_Username = value.toString();
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in chat")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message = tr("Unknown key \"%1\" in chat")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
     // Save chat info
-    if (!chat_info.contains("id"))
+    if (chat.IsEmpty())
     {
         const QString reason = tr("Chat is missing an id");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return ChatRecord();
     }
-    m_ChatIDToInfo[chat_id] = chat_info;
-    SaveInfoData("chat_info", chat_info);
+    mrParsed.m_Chats << chat;
 
     CALL_OUT("");
-    return chat_info;
+    return chat;
 }
 
 
@@ -2526,6 +3721,29 @@ QHash < QString, QString > TelegramComms::GetChatInfo(const qint64 mcChatID)
         return QHash < QString, QString >();
     }
 
+    CALL_OUT("");
+    return m_ChatIDToInfo[mcChatID].ToHash();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Chat (typed)
+ChatRecord TelegramComms::GetChatRecord(const qint64 mcChatID) const
+{
+    CALL_IN(QString("mcChatID=%1")
+        .arg(CALL_SHOW(mcChatID)));
+
+    // Check if we have this chat
+    if (!m_ChatIDToInfo.contains(mcChatID))
+    {
+        const QString reason = tr("Chat ID %1 does not exist")
+            .arg(QString::number(mcChatID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return ChatRecord();
+    }
+
     CALL_OUT("");
     return m_ChatIDToInfo[mcChatID];
 }
@@ -2534,10 +3752,10 @@ QHash < QString, QString > TelegramComms::GetChatInfo(const qint64 mcChatID)
 
 ///////////////////////////////////////////////////////////////////////////////
 // Parse response: Chat members
-QHash < QString, QString > TelegramComms::Parse_MyChatMember(
-    const QJsonObject & mcrMyChatMember)
+MyChatMemberRecord TelegramComms::Parse_MyChatMember(
+    const QJsonObject & mcrMyChatMember, ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrMyChatMember=%1")
+    CALL_IN_LAZY(QString("mcrMyChatMember=%1")
         .arg(CALL_SHOW_FULL(mcrMyChatMember)));
 
     // {
@@ -2548,125 +3766,149 @@ QHash < QString, QString > TelegramComms::Parse_MyChatMember(
     //   "new_chat_member":{...}
     // }
 
+    // Known keys
+    enum Key
+    {
+        Key_Chat,
+        Key_Date,
+        Key_From,
+        Key_OldChatMember,
+        Key_NewChatMember
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "chat", Key_Chat },
+        { "date", Key_Date },
+        { "from", Key_From },
+        { "new_chat_member", Key_NewChatMember },
+        { "old_chat_member", Key_OldChatMember }
+    };
+
     // Loop contents
-    QHash < QString, QString > mychatmember_info;
-    const QStringList all_keys = mcrMyChatMember.keys();
-    for (const QString & key : all_keys)
+    MyChatMemberRecord my_chat_member;
+    for (auto key_iterator = mcrMyChatMember.constBegin();
+         key_iterator != mcrMyChatMember.constEnd();
+         key_iterator++)
     {
-        if (key == "chat")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
         {
-            const QHash < QString, QString > chat_info =
-                Parse_Chat(mcrMyChatMember[key].toObject());
-            if (chat_info.isEmpty())
+        case Key_Chat:
+        {
+            const ChatRecord chat = Parse_Chat(value.toObject(), mrParsed);
+            if (chat.IsEmpty())
             {
                 const QString reason = tr("Error parsing chat info");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MyChatMemberRecord();
             }
-            mychatmember_info["chat_id"] = chat_info["id"];
+            my_chat_member.m_ChatID = chat.m_ID;
             continue;
         }
 
-        if (key == "date")
+        case Key_Date:
         {
-            const QDateTime date =
-                QDateTime::fromSecsSinceEpoch(mcrMyChatMember[key].toInt());
-            mychatmember_info["date_time"] =
-                date.toString("yyyy-MM-dd hh:mm:ss");
+            my_chat_member.m_Date = value.toInteger();
 
             // Also use the timestamp as ID
-            mychatmember_info["id"] =
-                QString::number(mcrMyChatMember[key].toInteger());
+            my_chat_member.m_ID = my_chat_member.m_Date;
             continue;
         }
 
-        if (key == "from")
+        case Key_From:
         {
-            const QHash < QString, QString > user_info =
-                Parse_User(mcrMyChatMember[key].toObject());
-            if (user_info.isEmpty())
+            const UserRecord user = Parse_User(value.toObject(), mrParsed);
+            if (user.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing in my_chat_member info (from)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MyChatMemberRecord();
             }
-            mychatmember_info["from_id"] = user_info["id"];
+            my_chat_member.m_FromID = user.m_ID;
             continue;
         }
 
-        if (key == "old_chat_member")
+        case Key_OldChatMember:
         {
             const QJsonObject old_chat_member =
-                mcrMyChatMember["old_chat_member"].toObject();
+                value.toObject();
             const QHash < QString, QString > old_chat_member_info =
-                Parse_MyChatMember_OldChatMember(old_chat_member);
+                Parse_MyChatMember_OldChatMember(old_chat_member, mrParsed);
             if (old_chat_member_info.isEmpty())
             {
                 const QString reason = tr("Error parsing in my_chat_member "
                     "info (old_chat_member)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MyChatMemberRecord();
             }
             for (auto subkey_iterator = old_chat_member_info.keyBegin();
                  subkey_iterator != old_chat_member_info.keyEnd();
                  subkey_iterator++)
             {
                 const QString & subkey = *subkey_iterator;
-                mychatmember_info["old_chat_member_" + subkey] =
-                    old_chat_member_info[subkey];
+                const QString extras_key =
+                    StringPool::Intern("old_chat_member_" + subkey);
+                my_chat_member.m_Extras[extras_key] =
+                    StringPool::Intern(old_chat_member_info[subkey]);
             }
             continue;
         }
 
-        if (key == "new_chat_member")
+        case Key_NewChatMember:
         {
             const QJsonObject new_chat_member =
-                mcrMyChatMember["new_chat_member"].toObject();
+                value.toObject();
             const QHash < QString, QString > new_chat_member_info =
-                Parse_MyChatMember_NewChatMember(new_chat_member);
+                Parse_MyChatMember_NewChatMember(new_chat_member, mrParsed);
             if (new_chat_member_info.isEmpty())
             {
                 const QString reason = tr("Error parsing in my_chat_member "
                     "info (new_chat_member)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return MyChatMemberRecord();
             }
             for (auto subkey_iterator = new_chat_member_info.keyBegin();
                  subkey_iterator != new_chat_member_info.keyEnd();
                  subkey_iterator++)
             {
                 const QString & subkey = *subkey_iterator;
-                mychatmember_info["new_chat_member_" + subkey] =
-                    new_chat_member_info[subkey];
+                const QString extras_key =
+                    StringPool::Intern("new_chat_member_" + subkey);
+                my_chat_member.m_Extras[extras_key] =
+                    StringPool::Intern(new_chat_member_info[subkey]);
             }
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in my_chat_member")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message = tr("Unknown key \"%1\" in my_chat_member")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
     // Save mychatmember info
-    if (!mychatmember_info.contains("id"))
+    if (my_chat_member.IsEmpty())
     {
         const QString reason = tr("MyChatMember is missing an ID");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return MyChatMemberRecord();
     }
-    const qint64 mychatmember_id = mychatmember_info["id"].toLongLong();
-    m_MyChatMemberIDToInfo[mychatmember_id] = mychatmember_info;
-    SaveInfoData("my_chat_member_info", mychatmember_info);
+    mrParsed.m_MyChatMembers << my_chat_member;
 
     CALL_OUT("");
-    return mychatmember_info;
+    return my_chat_member;
 }
 
 
@@ -2674,9 +3916,9 @@ QHash < QString, QString > TelegramComms::Parse_MyChatMember(
 ///////////////////////////////////////////////////////////////////////////////
 // Parse response: Chat members, old chat member
 QHash < QString, QString > TelegramComms::Parse_MyChatMember_OldChatMember(
-    const QJsonObject & mcrOldChatMember)
+    const QJsonObject & mcrOldChatMember, ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrOldChatMember=%1")
+    CALL_IN_LAZY(QString("mcrOldChatMember=%1")
         .arg(CALL_SHOW_FULL(mcrOldChatMember)));
 
     // {
@@ -2684,36 +3926,57 @@ QHash < QString, QString > TelegramComms::Parse_MyChatMember_OldChatMember(
     //   "status":"member"
     // }
 
+    // Known keys
+    enum Key
+    {
+        Key_User,
+        Key_Status
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "status", Key_Status },
+        { "user", Key_User }
+    };
+
     // Loop contents
     QHash < QString, QString > oldchatmember_info;
-    const QStringList all_keys = mcrOldChatMember.keys();
-    for (const QString & key : all_keys)
+    for (auto key_iterator = mcrOldChatMember.constBegin();
+         key_iterator != mcrOldChatMember.constEnd();
+         key_iterator++)
     {
-        if (key == "user")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
+        {
+        case Key_User:
         {
-            const QHash < QString, QString > user_info =
-                Parse_User(mcrOldChatMember[key].toObject());
-            if (user_info.isEmpty())
+            const UserRecord user = Parse_User(value.toObject(), mrParsed);
+            if (user.IsEmpty())
             {
                 const QString reason = tr("Error parsing user info");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
                 return QHash < QString, QString >();
             }
-            oldchatmember_info["user_id"] = user_info["id"];
+            oldchatmember_info["user_id"] = QString::number(user.m_ID);
             continue;
         }
 
-        if (key == "status")
+        case Key_Status:
         {
-            oldchatmember_info["status"] = mcrOldChatMember[key].toString();
+            oldchatmember_info["status"] = value.toString();
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in old_chat_member")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message = tr("Unknown key \"%1\" in old_chat_member")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
     CALL_OUT("");
@@ -2725,9 +3988,9 @@ QHash < QString, QString > TelegramComms::Parse_MyChatMember_OldChatMember(
 ///////////////////////////////////////////////////////////////////////////////
 // Parse response: Chat members, new chat member
 QHash < QString, QString > TelegramComms::Parse_MyChatMember_NewChatMember(
-    const QJsonObject & mcrNewChatMember)
+    const QJsonObject & mcrNewChatMember, ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrNewChatMember=%1")
+    CALL_IN_LAZY(QString("mcrNewChatMember=%1")
         .arg(CALL_SHOW_FULL(mcrNewChatMember)));
 
     // {
@@ -2753,49 +4016,71 @@ QHash < QString, QString > TelegramComms::Parse_MyChatMember_NewChatMember(
     //   "until_date":0,
     // }
 
-    // Flag values
-    static QSet < QString > flag_values;
-    if (flag_values.isEmpty())
-    {
-        flag_values << "can_be_edited" << "can_manage_chat"
-            << "can_change_info" << "can_delete_messages" << "can_invite_users"
-            << "can_restrict_members" << "can_pin_messages"
-            << "can_manage_topics" << "can_promote_members"
-            << "can_manage_video_chats" << "can_post_stories"
-            << "can_edit_stories" << "can_delete_stories" << "is_anonymous"
-            << "can_manage_voice_chats" << "can_post_messages"
-            << "can_edit_messages";
-    }
+    // Known keys (all can_... and is_anonymous are flag values)
+    enum Key
+    {
+        Key_User,
+        Key_Status,
+        Key_UntilDate,
+        Key_Flag
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "can_be_edited", Key_Flag },
+        { "can_change_info", Key_Flag },
+        { "can_delete_messages", Key_Flag },
+        { "can_delete_stories", Key_Flag },
+        { "can_edit_messages", Key_Flag },
+        { "can_edit_stories", Key_Flag },
+        { "can_invite_users", Key_Flag },
+        { "can_manage_chat", Key_Flag },
+        { "can_manage_topics", Key_Flag },
+        { "can_manage_video_chats", Key_Flag },
+        { "can_manage_voice_chats", Key_Flag },
+        { "can_pin_messages", Key_Flag },
+        { "can_post_messages", Key_Flag },
+        { "can_post_stories", Key_Flag },
+        { "can_promote_members", Key_Flag },
+        { "can_restrict_members", Key_Flag },
+        { "is_anonymous", Key_Flag },
+        { "status", Key_Status },
+        { "until_date", Key_UntilDate },
+        { "user", Key_User }
+    };
 
     // Loop contents
     QHash < QString, QString > newchatmember_info;
-    const QStringList all_keys = mcrNewChatMember.keys();
-    for (const QString & key : all_keys)
+    for (auto key_iterator = mcrNewChatMember.constBegin();
+         key_iterator != mcrNewChatMember.constEnd();
+         key_iterator++)
     {
-        if (key == "user")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
         {
-            const QHash < QString, QString > user_info =
-                Parse_User(mcrNewChatMember[key].toObject());
-            if (user_info.isEmpty())
+        case Key_User:
+        {
+            const UserRecord user = Parse_User(value.toObject(), mrParsed);
+            if (user.IsEmpty())
             {
                 const QString reason = tr("Error parsing user info");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
                 return QHash < QString, QString >();
             }
-            newchatmember_info["user_id"] = user_info["id"];
+            newchatmember_info["user_id"] = QString::number(user.m_ID);
             continue;
         }
 
-        if (key == "status")
+        case Key_Status:
         {
-            newchatmember_info["status"] = mcrNewChatMember[key].toString();
+            newchatmember_info["status"] = value.toString();
             continue;
         }
 
-        if (key == "until_date")
+        case Key_UntilDate:
         {
-            const qint64 since_epoch = mcrNewChatMember[key].toInteger();
+            const qint64 since_epoch = value.toInteger();
             if (since_epoch == 0)
             {
                 newchatmember_info["until_date"] = "";
@@ -2809,17 +4094,21 @@ QHash < QString, QString > TelegramComms::Parse_MyChatMember_NewChatMember(
             continue;
         }
 
-        if (flag_values.contains(key))
+        case Key_Flag:
         {
-            newchatmember_info[key] =
-                mcrNewChatMember[key].toBool() ? "true" : "false";
+            newchatmember_info[key] = value.toBool() ? "true" : "false";
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in new_chat_member")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message = tr("Unknown key \"%1\" in new_chat_member")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
     CALL_OUT("");
@@ -2862,6 +4151,30 @@ QHash < QString, QString > TelegramComms::GetMyChatMemberInfo(
         return QHash < QString, QString >();
     }
 
+    CALL_OUT("");
+    return m_MyChatMemberIDToInfo[mcMyChatMemberID].ToHash();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Chat member (typed)
+MyChatMemberRecord TelegramComms::GetMyChatMemberRecord(
+    const qint64 mcMyChatMemberID) const
+{
+    CALL_IN(QString("mcMyChatMemberID=%1")
+        .arg(CALL_SHOW(mcMyChatMemberID)));
+
+    // Check if we have this my chat member
+    if (!m_MyChatMemberIDToInfo.contains(mcMyChatMemberID))
+    {
+        const QString reason = tr("My Chat Member ID %1 does not exist")
+            .arg(QString::number(mcMyChatMemberID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return MyChatMemberRecord();
+    }
+
     CALL_OUT("");
     return m_MyChatMemberIDToInfo[mcMyChatMemberID];
 }
@@ -2870,10 +4183,10 @@ QHash < QString, QString > TelegramComms::GetMyChatMemberInfo(
 
 ///////////////////////////////////////////////////////////////////////////////
 // Parse response: File
-QHash < QString, QString > TelegramComms::Parse_File(
-    const QJsonObject & mcrFile)
+FileRecord TelegramComms::Parse_File(const QJsonObject & mcrFile,
+    ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrFile=%1")
+    CALL_IN_LAZY(QString("mcrFile=%1")
         .arg(CALL_SHOW_FULL(mcrFile)));
 
     // Animation
@@ -2929,165 +4242,190 @@ QHash < QString, QString > TelegramComms::Parse_File(
     // - one when we try and download a file (file_path)
     // So we need to merge information.
 
+    // Known keys
+    enum Key
+    {
+        Key_Duration,
+        Key_Emoji,
+        Key_FileId,
+        Key_FileName,
+        Key_FilePath,
+        Key_FileSize,
+        Key_FileUniqueId,
+        Key_Height,
+        Key_IsAnimated,
+        Key_IsVideo,
+        Key_MimeType,
+        Key_PremiumAnimation,
+        Key_SetName,
+        Key_Thumb,
+        Key_Thumbnail,
+        Key_Type,
+        Key_Width
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "duration", Key_Duration },
+        { "emoji", Key_Emoji },
+        { "file_id", Key_FileId },
+        { "file_name", Key_FileName },
+        { "file_path", Key_FilePath },
+        { "file_size", Key_FileSize },
+        { "file_unique_id", Key_FileUniqueId },
+        { "height", Key_Height },
+        { "is_animated", Key_IsAnimated },
+        { "is_video", Key_IsVideo },
+        { "mime_type", Key_MimeType },
+        { "premium_animation", Key_PremiumAnimation },
+        { "set_name", Key_SetName },
+        { "thumb", Key_Thumb },
+        { "thumbnail", Key_Thumbnail },
+        { "type", Key_Type },
+        { "width", Key_Width }
+    };
+
     // Get this file info
-    QHash < QString, QString > file_info;
-    const QStringList all_keys = mcrFile.keys();
-    for (const QString & key : all_keys)
+    FileRecord file;
+    for (auto key_iterator = mcrFile.constBegin();
+         key_iterator != mcrFile.constEnd();
+         key_iterator++)
     {
-        if (key == "duration")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
         {
-            file_info[key] = QString::number(mcrFile[key].toDouble());
+        case Key_Duration:
+        {
+            file.m_Extras[StringPool::Intern(key)] =
+                QString::number(value.toDouble());
             continue;
         }
 
-        if (key == "emoji")
+        case Key_Emoji:
         {
-            file_info[key] = mcrFile[key].toString();
+            file.m_Emoji = StringPool::Intern(value.toString());
             continue;
         }
 
-        if (key == "file_id")
+        case Key_FileId:
         {
-            file_info[key] = mcrFile[key].toString();
-            file_info["id"] = file_info[key];
+            file.m_ID = value.toString();
             continue;
         }
 
-        if (key == "file_name")
+        case Key_FileName:
         {
-            file_info[key] = mcrFile[key].toString();
+            file.m_FileName = value.toString();
             continue;
         }
 
-        if (key == "file_path")
+        case Key_FilePath:
         {
-            file_info[key] = mcrFile[key].toString();
+            file.m_Extras[StringPool::Intern(key)] = value.toString();
             continue;
         }
 
-        if (key == "file_size")
+        case Key_FileSize:
         {
-            file_info[key] = QString::number(mcrFile[key].toInteger());
+            file.m_FileSize = value.toInteger();
             continue;
         }
 
-        if (key == "file_unique_id")
+        case Key_FileUniqueId:
         {
-            file_info[key] = mcrFile[key].toString();
+            file.m_FileUniqueID = value.toString();
             continue;
         }
 
-        if (key == "height")
+        case Key_Height:
         {
-            file_info[key] = QString::number(mcrFile[key].toInt());
+            file.m_Height = value.toInt();
             continue;
         }
 
-        if (key == "is_animated")
+        case Key_IsAnimated:
         {
-            file_info[key] = mcrFile[key].toBool() ? "true" : "false";
+            file.m_IsAnimated = value.toBool();
             continue;
         }
 
-        if (key == "is_video")
+        case Key_IsVideo:
         {
-            file_info[key] = mcrFile[key].toBool() ? "true" : "false";
+            file.m_IsVideo = value.toBool();
             continue;
         }
 
-        if (key == "mime_type")
+        case Key_MimeType:
         {
-            file_info[key] = mcrFile[key].toString();
+            file.m_MimeType = StringPool::Intern(value.toString());
             continue;
         }
 
-        if (key == "premium_animation")
+        case Key_PremiumAnimation:
         {
-            const QHash < QString, QString > premium_animation_info =
-                Parse_File(mcrFile[key].toObject());
-            file_info["premium_animation_file_id"] =
-                premium_animation_info["id"];
+            const FileRecord premium_animation =
+                Parse_File(value.toObject(), mrParsed);
+            file.m_Extras["premium_animation_file_id"] = premium_animation.m_ID;
             continue;
         }
 
-        if (key == "set_name")
+        case Key_SetName:
         {
-            file_info[key] = mcrFile[key].toString();
+            file.m_SetName = StringPool::Intern(value.toString());
             continue;
         }
 
-        if (key == "thumb")
+        case Key_Thumb:
         {
             // Ignore
             continue;
         }
 
-        if (key == "thumbnail")
+        case Key_Thumbnail:
         {
             // Ignore
             continue;
         }
 
-        if (key == "type")
+        case Key_Type:
         {
-            file_info[key] = mcrFile[key].toString();
+            file.m_Type = StringPool::Intern(value.toString());
             continue;
         }
 
-        if (key == "width")
+        case Key_Width:
         {
-            file_info[key] = QString::number(mcrFile[key].toInt());
+            file.m_Width = value.toInt();
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in file")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message = tr("Unknown key \"%1\" in file")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
-    // If there was a previous file info, new information should match
-    // existing information if present
-    const QString file_id = file_info["id"];
-    if (!m_FileIDToInfo.contains(file_id))
+    if (file.IsEmpty())
     {
-        m_FileIDToInfo[file_id] = QHash < QString, QString >();
-    }
-    for (auto iterator_key = file_info.keyBegin();
-         iterator_key != file_info.keyEnd();
-         iterator_key++)
-    {
-        const QString key = *iterator_key;
-        if (m_FileIDToInfo[file_id].contains(key))
-        {
-            if (m_FileIDToInfo[file_id][key] != file_info[key])
-            {
-                // Mismatch
-                const QString reason = tr("File ID %1 has data mismatch "
-                    "for key \"%2\": old: \"%3\", new: \"%4\"")
-                    .arg(file_id,
-                         key,
-                         m_FileIDToInfo[file_id][key],
-                         file_info[key]);
-                qDebug().noquote() << reason;
-            }
-        } else
-        {
-            // Includen new information
-            m_FileIDToInfo[file_id][key] = file_info[key];
-        }
+        const QString reason = tr("File is missing an ID");
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return FileRecord();
     }
 
-    // Save file info
-    SaveInfoData("file_info", m_FileIDToInfo[file_id], "text");
+    mrParsed.m_Files << file;
 
     CALL_OUT("");
-    return m_FileIDToInfo[file_id];
+    return file;
 }
 
 
 
-
 ///////////////////////////////////////////////////////////////////////////////
 // Check if file info exists
 bool TelegramComms::DoesFileInfoExist(const QString & mcrFileID) const
@@ -3121,6 +4459,29 @@ QHash < QString, QString > TelegramComms::GetFileInfo(
         return QHash < QString, QString >();
     }
 
+    CALL_OUT("");
+    return m_FileIDToInfo[mcrFileID].ToHash();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// File info (typed)
+FileRecord TelegramComms::GetFileRecord(const QString & mcrFileID) const
+{
+    CALL_IN(QString("mcrFileID=%1")
+        .arg(CALL_SHOW(mcrFileID)));
+
+    // Check if we have this file
+    if (!m_FileIDToInfo.contains(mcrFileID))
+    {
+        const QString reason = tr("File ID %1 does not exist")
+            .arg(mcrFileID);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return FileRecord();
+    }
+
     CALL_OUT("");
     return m_FileIDToInfo[mcrFileID];
 }
@@ -3128,20 +4489,21 @@ QHash < QString, QString > TelegramComms::GetFileInfo(
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Parse response: ButtonList
-QHash < QString, QString > TelegramComms::Parse_ButtonList(
-    const QJsonObject & mcrButtonList)
+// Parse response: Keyboard
+KeyboardRecord TelegramComms::Parse_Keyboard(
+    const QJsonObject & mcrReplyMarkup) const
 {
-    CALL_IN(QString("mcrButtonList=%1")
-        .arg(CALL_SHOW_FULL(mcrButtonList)));
+    CALL_IN_LAZY(QString("mcrReplyMarkup=%1")
+        .arg(CALL_SHOW_FULL(mcrReplyMarkup)));
 
     // {
     //   "inline_keyboard":
     //   [
     //     [
-    //       {...},
-    //       {...},
-    //       {...},
+    //       {
+    //         "callback_data":"/vote up 10346160",
+    //         "text":"👍"
+    //       },
     //       ...
     //     ],
     //     [
@@ -3152,21 +4514,18 @@ QHash < QString, QString > TelegramComms::Parse_ButtonList(
     // }
 
     const QJsonArray button_row_array =
-        mcrButtonList["inline_keyboard"].toArray();
+        mcrReplyMarkup["inline_keyboard"].toArray();
     if (button_row_array.isEmpty())
     {
         const QString reason =
             tr("reply_markup did not have a \"inline_keyboard\" member.");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return KeyboardRecord();
     }
 
-    // Return value
-    QHash < QString, QString > button_list;
-    button_list["num_rows"] = QString::number(button_row_array.size());
-
     // Loop rows
+    KeyboardRecord keyboard;
     for (int row = 0;
          row < button_row_array.size();
          row++)
@@ -3178,15 +4537,11 @@ QHash < QString, QString > TelegramComms::Parse_ButtonList(
                 .arg(QString::number(row));
             MessageLogger::Error(CALL_METHOD, reason);
             CALL_OUT(reason);
-            return QHash < QString, QString >();
+            return KeyboardRecord();
         }
 
-        const QString row_name = QString("row_%1")
-            .arg(QString::number(row));
-        button_list[row_name + "_num_cols"] =
-            QString::number(this_row.size());
-
         // Loop columns
+        QList < KeyboardRecord::Button > buttons;
         for (int column = 0;
              column < this_row.size();
              column++)
@@ -3199,125 +4554,54 @@ QHash < QString, QString > TelegramComms::Parse_ButtonList(
                          QString::number(column));
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return KeyboardRecord();
             }
-            const QHash < QString, QString > button =
-                Parse_Button(this_button);
-
-            const QString col_name = QString("col_%1")
-                .arg(QString::number(column));
-            button_list[row_name + "_" + col_name + "_button_id"] =
-                button["id"];
-        }
-    }
-
-    // Save button list info
-    const qint64 button_list_id = m_NextButtonListID++;
-    button_list["id"] = QString::number(button_list_id);
-    m_ButtonListIDToInfo[button_list_id] = button_list;
-    SaveInfoData("button_list_info", button_list);
-
-    CALL_OUT("");
-    return button_list;
-}
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// Check if button list info exists
-bool TelegramComms::DoesButtonListInfoExist(const qint64 mcButtonListID) const
-{
-    CALL_IN(QString("mcButtonListID=%1")
-        .arg(CALL_SHOW(mcButtonListID)));
-
-    const bool exists = m_ButtonListIDToInfo.contains(mcButtonListID);
-
-    CALL_OUT("");
-    return exists;
-}
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// Button Lists
-QHash < QString, QString > TelegramComms::GetButtonList(
-    const qint64 mcButtonListID)
-{
-    CALL_IN(QString("mcButtonListID=%1")
-        .arg(CALL_SHOW(mcButtonListID)));
-
-    // Check if we have this button list
-    if (!m_ButtonListIDToInfo.contains(mcButtonListID))
-    {
-        const QString reason = tr("Button list ID %1 does not exist")
-            .arg(mcButtonListID);
-        MessageLogger::Error(CALL_METHOD, reason);
-        CALL_OUT(reason);
-        return QHash < QString, QString >();
-    }
-
-    CALL_OUT("");
-    return m_ButtonListIDToInfo[mcButtonListID];
-}
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// Parse response: Button
-QHash < QString, QString > TelegramComms::Parse_Button(
-    const QJsonObject & mcrButton)
-{
-    CALL_IN(QString("mcrButton=%1")
-        .arg(CALL_SHOW_FULL(mcrButton)));
-
-    // {
-    //   "callback_data":"/vote up 10346160",
-    //   "text":"👍"
-    // }
-
-    // Loop contents
-    QHash < QString, QString > button_info;
-    const QStringList all_keys = mcrButton.keys();
-    for (const QString & key : all_keys)
-    {
-        if (key == "callback_data")
-        {
-            button_info["callback_data"] = mcrButton[key].toString();
-            continue;
-        }
 
-        if (key == "text")
-        {
-            button_info["text"] = mcrButton[key].toString();
-            continue;
+            KeyboardRecord::Button button;
+            for (auto key_iterator = this_button.constBegin();
+                 key_iterator != this_button.constEnd();
+                 key_iterator++)
+            {
+                const QString key = key_iterator.key();
+                if (key == "callback_data")
+                {
+                    button.m_CallbackData = key_iterator.value().toString();
+                    continue;
+                }
+
+                if (key == "text")
+                {
+                    button.m_Text = key_iterator.value().toString();
+                    continue;
+                }
+
+                // Unknown key
+                const QString message = tr("Unknown key \"%1\" in button")
+                    .arg(key);
+                MessageLogger::Error(CALL_METHOD, message);
+            }
+            buttons << button;
         }
-
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in button")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        keyboard.m_Rows << buttons;
     }
 
-    // Save button info
-    const qint64 button_id = m_NextButtonID++;
-    button_info["id"] = QString::number(button_id);
-    m_ButtonIDToInfo[button_id] = button_info;
-    SaveInfoData("button_info", button_info);
+    // Identical keyboards will share one ID (assigned when committed)
+    keyboard.m_ContentHash = keyboard.ComputeContentHash();
 
     CALL_OUT("");
-    return button_info;
+    return keyboard;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Check if button info exists
-bool TelegramComms::DoesButtonInfoExist(const qint64 mcButtonID) const
+// Check if keyboard exists
+bool TelegramComms::DoesKeyboardExist(const qint64 mcKeyboardID) const
 {
-    CALL_IN(QString("mcButtonID=%1")
-        .arg(CALL_SHOW(mcButtonID)));
+    CALL_IN(QString("mcKeyboardID=%1")
+        .arg(CALL_SHOW(mcKeyboardID)));
 
-    const bool exists = m_ButtonIDToInfo.contains(mcButtonID);
+    const bool exists = m_KeyboardIDToInfo.contains(mcKeyboardID);
 
     CALL_OUT("");
     return exists;
@@ -3326,25 +4610,24 @@ bool TelegramComms::DoesButtonInfoExist(const qint64 mcButtonID) const
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Buttons
-QHash < QString, QString > TelegramComms::GetButtonInfo(
-    const qint64 mcButtonID)
+// Keyboard
+KeyboardRecord TelegramComms::GetKeyboard(const qint64 mcKeyboardID) const
 {
-    CALL_IN(QString("mcButtonID=%1")
-        .arg(CALL_SHOW(mcButtonID)));
+    CALL_IN(QString("mcKeyboardID=%1")
+        .arg(CALL_SHOW(mcKeyboardID)));
 
-    // Check if we have this photo
-    if (!m_ButtonIDToInfo.contains(mcButtonID))
+    // Check if we have this keyboard
+    if (!m_KeyboardIDToInfo.contains(mcKeyboardID))
     {
-        const QString reason = tr("Button ID %1 does not exist")
-            .arg(mcButtonID);
+        const QString reason = tr("Keyboard ID %1 does not exist")
+            .arg(mcKeyboardID);
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
-        return QHash < QString, QString >();
+        return KeyboardRecord();
     }
 
     CALL_OUT("");
-    return m_ButtonIDToInfo[mcButtonID];
+    return m_KeyboardIDToInfo[mcKeyboardID];
 }
 
 
@@ -3358,7 +4641,7 @@ QHash < QString, QString > TelegramComms::GetButtonInfo(
 QHash < QString, QString > TelegramComms::Parse_StickerSet(
     const QJsonObject & mcrStickerSet)
 {
-    CALL_IN(QString("mcrStickerSet=%1")
+    CALL_IN_LAZY(QString("mcrStickerSet=%1")
         .arg(CALL_SHOW(mcrStickerSet)));
 
     // {
@@ -3372,13 +4655,20 @@ QHash < QString, QString > TelegramComms::Parse_StickerSet(
     //   ]
     // }
 
-    // Check if we have parsed this sticker set previously
+    // A sticker set we know already is only requested again to refresh it.
+    // Stickers we have already keep their previous file ID (file IDs of
+    // the same sticker differ between requests), so only new stickers will
+    // need to be downloaded.
     const QString name = mcrStickerSet["name"].toString();
-    if (m_StickerSetNameToInfo.contains(name))
+    QHash < QString, QString > unique_id_to_previous_file_id;
+    for (const QString & file_id : m_StickerSetNameToFileIDs.value(name))
     {
-        // Nothing to do here.
-        CALL_OUT("");
-        return m_StickerSetNameToInfo[name];
+        const QString unique_id =
+            m_FileIDToInfo.value(file_id).m_FileUniqueID;
+        if (!unique_id.isEmpty())
+        {
+            unique_id_to_previous_file_id[unique_id] = file_id;
+        }
     }
 
     // Loop contents
@@ -3409,15 +4699,19 @@ QHash < QString, QString > TelegramComms::Parse_StickerSet(
         if (key == "stickers")
         {
             QJsonArray all_stickers = mcrStickerSet[key].toArray();
+            ParsedEntities parsed;
+            QStringList file_ids;
             for (auto sticker_iterator = all_stickers.begin();
                  sticker_iterator != all_stickers.end();
                  sticker_iterator++)
             {
                 const QJsonObject & sticker = sticker_iterator -> toObject();
-                const QHash < QString, QString > sticker_info =
-                    Parse_File(sticker);
-                m_StickerSetNameToFileIDs[name] << sticker_info["id"];
+                const FileRecord sticker_file = Parse_File(sticker, parsed);
+                file_ids << unique_id_to_previous_file_id.value(
+                    sticker_file.m_FileUniqueID, sticker_file.m_ID);
             }
+            CommitParsedEntities(parsed);
+            m_StickerSetNameToFileIDs[name] = file_ids;
             continue;
         }
 
@@ -3452,9 +4746,6 @@ QHash < QString, QString > TelegramComms::Parse_StickerSet(
     // Let everybody know
     emit StickerSetInfoReceived(name);
 
-    // Done with this one...
-    m_StickerSetInfoBeingDownloaded.clear();
-
     CALL_OUT("");
     return stickerset_info;
 }
@@ -3566,24 +4857,196 @@ QStringList TelegramComms::GetStickerSetFileIDs(
         return QStringList();
     }
 
-    const QStringList & sticker_list =
-        m_StickerSetNameToFileIDs[mcrStickerSetName];
+    const QStringList & sticker_list =
+        m_StickerSetNameToFileIDs[mcrStickerSetName];
+
+    CALL_OUT("");
+    return sticker_list;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// What we know about the ZIP file of a sticker set
+QHash < QString, QString > TelegramComms::GetStickerSetZIPInfo(
+    const QString & mcrStickerSetName) const
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
+    // Nothing if we never made one
+    const QHash < QString, QString > zip_info =
+        m_StickerSetNameToZIPInfo.value(mcrStickerSetName);
+
+    CALL_OUT("");
+    return zip_info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Save what we know about the ZIP file of a sticker set
+bool TelegramComms::SetStickerSetZIPInfo(const QString & mcrStickerSetName,
+    const QHash < QString, QString > & mcrZIPInfo)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcrZIPInfo=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcrZIPInfo)));
+
+    QHash < QString, QString > zip_info = mcrZIPInfo;
+    zip_info["id"] = mcrStickerSetName;
+    m_StickerSetNameToZIPInfo[mcrStickerSetName] = zip_info;
+    const bool success =
+        SaveInfoData("sticker_set_zip_info", zip_info, "text");
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// What we know about rendered contact sheets
+QHash < QString, QString > TelegramComms::GetContactSheetInfo(
+    const QString & mcrKey) const
+{
+    CALL_IN(QString("mcrKey=%1")
+        .arg(CALL_SHOW(mcrKey)));
+
+    // Nothing if they were never rendered
+    const QHash < QString, QString > sheet_info =
+        m_ContactSheetKeyToInfo.value(mcrKey);
+
+    CALL_OUT("");
+    return sheet_info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Save what we know about rendered contact sheets
+bool TelegramComms::SetContactSheetInfo(const QString & mcrKey,
+    const QHash < QString, QString > & mcrSheetInfo)
+{
+    CALL_IN(QString("mcrKey=%1, mcrSheetInfo=%2")
+        .arg(CALL_SHOW(mcrKey),
+             CALL_SHOW(mcrSheetInfo)));
+
+    QHash < QString, QString > sheet_info = mcrSheetInfo;
+    sheet_info["id"] = mcrKey;
+    m_ContactSheetKeyToInfo[mcrKey] = sheet_info;
+    const bool success =
+        SaveInfoData("contact_sheet_info", sheet_info, "text");
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Download sticker set info
+void TelegramComms::DownloadStickerSetInfo(const QString & mcrStickerSetName,
+    const bool mcLowPriority)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcLowPriority=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcLowPriority)));
+
+    // Add to download queue (unless it's queued or being downloaded
+    // already). Low priority requests become regular ones if somebody
+    // asks again.
+    if (!m_StickerSetInfo_DownloadQueue.contains(mcrStickerSetName) &&
+        !m_StickerSetInfoBeingDownloaded.contains(mcrStickerSetName))
+    {
+        if (!mcLowPriority)
+        {
+            m_StickerSetInfo_LowPriorityQueue.removeAll(mcrStickerSetName);
+            m_StickerSetInfo_DownloadQueue << mcrStickerSetName;
+        } else if (!m_StickerSetInfo_LowPriorityQueue.contains(
+            mcrStickerSetName))
+        {
+            m_StickerSetInfo_LowPriorityQueue << mcrStickerSetName;
+        }
+    }
+
+    // No need to wait if there's room
+    StartStickerSetInfoDownloads();
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check for sticker set infos to be downloaded
+void TelegramComms::Periodic_DownloadStickerSetInfo()
+{
+    CALL_IN("");
+
+    StartStickerSetInfoDownloads();
+
+    // Try again in a bit
+    QTimer::singleShot(DOWNLOAD_DELAY,
+        this, &TelegramComms::Periodic_DownloadStickerSetInfo);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Start downloading sticker set infos (as many at the same time as we may)
+void TelegramComms::StartStickerSetInfoDownloads()
+{
+    CALL_IN("");
+
+    // Can't do anything without a token
+    if (m_Token.isEmpty())
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    while (m_StickerSetInfoBeingDownloaded.size() <
+            m_MaxStickerSetInfoDownloads &&
+        !m_StickerSetInfo_DownloadQueue.isEmpty())
+    {
+        RequestStickerSetInfo(m_StickerSetInfo_DownloadQueue.takeFirst());
+    }
+
+    // Low priority requests one at a time, and only if nothing else is
+    // going on
+    if (m_StickerSetInfoBeingDownloaded.isEmpty() &&
+        !m_StickerSetInfo_LowPriorityQueue.isEmpty())
+    {
+        RequestStickerSetInfo(m_StickerSetInfo_LowPriorityQueue.takeFirst());
+    }
 
     CALL_OUT("");
-    return sticker_list;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Download sticker set info
-void TelegramComms::DownloadStickerSetInfo(const QString & mcrStickerSetName)
+// Request a single sticker set info
+void TelegramComms::RequestStickerSetInfo(const QString & mcrStickerSetName)
 {
     CALL_IN(QString("mcrStickerSetName=%1")
         .arg(CALL_SHOW(mcrStickerSetName)));
 
-    // Add to download queue
-    m_StickerSetInfo_DownloadQueue << mcrStickerSetName;
+    // Build URL
+    QString url = QString("https://api.telegram.org/bot%1/getStickerSet?"
+        "name=%2")
+        .arg(m_Token,
+             mcrStickerSetName);
+    QNetworkRequest request;
+    request.setUrl(url);
+    QNetworkReply * reply = m_NetworkAccessManager -> get(request);
+
+    // Remember which set this reply is for
+    reply -> setProperty("sticker_set_name", mcrStickerSetName);
+    m_StickerSetInfoBeingDownloaded += mcrStickerSetName;
 
     CALL_OUT("");
 }
@@ -3591,48 +5054,20 @@ void TelegramComms::DownloadStickerSetInfo(const QString & mcrStickerSetName)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Check for sticker set infos to be downloaded
-void TelegramComms::Periodic_DownloadStickerSetInfo()
-{
-    CALL_IN("");
-
-    if (m_StickerSetInfoBeingDownloaded.isEmpty() &&
-        !m_StickerSetInfo_DownloadQueue.isEmpty())
-    {
-        // Build URL
-        const QString sticker_set_name =
-            m_StickerSetInfo_DownloadQueue.takeFirst();
-        QString url = QString("https://api.telegram.org/bot%1/getStickerSet?"
-            "name=%2")
-            .arg(m_Token,
-                 sticker_set_name);
-        QNetworkRequest request;
-        request.setUrl(url);
-        m_NetworkAccessManager -> get(request);
-
-        // Remember we're downloading this set
-        m_StickerSetInfoBeingDownloaded = sticker_set_name;
-    }
-
-    // Try again in a bit
-    QTimer::singleShot(DOWNLOAD_DELAY,
-        this, &TelegramComms::Periodic_DownloadStickerSetInfo);
-
-    CALL_OUT("");
-}
+// Sticker set info requests at the same time
+const int TelegramComms::m_MaxStickerSetInfoDownloads = 4;
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-void TelegramComms::Error_StickerSetInvalid()
+// Sticker set does not exist
+void TelegramComms::Error_StickerSetInvalid(const QString & mcrStickerSetName)
 {
-    CALL_IN("");
-
-    // Let the world know
-    emit StickerSetInfoFailed(m_StickerSetInfoBeingDownloaded);
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
 
-    // Done with this one
-    m_StickerSetInfoBeingDownloaded.clear();
+    // The world will know once we're done with the response
+    m_ResultStickerSetInvalid = true;
 
     CALL_OUT("");
 }
@@ -3641,10 +5076,10 @@ void TelegramComms::Error_StickerSetInvalid()
 
 ///////////////////////////////////////////////////////////////////////////////
 // Channel Post
-QHash < QString, QString > TelegramComms::Parse_ChannelPost(
-    const QJsonObject & mcrChannelPost)
+ChannelPostRecord TelegramComms::Parse_ChannelPost(
+    const QJsonObject & mcrChannelPost, ParsedEntities & mrParsed) const
 {
-    CALL_IN(QString("mcrChannelPost=%1")
+    CALL_IN_LAZY(QString("mcrChannelPost=%1")
         .arg(CALL_SHOW(mcrChannelPost)));
 
     // "channel_post":
@@ -3706,73 +5141,100 @@ QHash < QString, QString > TelegramComms::Parse_ChannelPost(
 
     // Parse the new message
 
+    // Known keys
+    enum Key
+    {
+        Key_Caption,
+        Key_CaptionEntities,
+        Key_Chat,
+        Key_Date,
+        Key_Document,
+        Key_Entities,
+        Key_MediaGroupId,
+        Key_MessageId,
+        Key_Photo,
+        Key_SenderChat,
+        Key_Text
+    };
+    static const QHash < QString, int > known_keys =
+    {
+        { "caption", Key_Caption },
+        { "caption_entities", Key_CaptionEntities },
+        { "chat", Key_Chat },
+        { "date", Key_Date },
+        { "document", Key_Document },
+        { "entities", Key_Entities },
+        { "media_group_id", Key_MediaGroupId },
+        { "message_id", Key_MessageId },
+        { "photo", Key_Photo },
+        { "sender_chat", Key_SenderChat },
+        { "text", Key_Text }
+    };
+
     // Loop contents
-    QHash < QString, QString > channel_post_info;
-    const QStringList all_keys = mcrChannelPost.keys();
-    for (const QString & key : all_keys)
+    ChannelPostRecord channel_post;
+    for (auto key_iterator = mcrChannelPost.constBegin();
+         key_iterator != mcrChannelPost.constEnd();
+         key_iterator++)
     {
-        if (key == "caption")
+        const QString key = key_iterator.key();
+        const QJsonValue value = key_iterator.value();
+        switch (known_keys.value(key, -1))
+        {
+        case Key_Caption:
         {
-            channel_post_info["caption"] = mcrChannelPost[key].toString();
+            channel_post.m_Caption = value.toString();
             continue;
         }
 
-        if (key == "caption_entities")
+        case Key_CaptionEntities:
         {
             // Ignored
             continue;
         }
 
-        if (key == "chat")
+        case Key_Chat:
         {
-            const QHash < QString, QString > chat_info =
-                Parse_Chat(mcrChannelPost["chat"].toObject());
-            channel_post_info["chat_id"] = chat_info["id"];
+            const ChatRecord chat = Parse_Chat(value.toObject(), mrParsed);
+            channel_post.m_ChatID = chat.m_ID;
             continue;
         }
 
-        if (key == "date")
+        case Key_Date:
         {
-            const QDateTime date =
-                QDateTime::fromSecsSinceEpoch(mcrChannelPost[key].toInt());
-            channel_post_info["date_time"] =
-                date.toString("yyyy-MM-dd hh:mm:ss");
+            channel_post.m_Date = value.toInteger();
             continue;
         }
 
-        if (key == "document")
+        case Key_Document:
         {
-            const QHash < QString, QString > file_info =
-                Parse_File(mcrChannelPost["document"].toObject());
-            channel_post_info["document_file_id"] = file_info["id"];
+            const FileRecord document = Parse_File(value.toObject(), mrParsed);
+            channel_post.m_DocumentFileID = document.m_ID;
             continue;
         }
 
-        if (key == "entities")
+        case Key_Entities:
         {
             // Ignored
             continue;
         }
 
-        if (key == "media_group_id")
+        case Key_MediaGroupId:
         {
-            channel_post_info["media_group_id"] =
-                mcrChannelPost[key].toString();
+            channel_post.m_Extras["media_group_id"] = value.toString();
             continue;
         }
 
-        if (key == "message_id")
+        case Key_MessageId:
         {
             // That's probably the message ID of the channel posting this...
-            const qint64 message_id = mcrChannelPost[key].toInteger();
-            channel_post_info["message_id"] = QString::number(message_id);
-            channel_post_info["id"] = QString::number(message_id);
+            channel_post.m_ID = value.toInteger();
             continue;
         }
 
-        if (key == "photo")
+        case Key_Photo:
         {
-            QJsonArray photos = mcrChannelPost[key].toArray();
+            QJsonArray photos = value.toArray();
             QJsonObject last_photo = photos.last().toObject();
             if (last_photo.isEmpty())
             {
@@ -3781,69 +5243,133 @@ QHash < QString, QString > TelegramComms::Parse_ChannelPost(
                     tr("photo array did not have a last entry.");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return ChannelPostRecord();
             }
-            const QHash < QString, QString > photo_info =
-                Parse_File(last_photo);
-            if (photo_info.isEmpty())
+            const FileRecord photo = Parse_File(last_photo, mrParsed);
+            if (photo.IsEmpty())
             {
                 const QString reason =
                     tr("Error parsing in photos list (photo)");
                 MessageLogger::Error(CALL_METHOD, reason);
                 CALL_OUT(reason);
-                return QHash < QString, QString >();
+                return ChannelPostRecord();
             }
-            channel_post_info["photo_file_id"] = photo_info["id"];
+            channel_post.m_PhotoFileID = photo.m_ID;
             continue;
         }
 
-        if (key == "sender_chat")
+        case Key_SenderChat:
         {
-            const QHash < QString, QString > chat_info =
-                Parse_Chat(mcrChannelPost["chat"].toObject());
-            channel_post_info["sender_chat_id"] = chat_info["id"];
+            const ChatRecord chat = Parse_Chat(value.toObject(), mrParsed);
+            channel_post.m_SenderChatID = chat.m_ID;
             continue;
         }
 
-        if (key == "text")
+        case Key_Text:
         {
-            channel_post_info["text"] = mcrChannelPost[key].toString();
+            channel_post.m_Text = value.toString();
             continue;
         }
 
-        // Unknown key
-        const QString message = tr("Unknown key \"%1\" in channel post set")
-            .arg(key);
-        MessageLogger::Error(CALL_METHOD, message);
+        default:
+        {
+            // Unknown key
+            const QString message =
+                tr("Unknown key \"%1\" in channel post set")
+                .arg(key);
+            MessageLogger::Error(CALL_METHOD, message);
+            continue;
+        }
+        }
     }
 
     // Save message info
-    if (!channel_post_info.contains("id"))
+    if (channel_post.IsEmpty())
     {
         const QString reason = tr("Channel Post Message is missing an ID");
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
+        return ChannelPostRecord();
+    }
+    mrParsed.m_ChannelPosts << channel_post;
+
+    CALL_OUT("");
+    return channel_post;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Check if channel post exists
+bool TelegramComms::DoesChannelPostExist(const qint64 mcMessageID) const
+{
+    CALL_IN(QString("mcMessageID=%1")
+        .arg(CALL_SHOW(mcMessageID)));
+
+    const bool exists = m_MessageIDToChannelPostInfo.contains(mcMessageID);
+
+    CALL_OUT("");
+    return exists;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Channel post
+QHash < QString, QString > TelegramComms::GetChannelPostInfo(
+    const qint64 mcMessageID)
+{
+    CALL_IN(QString("mcMessageID=%1")
+        .arg(CALL_SHOW(mcMessageID)));
+
+    // Check if we have this channel post
+    if (!m_MessageIDToChannelPostInfo.contains(mcMessageID))
+    {
+        const QString reason = tr("Channel post ID %1 does not exist")
+            .arg(QString::number(mcMessageID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
         return QHash < QString, QString >();
     }
-    m_MessageIDToChannelPostInfo[message_id] = channel_post_info;
-    SaveInfoData("channel_post_info", channel_post_info);
 
-    // Let everybody know
-    const qint64 chat_id = channel_post_info["chat_id"].toLongLong();
-    emit ChannelPostReceived(chat_id, message_id);
+    CALL_OUT("");
+    return m_MessageIDToChannelPostInfo[mcMessageID].ToHash();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Channel post (typed)
+ChannelPostRecord TelegramComms::GetChannelPostRecord(
+    const qint64 mcMessageID) const
+{
+    CALL_IN(QString("mcMessageID=%1")
+        .arg(CALL_SHOW(mcMessageID)));
+
+    // Check if we have this channel post
+    if (!m_MessageIDToChannelPostInfo.contains(mcMessageID))
+    {
+        const QString reason = tr("Channel post ID %1 does not exist")
+            .arg(QString::number(mcMessageID));
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return ChannelPostRecord();
+    }
 
     CALL_OUT("");
-    return channel_post_info;
+    return m_MessageIDToChannelPostInfo[mcMessageID];
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
 // Download file
-void TelegramComms::DownloadFile(const QString & mcrFileID)
+void TelegramComms::DownloadFile(const QString & mcrFileID,
+    const bool mcLowPriority)
 {
-    CALL_IN(QString("mcrFileID=%1")
-        .arg(CALL_SHOW(mcrFileID)));
+    CALL_IN(QString("mcrFileID=%1, mcLowPriority=%2")
+        .arg(CALL_SHOW(mcrFileID),
+             CALL_SHOW(mcLowPriority)));
 
     // Check if file already has been downloaded
     if (HasFileBeenDownloaded(mcrFileID))
@@ -3854,8 +5380,19 @@ void TelegramComms::DownloadFile(const QString & mcrFileID)
         return;
     }
 
-    // Add to download queue
-    m_DownloadQueue << mcrFileID;
+    // Add to download queue (low priority downloads become regular ones
+    // if somebody asks again)
+    if (m_DownloadQueue.contains(mcrFileID))
+    {
+        // Nothing to do.
+    } else if (!mcLowPriority)
+    {
+        m_LowPriorityDownloadQueue.removeAll(mcrFileID);
+        m_DownloadQueue << mcrFileID;
+    } else if (!m_LowPriorityDownloadQueue.contains(mcrFileID))
+    {
+        m_LowPriorityDownloadQueue << mcrFileID;
+    }
 
     CALL_OUT("");
 }
@@ -3883,10 +5420,39 @@ void TelegramComms::Periodic_DownloadFiles()
 {
     CALL_IN("");
 
-    if (!m_DownloadQueue.isEmpty())
+    // Low priority downloads only if there's nothing else to do
+    if (!StartFileDownload(m_DownloadQueue))
+    {
+        StartFileDownload(m_LowPriorityDownloadQueue);
+    }
+
+    // Try again in a bit
+    QTimer::singleShot(DOWNLOAD_DELAY,
+        this, &TelegramComms::Periodic_DownloadFiles);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Request next file from a download queue (returns if there was one)
+bool TelegramComms::StartFileDownload(QStringList & mrQueue)
+{
+    CALL_IN(QString("mrQueue=%1")
+        .arg(CALL_SHOW(mrQueue)));
+
+    while (!mrQueue.isEmpty())
     {
+        // Same file may have been downloaded in the meantime
+        const QString file_id = mrQueue.takeFirst();
+        if (HasFileBeenDownloaded(file_id))
+        {
+            emit FileDownloaded(file_id);
+            continue;
+        }
+
         // Build URL
-        const QString file_id = m_DownloadQueue.takeFirst();
         QString url = QString("https://api.telegram.org/bot%1/getFile?"
             "file_id=%2")
             .arg(m_Token,
@@ -3894,13 +5460,13 @@ void TelegramComms::Periodic_DownloadFiles()
         QNetworkRequest request;
         request.setUrl(url);
         m_NetworkAccessManager -> get(request);
-    }
 
-    // Try again in a bit
-    QTimer::singleShot(DOWNLOAD_DELAY,
-        this, &TelegramComms::Periodic_DownloadFiles);
+        CALL_OUT("");
+        return true;
+    }
 
     CALL_OUT("");
+    return false;
 }
 
 
@@ -3978,7 +5544,7 @@ bool TelegramComms::HasFileBeenDownloaded(const QString & mcrFileID)
     CALL_IN(QString("mcrFileID=%1")
         .arg(CALL_SHOW(mcrFileID)));
 
-    const QString filename = BOT_FILES + mcrFileID;
+    const QString filename = GetLocalFilename(mcrFileID);
     const bool downloaded = QFile::exists(filename);
 
     CALL_OUT("");
@@ -4003,7 +5569,7 @@ QByteArray TelegramComms::GetFile(const QString & mcrFileID)
         return QByteArray();
     }
 
-    const QString filename = BOT_FILES + mcrFileID;
+    const QString filename = GetLocalFilename(mcrFileID);
     QFile in_file(filename);
     in_file.open(QFile::ReadOnly);
     QByteArray data = in_file.readAll();
@@ -4015,6 +5581,52 @@ QByteArray TelegramComms::GetFile(const QString & mcrFileID)
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Unique ID of a file (same for the same file in different contexts; the
+// file ID itself if we don't know it)
+QString TelegramComms::GetFileUniqueID(const QString & mcrFileID) const
+{
+    CALL_IN(QString("mcrFileID=%1")
+        .arg(CALL_SHOW(mcrFileID)));
+
+    const QString unique_id =
+        m_FileIDToInfo.value(mcrFileID).m_FileUniqueID;
+
+    CALL_OUT("");
+    return (unique_id.isEmpty() ? mcrFileID : unique_id);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Where a downloaded file is stored
+QString TelegramComms::GetLocalFilename(const QString & mcrFileID) const
+{
+    CALL_IN(QString("mcrFileID=%1")
+        .arg(CALL_SHOW(mcrFileID)));
+
+    // Same file may have been downloaded with a different file ID
+    QString filename = BOT_FILES + mcrFileID;
+    if (!QFile::exists(filename))
+    {
+        const QStringList same_file_ids =
+            m_FileUniqueIDToFileIDs.value(GetFileUniqueID(mcrFileID));
+        for (const QString & file_id : same_file_ids)
+        {
+            if (QFile::exists(BOT_FILES + file_id))
+            {
+                filename = BOT_FILES + file_id;
+                break;
+            }
+        }
+    }
+
+    CALL_OUT("");
+    return filename;
+}
+
+
+
 // ====================================================== Sending to the Server
 
 
@@ -4049,23 +5661,18 @@ void TelegramComms::SetMyCommands(const QJsonObject & mcrAvailableCommands)
 ///////////////////////////////////////////////////////////////////////////////
 // Sending messages
 void TelegramComms::SendMessage(const qint64 mcChatID,
-    const QString & mcrMessage)
+    const QString & mcrMessage, const QString & mcrTag)
 {
-    CALL_IN(QString("mcChatID=%1, mcrMessage=%2")
+    CALL_IN(QString("mcChatID=%1, mcrMessage=%2, mcrTag=%3")
         .arg(CALL_SHOW(mcChatID),
-             CALL_SHOW(mcrMessage)));
+             CALL_SHOW(mcrMessage),
+             CALL_SHOW(mcrTag)));
 
     // Add chat to active ones
     m_ActiveChats += mcChatID;
 
     // Some necessary replacements
-    QString message = mcrMessage;
-    // "%" must be first
-    message.replace("%", "%25");
-    message.replace("\n", "%0A");
-    message.replace(" ", "%20");
-    message.replace("\"", "%22");
-    message.replace("&", "%26");
+    const QString message = EscapeMessageText(mcrMessage);
 
     QString url = QString("https://api.telegram.org/bot%1/sendMessage?"
         "parse_mode=html&"
@@ -4076,6 +5683,43 @@ void TelegramComms::SendMessage(const qint64 mcChatID,
              message);
     QNetworkRequest request;
     request.setUrl(url);
+    QNetworkReply * reply = m_NetworkAccessManager -> get(request);
+
+    // Remember what the message was for
+    if (!mcrTag.isEmpty())
+    {
+        reply -> setProperty("message_tag", mcrTag);
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Replace the text of a message we sent
+void TelegramComms::EditMessageText(const qint64 mcChatID,
+    const qint64 mcMessageID, const QString & mcrMessage)
+{
+    CALL_IN(QString("mcChatID=%1, mcMessageID=%2, mcrMessage=%3")
+        .arg(CALL_SHOW(mcChatID),
+             CALL_SHOW(mcMessageID),
+             CALL_SHOW(mcrMessage)));
+
+    // Some necessary replacements
+    const QString message = EscapeMessageText(mcrMessage);
+
+    QString url = QString("https://api.telegram.org/bot%1/editMessageText?"
+        "parse_mode=html&"
+        "chat_id=%2&"
+        "message_id=%3&"
+        "text=%4")
+        .arg(m_Token,
+             QString::number(mcChatID),
+             QString::number(mcMessageID),
+             message);
+    QNetworkRequest request;
+    request.setUrl(url);
     m_NetworkAccessManager -> get(request);
 
     CALL_OUT("");
@@ -4083,6 +5727,27 @@ void TelegramComms::SendMessage(const qint64 mcChatID,
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Message text as part of a URL
+QString TelegramComms::EscapeMessageText(const QString & mcrMessage)
+{
+    CALL_IN(QString("mcrMessage=%1")
+        .arg(CALL_SHOW(mcrMessage)));
+
+    QString message = mcrMessage;
+    // "%" must be first
+    message.replace("%", "%25");
+    message.replace("\n", "%0A");
+    message.replace(" ", "%20");
+    message.replace("\"", "%22");
+    message.replace("&", "%26");
+
+    CALL_OUT("");
+    return message;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Send broadcast messages
 void TelegramComms::SendBroadcastMessage(const QString & mcrMessage)
@@ -4117,14 +5782,7 @@ void TelegramComms::SendReply(const qint64 mcChatID, const qint64 mcMessageID,
     m_ActiveChats += mcChatID;
 
     // Some necessary replacements
-    QString message = mcrMessage;
-    // "%" must be first
-    message.replace("%", "%25");
-    message.replace("\n", "%0A");
-    message.replace(" ", "%20");
-    message.replace("\"", "%22");
-    message.replace("&", "%26");
-
+    const QString message = EscapeMessageText(mcrMessage);
 
     // Reply information
     QJsonObject reply_parameters_obj;
@@ -4156,11 +5814,12 @@ void TelegramComms::SendReply(const qint64 mcChatID, const qint64 mcMessageID,
 ///////////////////////////////////////////////////////////////////////////////
 // Upload a file to a chat
 bool TelegramComms::UploadFile(const qint64 mcChatID,
-    const QString & mcrFilename)
+    const QString & mcrFilename, const QString & mcrTag)
 {
-    CALL_IN(QString("mcrChatID=%1, mcrFilename=%2")
+    CALL_IN(QString("mcrChatID=%1, mcrFilename=%2, mcrTag=%3")
         .arg(CALL_SHOW(mcChatID),
-             CALL_SHOW(mcrFilename)));
+             CALL_SHOW(mcrFilename),
+             CALL_SHOW(mcrTag)));
 
     // Add chat to active ones
     m_ActiveChats += mcChatID;
@@ -4239,7 +5898,13 @@ bool TelegramComms::UploadFile(const qint64 mcChatID,
         .arg(boundary)
         .toLocal8Bit());
 
-    m_NetworkAccessManager -> post(request, payload);
+    QNetworkReply * reply = m_NetworkAccessManager -> post(request, payload);
+
+    // Remember what the upload was for
+    if (!mcrTag.isEmpty())
+    {
+        reply -> setProperty("message_tag", mcrTag);
+    }
 
     CALL_OUT("");
     return true;
@@ -4247,6 +5912,34 @@ bool TelegramComms::UploadFile(const qint64 mcChatID,
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Send a document that has been uploaded before
+void TelegramComms::SendDocument(const qint64 mcChatID,
+    const QString & mcrFileID)
+{
+    CALL_IN(QString("mcChatID=%1, mcrFileID=%2")
+        .arg(CALL_SHOW(mcChatID),
+             CALL_SHOW(mcrFileID)));
+
+    // Add chat to active ones
+    m_ActiveChats += mcChatID;
+
+    // Server knows the file already
+    QString url = QString("https://api.telegram.org/bot%1/sendDocument?"
+        "chat_id=%2&"
+        "document=%3")
+        .arg(m_Token,
+             QString::number(mcChatID),
+             EscapeMessageText(mcrFileID));
+    QNetworkRequest request;
+    request.setUrl(url);
+    m_NetworkAccessManager -> get(request);
+
+    CALL_OUT("");
+}
+
+
+
 // ====================================================================== Debug
 
 
@@ -4268,7 +5961,7 @@ void TelegramComms::Dump() const
         const qint64 key = *key_iterator;
         qDebug().noquote() << QString("%1: %2")
             .arg(QString::number(key),
-                 CALL_SHOW(m_UpdateIDToInfo[key]));
+                 CALL_SHOW(m_UpdateIDToInfo[key].ToHash()));
     }
 
     // == Messages
@@ -4282,7 +5975,7 @@ void TelegramComms::Dump() const
         const qint64 key = *key_iterator;
         qDebug().noquote() << QString("%1: %2")
             .arg(QString::number(key),
-                 CALL_SHOW(m_MessageIDToInfo[key]));
+                 CALL_SHOW(m_MessageIDToInfo[key].ToHash()));
     }
 
     // == Users
@@ -4296,7 +5989,7 @@ void TelegramComms::Dump() const
         const qint64 key = *key_iterator;
         qDebug().noquote() << QString("%1: %2")
             .arg(QString::number(key),
-                 CALL_SHOW(m_UserIDToInfo[key]));
+                 CALL_SHOW(m_UserIDToInfo[key].ToHash()));
     }
 
     // == Chats
@@ -4310,7 +6003,7 @@ void TelegramComms::Dump() const
         const qint64 key = *key_iterator;
         qDebug().noquote() << QString("%1: %2")
             .arg(QString::number(key),
-                 CALL_SHOW(m_ChatIDToInfo[key]));
+                 CALL_SHOW(m_ChatIDToInfo[key].ToHash()));
     }
 
     // == MyChatMembers
@@ -4324,7 +6017,7 @@ void TelegramComms::Dump() const
         const qint64 key = *key_iterator;
         qDebug().noquote() << QString("%1: %2")
             .arg(QString::number(key),
-                 CALL_SHOW(m_MyChatMemberIDToInfo[key]));
+                 CALL_SHOW(m_MyChatMemberIDToInfo[key].ToHash()));
     }
 
     // == Files
@@ -4338,26 +6031,12 @@ void TelegramComms::Dump() const
         const QString key = *key_iterator;
         qDebug().noquote() << QString("%1: %2")
             .arg(key,
-                 CALL_SHOW(m_FileIDToInfo[key]));
-    }
-
-    // == Button lists
-    qDebug().noquote() << "===== Button Lists";
-    all_keys = m_ButtonListIDToInfo.keys();
-    std::sort(all_keys.begin(), all_keys.end());
-    for (auto key_iterator = all_keys.constBegin();
-         key_iterator != all_keys.constEnd();
-         key_iterator++)
-    {
-        const qint64 key = *key_iterator;
-        qDebug().noquote() << QString("%1: %2")
-            .arg(QString::number(key),
-                 CALL_SHOW(m_ButtonListIDToInfo[key]));
+                 CALL_SHOW(m_FileIDToInfo[key].ToHash()));
     }
 
-    // == Buttons
-    qDebug().noquote() << "===== Buttons";
-    all_keys = m_ButtonIDToInfo.keys();
+    // == Keyboards
+    qDebug().noquote() << "===== Keyboards";
+    all_keys = m_KeyboardIDToInfo.keys();
     std::sort(all_keys.begin(), all_keys.end());
     for (auto key_iterator = all_keys.constBegin();
          key_iterator != all_keys.constEnd();
@@ -4366,7 +6045,7 @@ void TelegramComms::Dump() const
         const qint64 key = *key_iterator;
         qDebug().noquote() << QString("%1: %2")
             .arg(QString::number(key),
-                 CALL_SHOW(m_ButtonIDToInfo[key]));
+                 QString::fromUtf8(m_KeyboardIDToInfo[key].ToJson()));
     }
 
     CALL_OUT("");
@@ -12,8 +12,12 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QObject>
+#include <QSet>
 #include <QString>
 
+// Project includes
+#include "TelegramRecords.h"
+
 
 
 // Class definition
@@ -22,6 +26,11 @@ class TelegramComms
 {
     Q_OBJECT
 
+    // Benchmark, fuzzer and checks need access to the parsers
+    friend class ParserBenchmark;
+    friend class ParserFuzzer;
+    friend class StickerSetCheck;
+
 
 
     // ============================================================== Lifecycle
@@ -59,6 +68,8 @@ private:
     bool CreateDatabase_Table(const QString & mcrTableName,
         const QString & mcrIDType = "bigint");
     bool CreateDatabase_Table_StickerSet(const QString & mcrTableName);
+    bool CreateDatabase_Table_Keyboard();
+    bool CreateDatabase_Table_MessageEdit();
     bool CreateDatabase_Preferences();
 
     // Read database
@@ -67,7 +78,12 @@ private:
         QHash < qint64, QHash < QString, QString > > & mrInfoData);
     bool ReadDatabase_Table(const QString & mcrTableName,
         QHash < QString, QHash < QString, QString > > & mrInfoData);
+    template < typename Key, typename Record >
+    bool ReadDatabase_Records(const QString & mcrTableName,
+        QHash < Key, Record > & mrRecords);
     bool ReadDatabase_Table_StickerSet(const QString & mcrTableName);
+    bool ReadDatabase_Table_Keyboard();
+    bool ReadDatabase_Table_MessageEdit();
     bool ReadDatabase_Table_Preferences();
 
     // Save info data
@@ -76,10 +92,17 @@ private:
         const QString & mcrIDType = "bigint");
     bool SaveInfoData_StickerSet(const QString & mcrTableName,
         const QString & mcrStickerSetID);
+    bool SaveKeyboard(const KeyboardRecord & mcrKeyboard);
+    bool SaveMessageEdit(const MessageRecord & mcrOldMessage,
+        const MessageRecord & mcrNewMessage);
 
 public:
     // Update database
     void UpdateDatabase();
+private:
+    // Move inline keyboards from button_list_info and button_info to
+    // keyboard_info (and messages from button_list_id to keyboard_id)
+    bool UpdateDatabase_Keyboards();
 
 
 
@@ -146,89 +169,108 @@ private slots:
     // Handle response
     bool HandleResponse(QNetworkReply * mpResponse);
 private:
+    bool ProcessResponse(QNetworkReply * mpResponse,
+        const QString & mcrStickerSetName);
     QNetworkAccessManager * m_NetworkAccessManager;
 
 private:
-    // Original server response
-    bool Parse_Response(const QJsonObject & mcrResponse);
+    // Remove updates we have already seen from a getUpdates response
+    QByteArray SkipKnownUpdates(const QByteArray & mcrContent);
+
+private:
+    // Original server response (and the sticker set it is for, if any)
+    bool Parse_Response(const QJsonObject & mcrResponse,
+        const QString & mcrStickerSetName = QString());
+
+    // Parse_...() functions only collect what they find (and may run in
+    // parallel); this saves it and sends the signals
+    void CommitParsedEntities(const ParsedEntities & mcrParsed);
 
 private:
     // Updates
     bool Parse_UpdateArray(const QJsonArray & mcrUpdates);
-    QHash < QString, QString > Parse_Update(const QJsonObject & mcrUpdate);
-    QHash < qint64, QHash < QString, QString > > m_UpdateIDToInfo;
+    UpdateRecord Parse_Update(const QJsonObject & mcrUpdate,
+        ParsedEntities & mrParsed) const;
+    QHash < qint64, UpdateRecord > m_UpdateIDToInfo;
 public:
     bool DoesUpdateInfoExist(const qint64 mcUpdateID) const;
     QHash < QString, QString > GetUpdateInfo(const qint64 mcUpdateID);
+    UpdateRecord GetUpdateRecord(const qint64 mcUpdateID) const;
 signals:
     void UpdateReceived(const qint64 mcrChatID, const qint64 mcrUpdateID);
 
 private:
     // Message
-    QHash < QString, QString > Parse_Message(const QJsonObject & mcrMessage);
-    QHash < qint64, QHash < QString, QString > > m_MessageIDToInfo;
+    MessageRecord Parse_Message(const QJsonObject & mcrMessage,
+        ParsedEntities & mrParsed, const bool mcIsEdit = false) const;
+    QHash < qint64, MessageRecord > m_MessageIDToInfo;
+    QHash < qint64, int > m_MessageIDToVersion;
 public:
     bool DoesMessageInfoExist(const qint64 mcMessageID) const;
     QHash < QString, QString > GetMessageInfo(const qint64 mcMessageID);
+    MessageRecord GetMessageRecord(const qint64 mcMessageID) const;
 signals:
     void MessageReceived(const qint64 mcrChatID, const qint64 mcrMessageID);
 
 private:
     // User
-    QHash < QString, QString > Parse_User(const QJsonObject & mcrUser);
-    QHash < qint64, QHash < QString, QString > > m_UserIDToInfo;
+    UserRecord Parse_User(const QJsonObject & mcrUser,
+        ParsedEntities & mrParsed) const;
+    QHash < qint64, UserRecord > m_UserIDToInfo;
 public:
     bool DoesUserInfoExist(const qint64 mcUserID) const;
     QHash < QString, QString > GetUserInfo(const qint64 mcUserID);
+    UserRecord GetUserRecord(const qint64 mcUserID) const;
 
 private:
     // Chat
-    QHash < QString, QString > Parse_Chat(const QJsonObject & mcrChat);
-    QHash < qint64, QHash < QString, QString > > m_ChatIDToInfo;
+    ChatRecord Parse_Chat(const QJsonObject & mcrChat,
+        ParsedEntities & mrParsed) const;
+    QHash < qint64, ChatRecord > m_ChatIDToInfo;
 public:
     bool DoesChatInfoExist(const qint64 mcChatID) const;
     QHash < QString, QString > GetChatInfo(const qint64 mcChatID);
+    ChatRecord GetChatRecord(const qint64 mcChatID) const;
 
 private:
     // MyChatMember
-    QHash < QString, QString > Parse_MyChatMember(
-        const QJsonObject & mcrMyChatMember);
+    MyChatMemberRecord Parse_MyChatMember(
+        const QJsonObject & mcrMyChatMember, ParsedEntities & mrParsed) const;
     QHash < QString, QString > Parse_MyChatMember_OldChatMember(
-        const QJsonObject & mcrOldChatMember);
+        const QJsonObject & mcrOldChatMember,
+        ParsedEntities & mrParsed) const;
     QHash < QString, QString > Parse_MyChatMember_NewChatMember(
-        const QJsonObject & mcrNewChatMember);
-    QHash < qint64, QHash < QString, QString > > m_MyChatMemberIDToInfo;
+        const QJsonObject & mcrNewChatMember,
+        ParsedEntities & mrParsed) const;
+    QHash < qint64, MyChatMemberRecord > m_MyChatMemberIDToInfo;
 public:
     bool DoesMyChatMemberInfoExist(const qint64 mcMyChatMemberID) const;
     QHash < QString, QString > GetMyChatMemberInfo(
         const qint64 mcMyChatMemberID);
+    MyChatMemberRecord GetMyChatMemberRecord(
+        const qint64 mcMyChatMemberID) const;
 
 private:
     // File
-    QHash < QString, QString > Parse_File(const QJsonObject & mcrFile);
-    QHash < QString, QHash < QString, QString > > m_FileIDToInfo;
+    FileRecord Parse_File(const QJsonObject & mcrFile,
+        ParsedEntities & mrParsed) const;
+    QHash < QString, FileRecord > m_FileIDToInfo;
+    QHash < QString, QStringList > m_FileUniqueIDToFileIDs;
 public:
     bool DoesFileInfoExist(const QString & mcrFileID) const;
     QHash < QString, QString > GetFileInfo(const QString & mcrFileID);
+    FileRecord GetFileRecord(const QString & mcrFileID) const;
+    QString GetFileUniqueID(const QString & mcrFileID) const;
 
 private:
-    // Button List
-    QHash < QString, QString > Parse_ButtonList(
-        const QJsonObject & mcrButtonList);
-    qint64 m_NextButtonListID;
-    QHash < qint64, QHash < QString, QString > > m_ButtonListIDToInfo;
+    // Keyboard (reply_markup)
+    KeyboardRecord Parse_Keyboard(const QJsonObject & mcrReplyMarkup) const;
+    qint64 m_NextKeyboardID;
+    QHash < qint64, KeyboardRecord > m_KeyboardIDToInfo;
+    QHash < QString, qint64 > m_KeyboardHashToID;
 public:
-    bool DoesButtonListInfoExist(const qint64 mcButtonListID) const;
-    QHash < QString, QString > GetButtonList(const qint64 mcButtonListID);
-
-private:
-    // Button
-    QHash < QString, QString > Parse_Button(const QJsonObject & mcrButton);
-    qint64 m_NextButtonID;
-    QHash < qint64, QHash < QString, QString > > m_ButtonIDToInfo;
-public:
-    bool DoesButtonInfoExist(const qint64 mcButtonID) const;
-    QHash < QString, QString > GetButtonInfo(const qint64 mcButtonID);
+    bool DoesKeyboardExist(const qint64 mcKeyboardID) const;
+    KeyboardRecord GetKeyboard(const qint64 mcKeyboardID) const;
 
 
 
@@ -246,27 +288,60 @@ public:
         const QString & mcrStickerSetName) const;
     QStringList GetStickerSetFileIDs(const QString & mcrStickerSetName) const;
 
-    void DownloadStickerSetInfo(const QString & mcrStickerSetName);
+    // What we know about the ZIP file of a sticker set (its version and,
+    // once uploaded, its document file ID)
+    QHash < QString, QString > GetStickerSetZIPInfo(
+        const QString & mcrStickerSetName) const;
+    bool SetStickerSetZIPInfo(const QString & mcrStickerSetName,
+        const QHash < QString, QString > & mcrZIPInfo);
+private:
+    QHash < QString, QHash < QString, QString > > m_StickerSetNameToZIPInfo;
+public:
+
+    // What we know about rendered contact sheets (by job key: number of
+    // sheets and, once uploaded, their document file IDs)
+    QHash < QString, QString > GetContactSheetInfo(const QString & mcrKey)
+        const;
+    bool SetContactSheetInfo(const QString & mcrKey,
+        const QHash < QString, QString > & mcrSheetInfo);
+private:
+    QHash < QString, QHash < QString, QString > > m_ContactSheetKeyToInfo;
+public:
+
+    // (low priority requests only use what other requests leave over)
+    void DownloadStickerSetInfo(const QString & mcrStickerSetName,
+        const bool mcLowPriority = false);
 private slots:
     void Periodic_DownloadStickerSetInfo();
+private:
+    void StartStickerSetInfoDownloads();
+    void RequestStickerSetInfo(const QString & mcrStickerSetName);
 private:
     QStringList m_StickerSetInfo_DownloadQueue;
-    QString m_StickerSetInfoBeingDownloaded;
-    void Error_StickerSetInvalid();
+    QStringList m_StickerSetInfo_LowPriorityQueue;
+    QSet < QString > m_StickerSetInfoBeingDownloaded;
+    static const int m_MaxStickerSetInfoDownloads;
+    void Error_StickerSetInvalid(const QString & mcrStickerSetName);
+    // Set if the server said the sticker set we asked for doesn't exist
+    bool m_ResultStickerSetInvalid;
 signals:
-    void StickerSetInfoFailed(const QString & mcrStickerSetName);
+    // Sticker set info could not be downloaded (mcDoesNotExist if there
+    // is no such sticker set; otherwise, asking again later may work)
+    void StickerSetInfoFailed(const QString & mcrStickerSetName,
+        const bool mcDoesNotExist);
     void StickerSetInfoReceived(const QString & mcrStickerSetName);
 
 
 
 private:
     // =========================================================== Channel Post
-    QHash < QString, QString > Parse_ChannelPost(
-        const QJsonObject & mcrChannelPost);
-    QHash < qint64, QHash < QString, QString > > m_MessageIDToChannelPostInfo;
+    ChannelPostRecord Parse_ChannelPost(
+        const QJsonObject & mcrChannelPost, ParsedEntities & mrParsed) const;
+    QHash < qint64, ChannelPostRecord > m_MessageIDToChannelPostInfo;
 public:
     bool DoesChannelPostExist(const qint64 mcMessageID) const;
-    QHash < QString, QString > GetChannelPostInfo(const qint64 mcMessgeID);
+    QHash < QString, QString > GetChannelPostInfo(const qint64 mcMessageID);
+    ChannelPostRecord GetChannelPostRecord(const qint64 mcMessageID) const;
 signals:
     void ChannelPostReceived(const qint64 mcrChatID,
         const qint64 mcrMessageID);
@@ -275,8 +350,10 @@ signals:
 
     // ========================================================= File Downloads
 public:
-    // Download file
-    void DownloadFile(const QString & mcrFileID);
+    // Download file (low priority downloads only use what other downloads
+    // leave over)
+    void DownloadFile(const QString & mcrFileID,
+        const bool mcLowPriority = false);
 
     // Download worklist size
     int GetDownloadWorkListSize() const;
@@ -284,6 +361,8 @@ private slots:
     void Periodic_DownloadFiles();
 private:
     QStringList m_DownloadQueue;
+    QStringList m_LowPriorityDownloadQueue;
+    bool StartFileDownload(QStringList & mrQueue);
 
     bool Download_FilePath(const QString & mcrFileID,
         const QString & mcrFilePath);
@@ -291,6 +370,7 @@ private:
 public:
     bool HasFileBeenDownloaded(const QString & mcrFileID);
     QByteArray GetFile(const QString & mcrFileID);
+    QString GetLocalFilename(const QString & mcrFileID) const;
 signals:
     void FileDownloaded(const QString & mcrFileID);
 
@@ -304,21 +384,42 @@ public:
     // Setting available commands
     void SetMyCommands(const QJsonObject & mcrAvailableCommands);
 
-    // Sending messages
-    void SendMessage(const qint64 mcChatID, const QString & mcrMessage);
+    // Sending messages (tagged messages are reported by MessageSent() once
+    // the server has them, e.g. to edit them later)
+    void SendMessage(const qint64 mcChatID, const QString & mcrMessage,
+        const QString & mcrTag = QString());
+signals:
+    void MessageSent(const QString & mcrTag, const qint64 mcChatID,
+        const qint64 mcMessageID);
+private:
+    // Message the server returned as the result of a request
+    MessageRecord m_ResultMessage;
+
+public:
+    // Replace the text of a message we sent
+    void EditMessageText(const qint64 mcChatID, const qint64 mcMessageID,
+        const QString & mcrMessage);
 
     // Sending messages to all active chats
     void SendBroadcastMessage(const QString & mcrMessage);
 private:
     QSet < qint64 > m_ActiveChats;
 
+    // Message text as part of a URL
+    static QString EscapeMessageText(const QString & mcrMessage);
+
 public:
     // Sending reply
     void SendReply(const qint64 mcChatID, const qint64 mcMessageID,
         const QString & mcrMessage);
 
-    // Upload a file to a chat
-    bool UploadFile(const qint64 mcChatID, const QString & mcrFilename);
+    // Upload a file to a chat (tagged uploads are reported by
+    // MessageSent(), like tagged messages)
+    bool UploadFile(const qint64 mcChatID, const QString & mcrFilename,
+        const QString & mcrTag = QString());
+
+    // Send a document that has been uploaded before
+    void SendDocument(const qint64 mcChatID, const QString & mcrFileID);
 
 
 
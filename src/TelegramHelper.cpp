@@ -23,12 +23,17 @@
 #include "CallTracer.h"
 #include "Config.h"
 #include "MessageLogger.h"
+#include "StickerTranscoder.h"
 #include "TelegramComms.h"
 #include "TelegramHelper.h"
+#include "ZIPWriter.h"
 
 // Qt includes
+#include <QCryptographicHash>
+#include <QDebug>
 #include <QDir>
-#include <QProcess>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 
 
 
@@ -61,6 +66,16 @@ TelegramHelper::TelegramHelper()
         this, SLOT(Server_FileDownloaded(const QString &)));
     connect (tc, SIGNAL(StickerSetInfoReceived(const QString &)),
         this, SLOT(Server_StickerSetInfoReceived(const QString &)));
+    connect (tc, SIGNAL(StickerSetInfoFailed(const QString &, const bool)),
+        this, SLOT(Server_StickerSetInfoFailed(const QString &,
+            const bool)));
+    connect (tc, SIGNAL(MessageSent(const QString &, const qint64,
+            const qint64)),
+        this, SLOT(Server_MessageSent(const QString &, const qint64,
+            const qint64)));
+    StickerTranscoder * st = StickerTranscoder::Instance();
+    connect (st, SIGNAL(FileTranscoded(const QString &, const bool)),
+        this, SLOT(Transcoder_FileTranscoded(const QString &, const bool)));
 
     CALL_OUT("");
 }
@@ -124,20 +139,30 @@ void TelegramHelper::Server_MessageReceieved(const qint64 mcChatID,
 
     // Get message info
     TelegramComms * tc = TelegramComms::Instance();
-    const QHash < QString, QString > message_info =
-        tc -> GetMessageInfo(mcMessageID);
-    const qint64 user_id = message_info["from_id"].toLongLong();
-    const QString text = message_info["text"];
+    const MessageRecord message = tc -> GetMessageRecord(mcMessageID);
+    const qint64 user_id = message.m_FromID;
+    const QString text = message.m_Text;
 
     // Check if the message is from the bot
-    const QHash < QString, QString > user_info = tc -> GetUserInfo(user_id);
-    if (user_info["is_bot"] == "true")
+    const UserRecord user = tc -> GetUserRecord(user_id);
+    if (user.m_IsBot)
     {
         // Nothing to do here.
         CALL_OUT("");
         return;
     }
 
+    // Stickers tell us which sticker set they're from; get that set in the
+    // background, so it's ready if somebody asks for it
+    if (!message.m_StickerID.isEmpty())
+    {
+        const FileRecord sticker = tc -> GetFileRecord(message.m_StickerID);
+        if (!sticker.m_SetName.isEmpty())
+        {
+            PrefetchStickerSet(sticker.m_SetName);
+        }
+    }
+
     // Check if it's a command
     static const QRegularExpression format_command(
         "^/([a-zA-Z0-9_]+)(@([a-zA-Z0-9_]+))?( (.*))?$");
@@ -174,7 +199,7 @@ void TelegramHelper::Server_MessageReceieved(const qint64 mcChatID,
     // When a command is issued by forwarding a message, Telegram creates
     // two messages: One with the command, the other with the forwarded
     // message. We call this second message "separate parameter"
-    if (message_info.contains("forward_date_time"))
+    if (message.m_ForwardDate != 0)
     {
         // Check if we have been expecting this
         if (m_UserIDToSeparateMessageID.contains(user_id) &&
@@ -288,10 +313,26 @@ void TelegramHelper::Server_FileDownloaded(const QString & mcrFileID)
     // Let everybody know
     emit FileDownloaded(mcrFileID);
 
+    // Convert sticker right away if a sticker set wants that
+    TelegramComms * tc = TelegramComms::Instance();
+    const QString unique_id = tc -> GetFileUniqueID(mcrFileID);
+    for (auto set_iterator = m_StickerSetToRemainingConversions.constBegin();
+         set_iterator != m_StickerSetToRemainingConversions.constEnd();
+         set_iterator++)
+    {
+        if (set_iterator.value().contains(unique_id))
+        {
+            // Conversion detaches
+            StickerTranscoder * st = StickerTranscoder::Instance();
+            st -> Transcode(mcrFileID);
+            break;
+        }
+    }
+
     // Check for sticker file processing
-    if (m_FileIDToStickerSetNames.contains(mcrFileID))
+    if (m_FileUniqueIDToStickerSetNames.contains(unique_id))
     {
-        StickerFileReceived(mcrFileID);
+        StickerFileReceived(unique_id);
     }
 
     CALL_OUT("");
@@ -311,8 +352,10 @@ bool TelegramHelper::IsStickerSetBeingDownloaded(
     CALL_IN(QString("mcrStickerSetName=%1")
         .arg(CALL_SHOW(mcrStickerSetName)));
 
+    // (Prefetching doesn't count; somebody asking will speed it up)
     const bool is_being_downloaded =
-        m_StickerSetIsDownloading.contains(mcrStickerSetName);
+        m_StickerSetIsDownloading.contains(mcrStickerSetName) &&
+        !m_StickerSetIsPrefetching.contains(mcrStickerSetName);
 
     CALL_OUT("");
     return is_being_downloaded;
@@ -320,10 +363,120 @@ bool TelegramHelper::IsStickerSetBeingDownloaded(
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Check if we're prefetching a particular sticker set
+bool TelegramHelper::IsStickerSetBeingPrefetched(
+    const QString & mcrStickerSetName) const
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
+    const bool is_being_prefetched =
+        m_StickerSetIsPrefetching.contains(mcrStickerSetName);
+
+    CALL_OUT("");
+    return is_being_prefetched;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Download an entire sticker set
 void TelegramHelper::DownloadStickerSet(const QString & mcrStickerSetName,
-    const bool mcForce)
+    const bool mcForce, const bool mcConvert)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcForce=%2, mcConvert=%3")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcForce),
+             CALL_SHOW(mcConvert)));
+
+    // Somebody wants a sticker set we've been prefetching
+    if (m_StickerSetIsPrefetching.contains(mcrStickerSetName))
+    {
+        PromoteStickerSetPrefetch(mcrStickerSetName);
+    }
+
+    // Converted stickers as well
+    if (mcConvert)
+    {
+        m_StickerSetIsConverting += mcrStickerSetName;
+    }
+
+    ContinueStickerSetDownload(mcrStickerSetName, mcForce);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Download a sticker set in the background
+void TelegramHelper::PrefetchStickerSet(const QString & mcrStickerSetName)
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
+    // Check if we have it already (or are getting it, or know there's no
+    // such set)
+    TelegramComms * tc = TelegramComms::Instance();
+    if (m_StickerSetIsDownloading.contains(mcrStickerSetName) ||
+        m_StickerSetDoesNotExist.contains(mcrStickerSetName) ||
+        (tc -> DoesStickerSetInfoExist(mcrStickerSetName) &&
+         DoesStickerSetZIPFileExist(mcrStickerSetName)))
+    {
+        // Nothing to do here.
+        CALL_OUT("");
+        return;
+    }
+
+    m_StickerSetIsPrefetching += mcrStickerSetName;
+    ContinueStickerSetDownload(mcrStickerSetName);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Prefetched sticker set is needed now
+void TelegramHelper::PromoteStickerSetPrefetch(
+    const QString & mcrStickerSetName)
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
+    m_StickerSetIsPrefetching -= mcrStickerSetName;
+
+    // Ask again for whatever is still missing (as regular requests)
+    TelegramComms * tc = TelegramComms::Instance();
+    if (!tc -> DoesStickerSetInfoExist(mcrStickerSetName))
+    {
+        tc -> DownloadStickerSetInfo(mcrStickerSetName);
+        CALL_OUT("");
+        return;
+    }
+    const QSet < QString > remaining_unique_ids =
+        m_StickerSetToRemainingUniqueIDs.value(mcrStickerSetName);
+    const QStringList sticker_file_ids =
+        tc -> GetStickerSetFileIDs(mcrStickerSetName);
+    for (const QString & sticker_file_id : sticker_file_ids)
+    {
+        if (remaining_unique_ids.contains(
+            tc -> GetFileUniqueID(sticker_file_id)))
+        {
+            tc -> DownloadFile(sticker_file_id);
+        }
+    }
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Next step of downloading a sticker set
+void TelegramHelper::ContinueStickerSetDownload(
+    const QString & mcrStickerSetName, const bool mcForce)
 {
     CALL_IN(QString("mcrStickerSetName=%1, mcForce=%2")
         .arg(CALL_SHOW(mcrStickerSetName),
@@ -331,37 +484,63 @@ void TelegramHelper::DownloadStickerSet(const QString & mcrStickerSetName,
 
     // (1) Add flag that we're downloading this sticker set, so the other
     //     methods receiving updates know to go here.
-    //     Remove existing sticker set info if we force reload
+    //     Get current sticker set info if we force reload
     //
     // (2) If no sticker set info is available for this sticker set, get it.
     //     This will also generate file infos for all stickers
     //
     // Loop sticker files:
-    // (3) If file has not been downloaded, obtain it.
+    // (3) If file has not been downloaded, obtain it. If converted
+    //     stickers are wanted, convert each one as soon as it's there.
     //
-    // (4) If the sticker set ZIP file does not exist, create it
+    // (4) If the sticker set ZIP file does not exist (or the sticker set
+    //     has been reloaded), create it. Same for the ZIP file with
+    //     converted stickers, once they're all converted.
     //
     // (5) Remove download flag & let outside world know sticker set zip
     //     file is now available.
 
+    // Prefetching only uses what other downloads leave over
+    const bool low_priority =
+        m_StickerSetIsPrefetching.contains(mcrStickerSetName);
+
     // (1) Add flag that we're downloading this sticker set, so the other
     //     methods receiving updates know to go here.
     TelegramComms * tc = TelegramComms::Instance();
     if (!m_StickerSetIsDownloading.contains(mcrStickerSetName))
     {
         m_StickerSetIsDownloading += mcrStickerSetName;
-        if (mcForce)
+        if (mcForce &&
+            tc -> DoesStickerSetInfoExist(mcrStickerSetName))
         {
-            tc -> RemoveStickerSetInfo(mcrStickerSetName);
+            // Only stickers that are new will be downloaded; the others
+            // are taken from the existing ZIP file
+            m_StickerSetToPreviousFileIDs[mcrStickerSetName] =
+                tc -> GetStickerSetFileIDs(mcrStickerSetName);
+            m_StickerSetToRemainingUniqueIDs.remove(mcrStickerSetName);
+            m_StickerSetToRemainingConversions.remove(mcrStickerSetName);
+            m_StickerSetToProgress.remove(mcrStickerSetName);
+            m_StickerSetIsRefreshing += mcrStickerSetName;
+
+            // Download detaches
+            tc -> DownloadStickerSetInfo(mcrStickerSetName);
+            CALL_OUT("");
+            return;
         }
     }
 
     // (2) If no sticker set info is available for this sticker set, get it.
     //     This will also generate file infos for all stickers
+    if (m_StickerSetIsRefreshing.contains(mcrStickerSetName))
+    {
+        // Still waiting for the current sticker set info
+        CALL_OUT("");
+        return;
+    }
     if (!tc -> DoesStickerSetInfoExist(mcrStickerSetName))
     {
         // Download detaches
-        tc -> DownloadStickerSetInfo(mcrStickerSetName);
+        tc -> DownloadStickerSetInfo(mcrStickerSetName, low_priority);
         CALL_OUT("");
         return;
     }
@@ -369,37 +548,155 @@ void TelegramHelper::DownloadStickerSet(const QString & mcrStickerSetName,
     // Loop sticker files:
     const QStringList sticker_file_ids =
         tc -> GetStickerSetFileIDs(mcrStickerSetName);
-    if (!m_StickerSetToRemainingFileIDs.contains(mcrStickerSetName))
+
+    // (3) Convert stickers that are there already; the others are
+    //     converted when they arrive
+    if (m_StickerSetIsConverting.contains(mcrStickerSetName) &&
+        !m_StickerSetToRemainingConversions.contains(mcrStickerSetName) &&
+        !DoesStickerSetZIPFileExist(mcrStickerSetName, true))
+    {
+        StickerTranscoder * st = StickerTranscoder::Instance();
+        m_StickerSetToRemainingConversions[mcrStickerSetName] =
+            QSet < QString >();
+        QStringList downloaded_file_ids;
+        for (const QString & sticker_file_id : sticker_file_ids)
+        {
+            if (st -> IsTranscoded(sticker_file_id) ||
+                tc -> GetFileRecord(sticker_file_id).m_IsVideo)
+            {
+                continue;
+            }
+            m_StickerSetToRemainingConversions[mcrStickerSetName]
+                << tc -> GetFileUniqueID(sticker_file_id);
+            if (tc -> HasFileBeenDownloaded(sticker_file_id))
+            {
+                downloaded_file_ids << sticker_file_id;
+            }
+        }
+        for (const QString & sticker_file_id : downloaded_file_ids)
+        {
+            // Conversion detaches
+            st -> Transcode(sticker_file_id);
+        }
+    }
+    if (!m_StickerSetToRemainingUniqueIDs.contains(mcrStickerSetName))
     {
-        m_StickerSetToRemainingFileIDs[mcrStickerSetName] = QSet < QString >();
+        m_StickerSetToRemainingUniqueIDs[mcrStickerSetName] =
+            QSet < QString >();
+        StickerSetProgress progress;
         for (const QString & sticker_file_id : sticker_file_ids)
         {
+            const qint64 file_size =
+                tc -> GetFileRecord(sticker_file_id).m_FileSize;
+            progress.m_FilesTotal++;
+            progress.m_BytesTotal += file_size;
+
             // (3) If file has not been downloaded, obtain it
-            // DownloadFile() will determine if file needs to be downloaded
-            m_StickerSetToRemainingFileIDs[mcrStickerSetName]
-                << sticker_file_id;
-            m_FileIDToStickerSetNames[sticker_file_id]
+            if (tc -> HasFileBeenDownloaded(sticker_file_id))
+            {
+                progress.m_FilesDone++;
+                progress.m_BytesDone += file_size;
+                continue;
+            }
+            const QString unique_id = tc -> GetFileUniqueID(sticker_file_id);
+            m_StickerSetToRemainingUniqueIDs[mcrStickerSetName]
+                << unique_id;
+            m_FileUniqueIDToSize[unique_id] = file_size;
+
+            // Sticker may be on its way for another set already (but
+            // maybe only as a low priority download)
+            const bool is_being_downloaded =
+                m_FileUniqueIDToStickerSetNames.contains(unique_id);
+            m_FileUniqueIDToStickerSetNames[unique_id]
                 += mcrStickerSetName;
-
-            // Download detaches
-            tc -> DownloadFile(sticker_file_id);
+            if (!is_being_downloaded ||
+                !low_priority)
+            {
+                // Download detaches
+                tc -> DownloadFile(sticker_file_id, low_priority);
+            }
         }
-        if (!m_StickerSetToRemainingFileIDs[mcrStickerSetName].isEmpty())
+
+        // Keep track of progress
+        progress.m_FilesAtStart = progress.m_FilesDone;
+        progress.m_BytesAtStart = progress.m_BytesDone;
+        progress.m_Timer.start();
+        m_StickerSetToProgress[mcrStickerSetName] = progress;
+        if (!m_StickerSetToRemainingUniqueIDs[mcrStickerSetName].isEmpty())
         {
-            CALL_OUT("");
-            return;
+            emit StickerSetProgressChanged(mcrStickerSetName);
         }
     }
+    if (!m_StickerSetToRemainingUniqueIDs.value(mcrStickerSetName)
+        .isEmpty())
+    {
+        // Still downloading (e.g. a prefetch somebody asked for)
+        CALL_OUT("");
+        return;
+    }
+    if (!m_StickerSetToRemainingConversions.value(mcrStickerSetName)
+        .isEmpty())
+    {
+        // Still converting
+        CALL_OUT("");
+        return;
+    }
 
-    // (4) If the sticker set ZIP file does not exist, create it
-    if (!DoesStickerSetZIPFileExist(mcrStickerSetName))
+    // (4) If the sticker set ZIP file does not exist (or the sticker set
+    //     has been reloaded), create it (on the thread pool; we continue
+    //     with (5) once that's done)
+    if (m_StickerSetIsSavingZIPFiles.contains(mcrStickerSetName))
     {
-        SaveStickerSetZIPFile(mcrStickerSetName);
+        CALL_OUT("");
+        return;
+    }
+    QList < StickerSetZIPJob > zip_jobs;
+    StickerSetZIPJob zip_job;
+    if ((!DoesStickerSetZIPFileExist(mcrStickerSetName) ||
+         m_StickerSetToPreviousFileIDs.contains(mcrStickerSetName)) &&
+        PrepareStickerSetZIPJob(mcrStickerSetName, false, zip_job))
+    {
+        zip_jobs << zip_job;
+    }
+    m_StickerSetToPreviousFileIDs.remove(mcrStickerSetName);
+    if (m_StickerSetIsConverting.contains(mcrStickerSetName) &&
+        !DoesStickerSetZIPFileExist(mcrStickerSetName, true) &&
+        PrepareStickerSetZIPJob(mcrStickerSetName, true, zip_job))
+    {
+        zip_jobs << zip_job;
+    }
+    if (!zip_jobs.isEmpty())
+    {
+        SaveStickerSetZIPFiles(mcrStickerSetName, zip_jobs);
+        CALL_OUT("");
+        return;
     }
 
+    // (5) Remove download flag & let outside world know sticker set zip
+    //     file is now available.
+    FinishStickerSetDownload(mcrStickerSetName);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Last step of downloading a sticker set
+void TelegramHelper::FinishStickerSetDownload(
+    const QString & mcrStickerSetName)
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
     // (5) Remove download flag & let outside world know sticker set zip
     //     file is now available.
     m_StickerSetIsDownloading -= mcrStickerSetName;
+    m_StickerSetIsPrefetching -= mcrStickerSetName;
+    m_StickerSetIsConverting -= mcrStickerSetName;
+    m_StickerSetToRemainingUniqueIDs.remove(mcrStickerSetName);
+    m_StickerSetToRemainingConversions.remove(mcrStickerSetName);
+    m_StickerSetToProgress.remove(mcrStickerSetName);
     emit StickerSetReceived(mcrStickerSetName);
 
     CALL_OUT("");
@@ -417,11 +714,13 @@ void TelegramHelper::Server_StickerSetInfoReceived(
 
     // Let everybody know
     emit StickerSetInfoReceived(mcrStickerSetName);
+    m_StickerSetIsRefreshing -= mcrStickerSetName;
+    m_StickerSetDoesNotExist -= mcrStickerSetName;
 
     // Check if this is part of a sticker set download
     if (m_StickerSetIsDownloading.contains(mcrStickerSetName))
     {
-        DownloadStickerSet(mcrStickerSetName);
+        ContinueStickerSetDownload(mcrStickerSetName);
     }
 
     CALL_OUT("");
@@ -430,30 +729,142 @@ void TelegramHelper::Server_StickerSetInfoReceived(
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Single sticker file has been received
-void TelegramHelper::StickerFileReceived(const QString & mcrFileID)
+// Server could not provide the sticker set info
+void TelegramHelper::Server_StickerSetInfoFailed(
+    const QString & mcrStickerSetName, const bool mcDoesNotExist)
 {
-    CALL_IN(QString("mcrFileID=%1")
-        .arg(CALL_SHOW(mcrFileID)));
+    CALL_IN(QString("mcrStickerSetName=%1, mcDoesNotExist=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcDoesNotExist)));
+
+    // Check if a download is waiting for it
+    TelegramComms * tc = TelegramComms::Instance();
+    if (!m_StickerSetIsDownloading.contains(mcrStickerSetName) ||
+        (tc -> DoesStickerSetInfoExist(mcrStickerSetName) &&
+         !m_StickerSetIsRefreshing.contains(mcrStickerSetName)))
+    {
+        // Nothing to do here.
+        CALL_OUT("");
+        return;
+    }
+
+    // Sets that don't exist aren't prefetched again (every sticker from
+    // them would try); asking for them still works
+    if (mcDoesNotExist &&
+        m_StickerSetIsPrefetching.contains(mcrStickerSetName))
+    {
+        m_StickerSetDoesNotExist += mcrStickerSetName;
+    }
+
+    // Give up on this download (asking again starts from scratch)
+    GiveUpStickerSetDownload(mcrStickerSetName, mcDoesNotExist);
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Give up on downloading a sticker set (asking again starts from scratch)
+void TelegramHelper::GiveUpStickerSetDownload(
+    const QString & mcrStickerSetName, const bool mcDoesNotExist)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcDoesNotExist=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcDoesNotExist)));
+
+    m_StickerSetIsDownloading -= mcrStickerSetName;
+    m_StickerSetIsPrefetching -= mcrStickerSetName;
+    m_StickerSetIsRefreshing -= mcrStickerSetName;
+    m_StickerSetIsConverting -= mcrStickerSetName;
+    m_StickerSetToRemainingUniqueIDs.remove(mcrStickerSetName);
+    m_StickerSetToRemainingConversions.remove(mcrStickerSetName);
+    m_StickerSetToPreviousFileIDs.remove(mcrStickerSetName);
+    m_StickerSetToProgress.remove(mcrStickerSetName);
+    emit StickerSetFailed(mcrStickerSetName, mcDoesNotExist);
 
-    // We received this file
-    for (auto set_name_iterator =
-            m_FileIDToStickerSetNames[mcrFileID].constBegin();
-         set_name_iterator != m_FileIDToStickerSetNames[mcrFileID].constEnd();
-         set_name_iterator++)
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Single sticker file has been received
+void TelegramHelper::StickerFileReceived(const QString & mcrFileUniqueID)
+{
+    CALL_IN(QString("mcrFileUniqueID=%1")
+        .arg(CALL_SHOW(mcrFileUniqueID)));
+
+    // We received this file (for all sets waiting for it; finishing a set
+    // may start another one, so don't hold on to the hash)
+    const QSet < QString > set_names =
+        m_FileUniqueIDToStickerSetNames.take(mcrFileUniqueID);
+    const qint64 file_size = m_FileUniqueIDToSize.take(mcrFileUniqueID);
+    for (const QString & set_name : set_names)
     {
-        const QString & set_name = *set_name_iterator;
-        m_StickerSetToRemainingFileIDs[set_name] -= mcrFileID;
+        // Sets that have been given up on in the meantime
+        if (!m_StickerSetIsDownloading.contains(set_name))
+        {
+            continue;
+        }
+        m_StickerSetToRemainingUniqueIDs[set_name] -= mcrFileUniqueID;
+        if (m_StickerSetToProgress.contains(set_name))
+        {
+            StickerSetProgress & progress = m_StickerSetToProgress[set_name];
+            progress.m_FilesDone++;
+            progress.m_BytesDone += file_size;
+        }
 
         // Are there more file to be received?
-        if (m_StickerSetToRemainingFileIDs[set_name].isEmpty())
+        if (m_StickerSetToRemainingUniqueIDs[set_name].isEmpty())
         {
             // Everything's downloaded.
-            DownloadStickerSet(set_name);
+            ContinueStickerSetDownload(set_name);
+        } else
+        {
+            emit StickerSetProgressChanged(set_name);
         }
     }
 
-    m_FileIDToStickerSetNames.remove(mcrFileID);
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Single sticker has been converted
+void TelegramHelper::Transcoder_FileTranscoded(const QString & mcrFileID,
+    const bool mcSuccess)
+{
+    CALL_IN(QString("mcrFileID=%1, mcSuccess=%2")
+        .arg(CALL_SHOW(mcrFileID),
+             CALL_SHOW(mcSuccess)));
+
+    // Done with this one (if the conversion failed, the ZIP file gets the
+    // original sticker)
+    TelegramComms * tc = TelegramComms::Instance();
+    const QString unique_id = tc -> GetFileUniqueID(mcrFileID);
+    QStringList finished_set_names;
+    for (auto set_iterator = m_StickerSetToRemainingConversions.begin();
+         set_iterator != m_StickerSetToRemainingConversions.end();
+         set_iterator++)
+    {
+        if (set_iterator.value().remove(unique_id) &&
+            set_iterator.value().isEmpty())
+        {
+            finished_set_names << set_iterator.key();
+        }
+    }
+
+    // Sets that have everything downloaded can go on
+    for (const QString & set_name : finished_set_names)
+    {
+        if (m_StickerSetToRemainingUniqueIDs.contains(set_name) &&
+            m_StickerSetToRemainingUniqueIDs[set_name].isEmpty())
+        {
+            ContinueStickerSetDownload(set_name);
+        }
+    }
 
     CALL_OUT("");
 }
@@ -461,101 +872,381 @@ void TelegramHelper::StickerFileReceived(const QString & mcrFileID)
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// Save ZIP file with all stickers in a set
-void TelegramHelper::SaveStickerSetZIPFile(const QString & mcrStickerSetName)
+// Check if we know how far a sticker set download is
+bool TelegramHelper::IsStickerSetProgressAvailable(
+    const QString & mcrStickerSetName) const
 {
     CALL_IN(QString("mcrStickerSetName=%1")
         .arg(CALL_SHOW(mcrStickerSetName)));
 
-    // Make target directory
-    QDir dir(USER_STICKERSETS);
-    if (!dir.exists(mcrStickerSetName))
+    const bool is_available =
+        m_StickerSetToProgress.contains(mcrStickerSetName);
+
+    CALL_OUT("");
+    return is_available;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// How far a sticker set download is (estimate from throughput so far)
+TelegramHelper::StickerSetProgress TelegramHelper::GetStickerSetProgress(
+    const QString & mcrStickerSetName) const
+{
+    CALL_IN(QString("mcrStickerSetName=%1")
+        .arg(CALL_SHOW(mcrStickerSetName)));
+
+    // Check if we have progress for this sticker set
+    if (!m_StickerSetToProgress.contains(mcrStickerSetName))
+    {
+        const QString reason = tr("No progress for sticker set \"%1\".")
+            .arg(mcrStickerSetName);
+        MessageLogger::Error(CALL_METHOD, reason);
+        CALL_OUT(reason);
+        return StickerSetProgress();
+    }
+    StickerSetProgress progress = m_StickerSetToProgress[mcrStickerSetName];
+
+    // Use bytes if we know file sizes, number of files otherwise
+    qint64 done = progress.m_BytesDone - progress.m_BytesAtStart;
+    qint64 left = progress.m_BytesTotal - progress.m_BytesDone;
+    if (progress.m_BytesTotal == 0)
+    {
+        done = progress.m_FilesDone - progress.m_FilesAtStart;
+        left = progress.m_FilesTotal - progress.m_FilesDone;
+    }
+    const qint64 elapsed_ms = progress.m_Timer.elapsed();
+    if (done > 0 &&
+        elapsed_ms > 0)
     {
-        dir.mkdir(mcrStickerSetName);
+        progress.m_SecondsLeft = (left * elapsed_ms / done + 999) / 1000;
     }
 
+    CALL_OUT("");
+    return progress;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Put together what's needed to write the ZIP file with all stickers in a
+// set (or with the converted ones); false if there's nothing to write
+bool TelegramHelper::PrepareStickerSetZIPJob(
+    const QString & mcrStickerSetName, const bool mcConverted,
+    StickerSetZIPJob & mrJob) const
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcConverted=%2, mrJob=%3")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcConverted),
+             "..."));
+
     // Get all files in the sticker set
     TelegramComms * tc = TelegramComms::Instance();
     const QStringList sticker_ids =
         tc -> GetStickerSetFileIDs(mcrStickerSetName);
 
-    // Save them in order
-    int sticker_count = 1;
-    for (const QString & file_id : sticker_ids)
-    {
-        // Determine file extension
-        const QHash < QString, QString > file_info =
-            tc -> GetFileInfo(file_id);
-        const QString extension =
-            (file_info["is_animated"] == "false" ? "webp" : "tgs");
-
-        // Filename
-        const QString number =
-            QString("00" + QString::number(sticker_count)).right(3);
-        const QString filename = QString("%1/%2/Sticker_%3.%4")
-            .arg(USER_STICKERSETS,
-                 mcrStickerSetName,
-                 number,
-                 extension);
-
-        // Save file
-        const QByteArray data = tc -> GetFile(file_id);
-        QFile out_file(filename);
-        out_file.open(QFile::WriteOnly);
-        out_file.write(data);
-        out_file.close();
-
-        sticker_count++;
-    }
-
-    // Create zip file
-    QStringList arguments;
-    const QString zip_filename = GetStickerSetZIPFilename(mcrStickerSetName);
-    arguments
-        << "-9"
-        << "-r"
-        << zip_filename
-        << mcrStickerSetName;
-    QProcess * process = new QProcess(this);
-    process -> setWorkingDirectory(USER_STICKERSETS);
-    process -> start("zip", arguments);
-    process -> waitForFinished();
-    const int exit_status = process -> exitStatus();
-    const QString std_err(process -> readAllStandardError());
-    delete process;
-
-    if (exit_status != QProcess::NormalExit)
+    mrJob = StickerSetZIPJob();
+    mrJob.m_StickerSetName = mcrStickerSetName;
+    mrJob.m_Converted = mcConverted;
+    mrJob.m_Filename =
+        GetStickerSetZIPFilename(mcrStickerSetName, mcConverted);
+    mrJob.m_Version = GetStickerSetVersion(sticker_ids);
+
+    // After a refresh, stickers that were in the set before are taken
+    // from the existing zip file as they are (if it has the stickers it
+    // should have)
+    QHash < QString, QString > file_id_to_previous_entry_name;
+    const QString zip_version = tc -> GetStickerSetZIPInfo(mcrStickerSetName)
+        .value(GetZIPInfoKey("zip_version", mcConverted));
+    const QStringList previous_ids =
+        m_StickerSetToPreviousFileIDs.value(mcrStickerSetName);
+    if (!mcConverted &&
+        m_StickerSetToPreviousFileIDs.contains(mcrStickerSetName) &&
+        QFile::exists(mrJob.m_Filename) &&
+        zip_version == GetStickerSetVersion(previous_ids))
+    {
+        if (zip_version == mrJob.m_Version)
+        {
+            // Nothing has changed.
+            CALL_OUT("");
+            return false;
+        }
+        for (int index = 0; index < previous_ids.size(); index++)
+        {
+            file_id_to_previous_entry_name[previous_ids[index]] =
+                GetStickerSetZIPEntryName(mcrStickerSetName, index + 1,
+                    previous_ids[index]);
+        }
+    }
+
+    // Stickers that are new to the zip file are read straight from where
+    // they were downloaded (or converted) to
+    StickerTranscoder * st = StickerTranscoder::Instance();
+    for (int index = 0; index < sticker_ids.size(); index++)
+    {
+        const QString & file_id = sticker_ids[index];
+        const bool use_converted = mcConverted &&
+            st -> IsTranscoded(file_id);
+        const QString entry_name = GetStickerSetZIPEntryName(
+            mcrStickerSetName, index + 1, file_id, use_converted);
+        mrJob.m_NamesAndFilenames << qMakePair(entry_name,
+            use_converted ?
+                st -> GetTranscodedFilename(file_id) :
+                tc -> GetLocalFilename(file_id));
+        if (file_id_to_previous_entry_name.contains(file_id))
+        {
+            mrJob.m_EntryNameToPreviousEntryName[entry_name] =
+                file_id_to_previous_entry_name[file_id];
+        }
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write sticker set ZIP files on the thread pool
+void TelegramHelper::SaveStickerSetZIPFiles(const QString & mcrStickerSetName,
+    const QList < StickerSetZIPJob > & mcrJobs)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcrJobs=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             "..."));
+
+    // Results come back here
+    m_StickerSetIsSavingZIPFiles += mcrStickerSetName;
+    QFutureWatcher < QList < bool > > * watcher =
+        new QFutureWatcher < QList < bool > >(this);
+    const QString set_name = mcrStickerSetName;
+    const QList < StickerSetZIPJob > jobs = mcrJobs;
+    connect (watcher, &QFutureWatcher < QList < bool > >::finished, this,
+        [this, watcher, set_name, jobs]()
+        {
+            const QList < bool > success = watcher -> result();
+            watcher -> deleteLater();
+            StickerSetZIPFilesSaved(set_name, jobs, success);
+        });
+    watcher -> setFuture(QtConcurrent::run([jobs]()
+        {
+            QList < bool > success;
+            for (const StickerSetZIPJob & job : jobs)
+            {
+                success << WriteStickerSetZIPFile(job);
+            }
+            return success;
+        }));
+
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Write a sticker set ZIP file (thread pool)
+bool TelegramHelper::WriteStickerSetZIPFile(const StickerSetZIPJob & mcrJob)
+{
+    CALL_IN(QString("mcrJob=%1")
+        .arg(CALL_SHOW(mcrJob.m_Filename)));
+
+    // Entries taken from the existing ZIP file
+    QHash < QString, ZIPWriter::Entry > previous_entries;
+    if (!mcrJob.m_EntryNameToPreviousEntryName.isEmpty() &&
+        !ZIPWriter::ReadEntries(mcrJob.m_Filename, previous_entries))
+    {
+        // Error has been reported elsewhere; read everything from disk.
+        previous_entries.clear();
+    }
+
+    // Everything else is read from disk
+    QList < ZIPWriter::Entry > entries;
+    QList < QPair < QString, QString > > names_and_filenames;
+    for (const QPair < QString, QString > & name_and_filename :
+        mcrJob.m_NamesAndFilenames)
+    {
+        const QString previous_entry_name =
+            mcrJob.m_EntryNameToPreviousEntryName.value(
+                name_and_filename.first);
+        if (previous_entries.contains(previous_entry_name))
+        {
+            ZIPWriter::Entry entry = previous_entries[previous_entry_name];
+            entry.m_Name = name_and_filename.first;
+            entries << entry;
+            continue;
+        }
+        names_and_filenames << name_and_filename;
+
+        // Placeholder
+        entries << ZIPWriter::Entry();
+    }
+    QList < ZIPWriter::Entry > new_entries;
+    if (!ZIPWriter::PrepareEntriesFromDisk(names_and_filenames, new_entries))
+    {
+        // Error has been reported elsewhere.
+        CALL_OUT("");
+        return false;
+    }
+    qDebug().noquote() << tr("Sticker set \"%1\": %2 stickers, %3 new")
+        .arg(mcrJob.m_StickerSetName,
+             QString::number(entries.size()),
+             QString::number(new_entries.size()));
+
+    // Create zip file, stickers in order
+    ZIPWriter zip_file(mcrJob.m_Filename);
+    if (!zip_file.Open())
+    {
+        // Error has been reported elsewhere.
+        CALL_OUT("");
+        return false;
+    }
+    int new_entry_index = 0;
+    for (const ZIPWriter::Entry & entry : entries)
+    {
+        const bool success = entry.m_Name.isEmpty() ?
+            zip_file.AddEntry(new_entries[new_entry_index++]) :
+            zip_file.AddEntry(entry);
+        if (!success)
+        {
+            // Error has been reported elsewhere.
+            CALL_OUT("");
+            return false;
+        }
+    }
+
+    // Save zip file
+    if (!zip_file.Close())
     {
         // An error occurred
         const QString reason = tr("An error occurred creating the sticker "
-            "set zip file \"%1.zip\": %2")
-            .arg(mcrStickerSetName,
-                 std_err);
+            "set zip file \"%1\".")
+            .arg(mcrJob.m_Filename);
         MessageLogger::Error(CALL_METHOD, reason);
         CALL_OUT(reason);
+        return false;
+    }
+
+    CALL_OUT("");
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Sticker set ZIP files have been written (or not)
+void TelegramHelper::StickerSetZIPFilesSaved(
+    const QString & mcrStickerSetName,
+    const QList < StickerSetZIPJob > & mcrJobs,
+    const QList < bool > & mcrSuccess)
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcrJobs=%2, mcrSuccess=%3")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             "...",
+             "..."));
+
+    // New versions (which haven't been uploaded yet)
+    TelegramComms * tc = TelegramComms::Instance();
+    QHash < QString, QString > zip_info =
+        tc -> GetStickerSetZIPInfo(mcrStickerSetName);
+    bool all_saved = true;
+    for (int index = 0; index < mcrJobs.size(); index++)
+    {
+        if (!mcrSuccess.value(index))
+        {
+            all_saved = false;
+            continue;
+        }
+        const bool converted = mcrJobs[index].m_Converted;
+        zip_info[GetZIPInfoKey("zip_version", converted)] =
+            mcrJobs[index].m_Version;
+        zip_info.remove(GetZIPInfoKey("document_file_id", converted));
+        zip_info.remove(GetZIPInfoKey("document_version", converted));
+    }
+    tc -> SetStickerSetZIPInfo(mcrStickerSetName, zip_info);
+
+    // Done (a ZIP file that couldn't be written isn't there to be sent;
+    // the error has been reported already)
+    m_StickerSetIsSavingZIPFiles -= mcrStickerSetName;
+    if (!all_saved)
+    {
+        GiveUpStickerSetDownload(mcrStickerSetName, false);
+        CALL_OUT("");
         return;
     }
+    FinishStickerSetDownload(mcrStickerSetName);
 
-    // Let the world know
-    emit StickerSetReceived(mcrStickerSetName);
+    CALL_OUT("");
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Name of a sticker in the sticker set ZIP file (numbered from 1)
+QString TelegramHelper::GetStickerSetZIPEntryName(
+    const QString & mcrStickerSetName, const int mcNumber,
+    const QString & mcrFileID, const bool mcConverted) const
+{
+    CALL_IN(QString("mcrStickerSetName=%1, mcNumber=%2, mcrFileID=%3, "
+        "mcConverted=%4")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcNumber),
+             CALL_SHOW(mcrFileID),
+             CALL_SHOW(mcConverted)));
+
+    // Determine file extension (stickers that don't say whether they're
+    // animated are taken to be)
+    TelegramComms * tc = TelegramComms::Instance();
+    const FileRecord file = tc -> GetFileRecord(mcrFileID);
+    QString extension =
+        (file.m_IsAnimated.m_IsSet && !file.m_IsAnimated ? "webp" : "tgs");
+    if (mcConverted)
+    {
+        extension = (file.m_IsAnimated ? "json" : "png");
+    }
+
+    // Name
+    const QString number = QString("00" + QString::number(mcNumber)).right(3);
+    const QString entry_name = QString("%1/Sticker_%2.%3")
+        .arg(mcrStickerSetName,
+             number,
+             extension);
 
     CALL_OUT("");
+    return entry_name;
 }
 
 
+
 ///////////////////////////////////////////////////////////////////////////////
-// Check if sticker set ZIP file exists
+// Check if sticker set ZIP file exists and has the current stickers
 bool TelegramHelper::DoesStickerSetZIPFileExist(
-    const QString & mcrStickerSetName) const
+    const QString & mcrStickerSetName, const bool mcConverted) const
 {
-    CALL_IN(QString("mcrStickerSetName=%1")
-        .arg(CALL_SHOW(mcrStickerSetName)));
+    CALL_IN(QString("mcrStickerSetName=%1, mcConverted=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcConverted)));
+
+    // Check if there is a file at all
+    TelegramComms * tc = TelegramComms::Instance();
+    const QString filename =
+        GetStickerSetZIPFilename(mcrStickerSetName, mcConverted);
+    if (!QFile::exists(filename) ||
+        !tc -> DoesStickerSetInfoExist(mcrStickerSetName))
+    {
+        CALL_OUT("");
+        return false;
+    }
 
-    const QString filename = GetStickerSetZIPFilename(mcrStickerSetName);
-    const bool exists = QFile::exists(filename);
+    // Check it's the current version (ZIP files from before there were
+    // versions are made again)
+    const QString version =
+        GetStickerSetVersion(tc -> GetStickerSetFileIDs(mcrStickerSetName));
+    const QString zip_version = tc -> GetStickerSetZIPInfo(mcrStickerSetName)
+        .value(GetZIPInfoKey("zip_version", mcConverted));
+    const bool is_current = (zip_version == version);
 
     CALL_OUT("");
-    return exists;
+    return is_current;
 }
 
 
@@ -563,13 +1254,147 @@ bool TelegramHelper::DoesStickerSetZIPFileExist(
 ///////////////////////////////////////////////////////////////////////////////
 // Get (local) filename of the ZIP file with all stickers in that set
 QString TelegramHelper::GetStickerSetZIPFilename(
-    const QString & mcrStickerSetName) const
+    const QString & mcrStickerSetName, const bool mcConverted) const
 {
-    CALL_IN(QString("mcrStickerSetName=%1")
-        .arg(CALL_SHOW(mcrStickerSetName)));
+    CALL_IN(QString("mcrStickerSetName=%1, mcConverted=%2")
+        .arg(CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcConverted)));
 
-    const QString zip_filename = USER_STICKERSETS + mcrStickerSetName + ".zip";
+    // (sticker set names don't have spaces)
+    const QString zip_filename = USER_STICKERSETS + mcrStickerSetName +
+        (mcConverted ? " (converted).zip" : ".zip");
 
     CALL_OUT("");
     return zip_filename;
 }
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Version of a sticker set
+QString TelegramHelper::GetStickerSetVersion(const QStringList & mcrFileIDs)
+    const
+{
+    CALL_IN(QString("mcrFileIDs=%1")
+        .arg(CALL_SHOW(mcrFileIDs)));
+
+    // Same stickers in the same order
+    TelegramComms * tc = TelegramComms::Instance();
+    QStringList unique_ids;
+    for (const QString & file_id : mcrFileIDs)
+    {
+        unique_ids << tc -> GetFileUniqueID(file_id);
+    }
+    const QByteArray hash = QCryptographicHash::hash(
+        unique_ids.join("\n").toUtf8(), QCryptographicHash::Sha1);
+    const QString version = QString::fromLatin1(hash.toHex());
+
+    CALL_OUT("");
+    return version;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Send the sticker set ZIP file to a chat
+bool TelegramHelper::SendStickerSetZIPFile(const qint64 mcChatID,
+    const QString & mcrStickerSetName, const bool mcConverted)
+{
+    CALL_IN(QString("mcChatID=%1, mcrStickerSetName=%2, mcConverted=%3")
+        .arg(CALL_SHOW(mcChatID),
+             CALL_SHOW(mcrStickerSetName),
+             CALL_SHOW(mcConverted)));
+
+    // Server may have this version already
+    TelegramComms * tc = TelegramComms::Instance();
+    const QHash < QString, QString > zip_info =
+        tc -> GetStickerSetZIPInfo(mcrStickerSetName);
+    const QString version =
+        zip_info.value(GetZIPInfoKey("zip_version", mcConverted));
+    const QString document_file_id =
+        zip_info.value(GetZIPInfoKey("document_file_id", mcConverted));
+    if (!document_file_id.isEmpty() &&
+        zip_info.value(GetZIPInfoKey("document_version", mcConverted)) ==
+            version)
+    {
+        tc -> SendDocument(mcChatID, document_file_id);
+        CALL_OUT("");
+        return true;
+    }
+
+    // Upload it; we'll keep the document file ID once the server has it
+    const QString tag = QString("%1:%2:%3")
+        .arg(mcConverted ? "stickerset_converted_zip" : "stickerset_zip",
+             version,
+             mcrStickerSetName);
+    const bool success = tc -> UploadFile(mcChatID,
+        GetStickerSetZIPFilename(mcrStickerSetName, mcConverted), tag);
+
+    CALL_OUT("");
+    return success;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Key in the ZIP file info
+QString TelegramHelper::GetZIPInfoKey(const QString & mcrKey,
+    const bool mcConverted)
+{
+    CALL_IN(QString("mcrKey=%1, mcConverted=%2")
+        .arg(CALL_SHOW(mcrKey),
+             CALL_SHOW(mcConverted)));
+
+    const QString key = (mcConverted ? "converted_" + mcrKey : mcrKey);
+
+    CALL_OUT("");
+    return key;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Server has a message we sent
+void TelegramHelper::Server_MessageSent(const QString & mcrTag,
+    const qint64 mcChatID, const qint64 mcMessageID)
+{
+    CALL_IN(QString("mcrTag=%1, mcChatID=%2, mcMessageID=%3")
+        .arg(CALL_SHOW(mcrTag),
+             CALL_SHOW(mcChatID),
+             CALL_SHOW(mcMessageID)));
+
+    // Check if this is a sticker set ZIP file (tag is
+    // stickerset_zip:<version>:<sticker set name>, or
+    // stickerset_converted_zip:... for converted stickers)
+    const bool is_converted =
+        mcrTag.startsWith("stickerset_converted_zip:");
+    if (!mcrTag.startsWith("stickerset_zip:") &&
+        !is_converted)
+    {
+        CALL_OUT("");
+        return;
+    }
+    const QString version = mcrTag.section(':', 1, 1);
+    const QString sticker_set_name = mcrTag.section(':', 2);
+
+    // ZIP file may have changed in the meantime
+    TelegramComms * tc = TelegramComms::Instance();
+    QHash < QString, QString > zip_info =
+        tc -> GetStickerSetZIPInfo(sticker_set_name);
+    const MessageRecord message = tc -> GetMessageRecord(mcMessageID);
+    if (zip_info.value(GetZIPInfoKey("zip_version", is_converted)) !=
+            version ||
+        message.m_DocumentID.isEmpty())
+    {
+        CALL_OUT("");
+        return;
+    }
+
+    // Next time, we'll just send the document
+    zip_info[GetZIPInfoKey("document_file_id", is_converted)] =
+        message.m_DocumentID;
+    zip_info[GetZIPInfoKey("document_version", is_converted)] = version;
+    tc -> SetStickerSetZIPInfo(sticker_set_name, zip_info);
+
+    CALL_OUT("");
+}
@@ -6,10 +6,14 @@
 
 // Qt includes
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QHash>
+#include <QList>
 #include <QObject>
+#include <QPair>
 #include <QSet>
 #include <QString>
+#include <QStringList>
 
 
 
@@ -79,32 +83,151 @@ public:
     // Check if we're already downloading a particular sticker set
     bool IsStickerSetBeingDownloaded(const QString & mcrStickerSetName) const;
 
-    // Download an entire sticker set
+    // Download an entire sticker set (with converted stickers as well if
+    // mcConvert is set)
     void DownloadStickerSet(const QString & mcrStickerSetName,
-        const bool mcForce = false);
+        const bool mcForce = false, const bool mcConvert = false);
+
+    // Download a sticker set in the background (only using what other
+    // downloads leave over), so it's there when somebody asks for it
+    void PrefetchStickerSet(const QString & mcrStickerSetName);
+
+    // Check if we're prefetching a particular sticker set
+    bool IsStickerSetBeingPrefetched(const QString & mcrStickerSetName)
+        const;
 private:
     QSet < QString > m_StickerSetIsDownloading;
+    QSet < QString > m_StickerSetIsRefreshing;
+    QSet < QString > m_StickerSetIsPrefetching;
+
+    // Sticker sets the server says don't exist (not prefetched again)
+    QSet < QString > m_StickerSetDoesNotExist;
+    QSet < QString > m_StickerSetIsConverting;
+    void PromoteStickerSetPrefetch(const QString & mcrStickerSetName);
+    void ContinueStickerSetDownload(const QString & mcrStickerSetName,
+        const bool mcForce = false);
 private slots:
     void Server_StickerSetInfoReceived(const QString & mcrStickerSetName);
+    void Server_StickerSetInfoFailed(const QString & mcrStickerSetName,
+        const bool mcDoesNotExist);
 signals:
     void StickerSetInfoReceived(const QString & mcrStickerSetName);
+
+    // Sticker set download has been given up (mcDoesNotExist if there is
+    // no such sticker set)
+    void StickerSetFailed(const QString & mcrStickerSetName,
+        const bool mcDoesNotExist);
 private:
     void DownloadStickerFiles(const QString & mcrStickerSetName);
-    void StickerFileReceived(const QString & mcrFileID);
-    void SaveStickerSetZIPFile(const QString & mcrStickerSetName);
+    void StickerFileReceived(const QString & mcrFileUniqueID);
+    void FinishStickerSetDownload(const QString & mcrStickerSetName);
+    void GiveUpStickerSetDownload(const QString & mcrStickerSetName,
+        const bool mcDoesNotExist);
+
+    // Sticker set ZIP file to be written (everything writing it needs, so
+    // it can be done on the thread pool without looking at the database)
+    struct StickerSetZIPJob
+    {
+        QString m_StickerSetName;
+        bool m_Converted = false;
+        QString m_Filename;
+        QString m_Version;
+
+        // Entries in order (entry name, file to read it from)
+        QList < QPair < QString, QString > > m_NamesAndFilenames;
+
+        // Entries taken from the existing ZIP file instead (entry name to
+        // name of the same sticker in the existing ZIP file)
+        QHash < QString, QString > m_EntryNameToPreviousEntryName;
+    };
+    bool PrepareStickerSetZIPJob(const QString & mcrStickerSetName,
+        const bool mcConverted, StickerSetZIPJob & mrJob) const;
+    void SaveStickerSetZIPFiles(const QString & mcrStickerSetName,
+        const QList < StickerSetZIPJob > & mcrJobs);
+    static bool WriteStickerSetZIPFile(const StickerSetZIPJob & mcrJob);
+    void StickerSetZIPFilesSaved(const QString & mcrStickerSetName,
+        const QList < StickerSetZIPJob > & mcrJobs,
+        const QList < bool > & mcrSuccess);
+    QSet < QString > m_StickerSetIsSavingZIPFiles;
+    QString GetStickerSetZIPEntryName(const QString & mcrStickerSetName,
+        const int mcNumber, const QString & mcrFileID,
+        const bool mcConverted = false) const;
+private slots:
+    void Transcoder_FileTranscoded(const QString & mcrFileID,
+        const bool mcSuccess);
 signals:
     void StickerSetReceived(const QString & mcrStickerSetName);
 public:
-    bool DoesStickerSetZIPFileExist(const QString & mcrStickerSetName) const;
+    // Check if the ZIP file exists and has the current stickers
+    bool DoesStickerSetZIPFileExist(const QString & mcrStickerSetName,
+        const bool mcConverted = false) const;
     // Get (local) filename of the ZIP file with all stickers in that set
-    QString GetStickerSetZIPFilename(const QString & mcrStickerSetName) const;
+    // (or with the converted stickers)
+    QString GetStickerSetZIPFilename(const QString & mcrStickerSetName,
+        const bool mcConverted = false) const;
+
+    // Version of a sticker set (hash of the file unique IDs of its
+    // stickers, so the same stickers give the same version in any chat)
+    QString GetStickerSetVersion(const QStringList & mcrFileIDs) const;
+
+    // Send the ZIP file to a chat (only uploaded the first time for each
+    // version; later, the server's copy is sent)
+    bool SendStickerSetZIPFile(const qint64 mcChatID,
+        const QString & mcrStickerSetName, const bool mcConverted = false);
+private:
+    // Key in the ZIP file info (the ZIP file with converted stickers has
+    // its own version and document)
+    static QString GetZIPInfoKey(const QString & mcrKey,
+        const bool mcConverted);
+private slots:
+    void Server_MessageSent(const QString & mcrTag, const qint64 mcChatID,
+        const qint64 mcMessageID);
 
 private:
-    // File ID to sticker set name(s)
-    QHash < QString, QSet < QString > > m_FileIDToStickerSetNames;
+    // Stickers are tracked by file unique ID; file IDs of the same sticker
+    // differ between sticker sets and chats
+
+    // File unique ID to sticker set name(s)
+    QHash < QString, QSet < QString > > m_FileUniqueIDToStickerSetNames;
+
+    // Remaining download queue for sticker set (file unique IDs)
+    QHash < QString, QSet < QString > > m_StickerSetToRemainingUniqueIDs;
+
+    // Stickers in the set before it was refreshed (file IDs)
+    QHash < QString, QStringList > m_StickerSetToPreviousFileIDs;
+
+    // Remaining conversions for sticker set (file unique IDs)
+    QHash < QString, QSet < QString > > m_StickerSetToRemainingConversions;
+
+public:
+    // Progress of a sticker set download
+    struct StickerSetProgress
+    {
+        int m_FilesDone = 0;
+        int m_FilesTotal = 0;
+        qint64 m_BytesDone = 0;
+        qint64 m_BytesTotal = 0;
+
+        // Estimated time left (-1 if we can't tell yet)
+        qint64 m_SecondsLeft = -1;
+
+        // What we had when the download started (throughput only counts
+        // what has been downloaded since)
+        int m_FilesAtStart = 0;
+        qint64 m_BytesAtStart = 0;
+        QElapsedTimer m_Timer;
+    };
+    bool IsStickerSetProgressAvailable(const QString & mcrStickerSetName)
+        const;
+    StickerSetProgress GetStickerSetProgress(
+        const QString & mcrStickerSetName) const;
+signals:
+    void StickerSetProgressChanged(const QString & mcrStickerSetName);
+private:
+    QHash < QString, StickerSetProgress > m_StickerSetToProgress;
 
-    // Remaining download queue for sticker set
-    QHash < QString, QSet < QString > > m_StickerSetToRemainingFileIDs;
+    // Sticker sizes (by file unique ID)
+    QHash < QString, qint64 > m_FileUniqueIDToSize;
 };
 
 #endif
@@ -0,0 +1,733 @@
+// SimpleTelegramBot - a software organizing everyday tasks
+// Copyright (C) 2025 Chris von Toerne
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+// Contact the author by email: christian.vontoerne@gmail.com
+
+// TelegramRecords.cpp
+// Type implementation
+
+// Project includes
+#include "MD5Sum.h"
+#include "TelegramRecords.h"
+
+// Qt includes
+#include <QCborValue>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+
+
+// Records do not do CALL_IN/CALL_OUT; they are converted on every access.
+
+
+
+// ==================================================================== Helpers
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add an ID (if set)
+static void PutID(QHash < QString, QString > & mrInfo, const QString & mcrKey,
+    const qint64 mcValue)
+{
+    if (mcValue != 0)
+    {
+        mrInfo[mcrKey] = QString::number(mcValue);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a text (if set)
+static void PutText(QHash < QString, QString > & mrInfo,
+    const QString & mcrKey, const QString & mcrValue)
+{
+    if (!mcrValue.isNull())
+    {
+        mrInfo[mcrKey] = mcrValue;
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a time stamp (if set)
+static void PutDateTime(QHash < QString, QString > & mrInfo,
+    const QString & mcrKey, const qint64 mcSecsSinceEpoch)
+{
+    // UTC, so it can be read back exactly (local time is ambiguous when the
+    // clocks go back)
+    if (mcSecsSinceEpoch != 0)
+    {
+        mrInfo[mcrKey] = QDateTime::fromSecsSinceEpoch(mcSecsSinceEpoch)
+            .toUTC().toString(Qt::ISODate);
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Add a flag (if set)
+static void PutFlag(QHash < QString, QString > & mrInfo,
+    const QString & mcrKey, const RecordFlag & mcrValue)
+{
+    if (mcrValue.m_IsSet)
+    {
+        mrInfo[mcrKey] = mcrValue.m_Value ? "true" : "false";
+    }
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove an ID from the info
+static qint64 TakeID(QHash < QString, QString > & mrInfo,
+    const QString & mcrKey)
+{
+    return mrInfo.take(mcrKey).toLongLong();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove a text from the info
+static QString TakeText(QHash < QString, QString > & mrInfo,
+    const QString & mcrKey)
+{
+    // take() returns a default constructed (null) QString if the key is
+    // not there
+    return mrInfo.take(mcrKey);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove a time stamp from the info
+static qint64 TakeDateTime(QHash < QString, QString > & mrInfo,
+    const QString & mcrKey)
+{
+    const QString date_time = mrInfo.take(mcrKey);
+    if (date_time.isEmpty())
+    {
+        return 0;
+    }
+
+    // UTC ("2025-04-17T18:05:09Z"); older rows have local time
+    if (date_time.endsWith('Z'))
+    {
+        return QDateTime::fromString(date_time, Qt::ISODate)
+            .toSecsSinceEpoch();
+    }
+    return QDateTime::fromString(date_time, "yyyy-MM-dd hh:mm:ss")
+        .toSecsSinceEpoch();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Remove a flag from the info
+static RecordFlag TakeFlag(QHash < QString, QString > & mrInfo,
+    const QString & mcrKey)
+{
+    RecordFlag flag;
+    if (mrInfo.contains(mcrKey))
+    {
+        flag = (mrInfo.take(mcrKey) == "true");
+    }
+    return flag;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Records in binary form (key/value info of every record)
+template < typename Record >
+static QCborArray RecordsToCbor(const QList < Record > & mcrRecords)
+{
+    QCborArray records;
+    for (const Record & record : mcrRecords)
+    {
+        const QHash < QString, QString > info = record.ToHash();
+        QCborMap cbor_info;
+        for (auto info_iterator = info.constBegin();
+             info_iterator != info.constEnd();
+             info_iterator++)
+        {
+            cbor_info.insert(info_iterator.key(), info_iterator.value());
+        }
+        records.append(cbor_info);
+    }
+    return records;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Records from binary form
+template < typename Record >
+static QList < Record > RecordsFromCbor(const QCborArray & mcrRecords)
+{
+    QList < Record > records;
+    records.reserve(mcrRecords.size());
+    for (const QCborValue & cbor_value : mcrRecords)
+    {
+        const QCborMap cbor_info = cbor_value.toMap();
+        QHash < QString, QString > info;
+        for (auto info_iterator = cbor_info.constBegin();
+             info_iterator != cbor_info.constEnd();
+             info_iterator++)
+        {
+            info[info_iterator.key().toString()] =
+                info_iterator.value().toString();
+        }
+        records << Record::FromHash(info);
+    }
+    return records;
+}
+
+
+
+// ===================================================================== Update
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert to key/value info
+QHash < QString, QString > UpdateRecord::ToHash() const
+{
+    QHash < QString, QString > info = m_Extras;
+    PutID(info, "id", m_ID);
+    PutText(info, "type", m_Type);
+    PutID(info, "message_id", m_MessageID);
+    PutID(info, "chat_id", m_ChatID);
+    PutID(info, "my_chat_member_id", m_MyChatMemberID);
+    return info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from key/value info
+UpdateRecord UpdateRecord::FromHash(const QHash < QString, QString > & mcrInfo)
+{
+    QHash < QString, QString > info = mcrInfo;
+    UpdateRecord record;
+    record.m_ID = TakeID(info, "id");
+    record.m_Type = TakeText(info, "type");
+    record.m_MessageID = TakeID(info, "message_id");
+    record.m_ChatID = TakeID(info, "chat_id");
+    record.m_MyChatMemberID = TakeID(info, "my_chat_member_id");
+    record.m_Extras = info;
+    return record;
+}
+
+
+
+// ==================================================================== Message
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert to key/value info
+QHash < QString, QString > MessageRecord::ToHash() const
+{
+    QHash < QString, QString > info = m_Extras;
+    PutID(info, "id", m_ID);
+    PutID(info, "chat_id", m_ChatID);
+    PutID(info, "from_id", m_FromID);
+    PutID(info, "sender_chat_id", m_SenderChatID);
+    PutID(info, "reply_to_message_id", m_ReplyToMessageID);
+    PutDateTime(info, "date_time", m_Date);
+    PutDateTime(info, "edit_date_time", m_EditDate);
+    PutDateTime(info, "forward_date_time", m_ForwardDate);
+    PutID(info, "forward_from_id", m_ForwardFromID);
+    PutID(info, "forward_from_chat_id", m_ForwardFromChatID);
+    PutText(info, "text", m_Text);
+    PutText(info, "caption", m_Caption);
+    PutText(info, "sticker_id", m_StickerID);
+    PutText(info, "document_id", m_DocumentID);
+    PutText(info, "photo_file_id", m_PhotoFileID);
+    return info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from key/value info
+MessageRecord MessageRecord::FromHash(
+    const QHash < QString, QString > & mcrInfo)
+{
+    QHash < QString, QString > info = mcrInfo;
+    MessageRecord record;
+    record.m_ID = TakeID(info, "id");
+    record.m_ChatID = TakeID(info, "chat_id");
+    record.m_FromID = TakeID(info, "from_id");
+    record.m_SenderChatID = TakeID(info, "sender_chat_id");
+    record.m_ReplyToMessageID = TakeID(info, "reply_to_message_id");
+    record.m_Date = TakeDateTime(info, "date_time");
+    record.m_EditDate = TakeDateTime(info, "edit_date_time");
+    record.m_ForwardDate = TakeDateTime(info, "forward_date_time");
+    record.m_ForwardFromID = TakeID(info, "forward_from_id");
+    record.m_ForwardFromChatID = TakeID(info, "forward_from_chat_id");
+    record.m_Text = TakeText(info, "text");
+    record.m_Caption = TakeText(info, "caption");
+    record.m_StickerID = TakeText(info, "sticker_id");
+    record.m_DocumentID = TakeText(info, "document_id");
+    record.m_PhotoFileID = TakeText(info, "photo_file_id");
+    record.m_Extras = info;
+    return record;
+}
+
+
+
+// ======================================================================= User
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert to key/value info
+QHash < QString, QString > UserRecord::ToHash() const
+{
+    QHash < QString, QString > info = m_Extras;
+    PutID(info, "id", m_ID);
+    PutFlag(info, "is_bot", m_IsBot);
+    PutFlag(info, "is_premium", m_IsPremium);
+    PutText(info, "first_name", m_FirstName);
+    PutText(info, "last_name", m_LastName);
+    PutText(info, "username", m_Username);
+    PutText(info, "language_code", m_LanguageCode);
+    return info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from key/value info
+UserRecord UserRecord::FromHash(const QHash < QString, QString > & mcrInfo)
+{
+    QHash < QString, QString > info = mcrInfo;
+    UserRecord record;
+    record.m_ID = TakeID(info, "id");
+    record.m_IsBot = TakeFlag(info, "is_bot");
+    record.m_IsPremium = TakeFlag(info, "is_premium");
+    record.m_FirstName = TakeText(info, "first_name");
+    record.m_LastName = TakeText(info, "last_name");
+    record.m_Username = TakeText(info, "username");
+    record.m_LanguageCode = TakeText(info, "language_code");
+    record.m_Extras = info;
+    return record;
+}
+
+
+
+// ======================================================================= Chat
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert to key/value info
+QHash < QString, QString > ChatRecord::ToHash() const
+{
+    QHash < QString, QString > info = m_Extras;
+    PutID(info, "id", m_ID);
+    PutText(info, "type", m_Type);
+    PutText(info, "title", m_Title);
+    PutText(info, "first_name", m_FirstName);
+    PutText(info, "last_name", m_LastName);
+    PutText(info, "username", m_Username);
+    return info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from key/value info
+ChatRecord ChatRecord::FromHash(const QHash < QString, QString > & mcrInfo)
+{
+    QHash < QString, QString > info = mcrInfo;
+    ChatRecord record;
+    record.m_ID = TakeID(info, "id");
+    record.m_Type = TakeText(info, "type");
+    record.m_Title = TakeText(info, "title");
+    record.m_FirstName = TakeText(info, "first_name");
+    record.m_LastName = TakeText(info, "last_name");
+    record.m_Username = TakeText(info, "username");
+    record.m_Extras = info;
+    return record;
+}
+
+
+
+// =============================================================== MyChatMember
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert to key/value info
+QHash < QString, QString > MyChatMemberRecord::ToHash() const
+{
+    QHash < QString, QString > info = m_Extras;
+    PutID(info, "id", m_ID);
+    PutID(info, "chat_id", m_ChatID);
+    PutID(info, "from_id", m_FromID);
+    PutDateTime(info, "date_time", m_Date);
+    return info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from key/value info
+MyChatMemberRecord MyChatMemberRecord::FromHash(
+    const QHash < QString, QString > & mcrInfo)
+{
+    QHash < QString, QString > info = mcrInfo;
+    MyChatMemberRecord record;
+    record.m_ID = TakeID(info, "id");
+    record.m_ChatID = TakeID(info, "chat_id");
+    record.m_FromID = TakeID(info, "from_id");
+    record.m_Date = TakeDateTime(info, "date_time");
+    record.m_Extras = info;
+    return record;
+}
+
+
+
+// ======================================================================= File
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert to key/value info
+QHash < QString, QString > FileRecord::ToHash() const
+{
+    QHash < QString, QString > info = m_Extras;
+    PutText(info, "id", m_ID);
+    PutText(info, "file_id", m_ID);
+    PutText(info, "file_unique_id", m_FileUniqueID);
+    PutID(info, "file_size", m_FileSize);
+    PutID(info, "width", m_Width);
+    PutID(info, "height", m_Height);
+    PutFlag(info, "is_animated", m_IsAnimated);
+    PutFlag(info, "is_video", m_IsVideo);
+    PutText(info, "type", m_Type);
+    PutText(info, "set_name", m_SetName);
+    PutText(info, "emoji", m_Emoji);
+    PutText(info, "file_name", m_FileName);
+    PutText(info, "mime_type", m_MimeType);
+    return info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from key/value info
+FileRecord FileRecord::FromHash(const QHash < QString, QString > & mcrInfo)
+{
+    QHash < QString, QString > info = mcrInfo;
+    FileRecord record;
+    record.m_ID = TakeText(info, "id");
+    info.remove("file_id");
+    record.m_FileUniqueID = TakeText(info, "file_unique_id");
+    record.m_FileSize = TakeID(info, "file_size");
+    record.m_Width = int(TakeID(info, "width"));
+    record.m_Height = int(TakeID(info, "height"));
+    record.m_IsAnimated = TakeFlag(info, "is_animated");
+    record.m_IsVideo = TakeFlag(info, "is_video");
+    record.m_Type = TakeText(info, "type");
+    record.m_SetName = TakeText(info, "set_name");
+    record.m_Emoji = TakeText(info, "emoji");
+    record.m_FileName = TakeText(info, "file_name");
+    record.m_MimeType = TakeText(info, "mime_type");
+    record.m_Extras = info;
+    return record;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fill in whatever we didn't know yet from another version of the same file
+void FileRecord::Merge(const FileRecord & mcrOther)
+{
+    // We get different versions of file infos, e.g. one in the list of
+    // stickers in a set, and one when we try and download a file. Existing
+    // information takes precedence.
+    if (m_ID.isNull())
+    {
+        m_ID = mcrOther.m_ID;
+    }
+    if (m_FileUniqueID.isNull())
+    {
+        m_FileUniqueID = mcrOther.m_FileUniqueID;
+    }
+    if (m_FileSize == 0)
+    {
+        m_FileSize = mcrOther.m_FileSize;
+    }
+    if (m_Width == 0)
+    {
+        m_Width = mcrOther.m_Width;
+    }
+    if (m_Height == 0)
+    {
+        m_Height = mcrOther.m_Height;
+    }
+    if (!m_IsAnimated.m_IsSet)
+    {
+        m_IsAnimated = mcrOther.m_IsAnimated;
+    }
+    if (!m_IsVideo.m_IsSet)
+    {
+        m_IsVideo = mcrOther.m_IsVideo;
+    }
+    if (m_Type.isNull())
+    {
+        m_Type = mcrOther.m_Type;
+    }
+    if (m_SetName.isNull())
+    {
+        m_SetName = mcrOther.m_SetName;
+    }
+    if (m_Emoji.isNull())
+    {
+        m_Emoji = mcrOther.m_Emoji;
+    }
+    if (m_FileName.isNull())
+    {
+        m_FileName = mcrOther.m_FileName;
+    }
+    if (m_MimeType.isNull())
+    {
+        m_MimeType = mcrOther.m_MimeType;
+    }
+    for (auto extra_iterator = mcrOther.m_Extras.constBegin();
+         extra_iterator != mcrOther.m_Extras.constEnd();
+         extra_iterator++)
+    {
+        if (!m_Extras.contains(extra_iterator.key()))
+        {
+            m_Extras[extra_iterator.key()] = extra_iterator.value();
+        }
+    }
+}
+
+
+
+// =============================================================== Channel Post
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert to key/value info
+QHash < QString, QString > ChannelPostRecord::ToHash() const
+{
+    QHash < QString, QString > info = m_Extras;
+    PutID(info, "id", m_ID);
+    PutID(info, "message_id", m_ID);
+    PutID(info, "chat_id", m_ChatID);
+    PutID(info, "sender_chat_id", m_SenderChatID);
+    PutDateTime(info, "date_time", m_Date);
+    PutText(info, "text", m_Text);
+    PutText(info, "caption", m_Caption);
+    PutText(info, "photo_file_id", m_PhotoFileID);
+    PutText(info, "document_file_id", m_DocumentFileID);
+    return info;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from key/value info
+ChannelPostRecord ChannelPostRecord::FromHash(
+    const QHash < QString, QString > & mcrInfo)
+{
+    QHash < QString, QString > info = mcrInfo;
+    ChannelPostRecord record;
+    record.m_ID = TakeID(info, "id");
+    info.remove("message_id");
+    record.m_ChatID = TakeID(info, "chat_id");
+    record.m_SenderChatID = TakeID(info, "sender_chat_id");
+    record.m_Date = TakeDateTime(info, "date_time");
+    record.m_Text = TakeText(info, "text");
+    record.m_Caption = TakeText(info, "caption");
+    record.m_PhotoFileID = TakeText(info, "photo_file_id");
+    record.m_DocumentFileID = TakeText(info, "document_file_id");
+    record.m_Extras = info;
+    return record;
+}
+
+
+
+// =================================================================== Keyboard
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Compact representation
+QByteArray KeyboardRecord::ToJson() const
+{
+    // [[["text","callback_data"],...],...]
+    QJsonArray rows;
+    for (const QList < Button > & row : m_Rows)
+    {
+        QJsonArray buttons;
+        for (const Button & button : row)
+        {
+            buttons.append(QJsonArray({ button.m_Text,
+                button.m_CallbackData }));
+        }
+        rows.append(buttons);
+    }
+    return QJsonDocument(rows).toJson(QJsonDocument::Compact);
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from compact representation
+KeyboardRecord KeyboardRecord::FromJson(const QByteArray & mcrJson)
+{
+    KeyboardRecord record;
+    const QJsonArray rows = QJsonDocument::fromJson(mcrJson).array();
+    for (const QJsonValue & row : rows)
+    {
+        QList < Button > buttons;
+        const QJsonArray row_array = row.toArray();
+        for (const QJsonValue & button_value : row_array)
+        {
+            const QJsonArray button_array = button_value.toArray();
+            Button button;
+            button.m_Text = button_array.at(0).toString();
+            button.m_CallbackData = button_array.at(1).toString();
+            buttons << button;
+        }
+        record.m_Rows << buttons;
+    }
+    record.m_ContentHash = record.ComputeContentHash();
+    return record;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Hash of the content
+QString KeyboardRecord::ComputeContentHash() const
+{
+    return MD5Sum::ComputeMD5Sum(ToJson());
+}
+
+
+
+// ============================================================ Parsed Entities
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Binary representation
+QCborMap ParsedEntities::ToCbor() const
+{
+    QCborMap cbor;
+    cbor.insert(QString("updates"), RecordsToCbor(m_Updates));
+    cbor.insert(QString("messages"), RecordsToCbor(m_Messages));
+    cbor.insert(QString("edited_messages"), RecordsToCbor(m_EditedMessages));
+    cbor.insert(QString("users"), RecordsToCbor(m_Users));
+    cbor.insert(QString("chats"), RecordsToCbor(m_Chats));
+    cbor.insert(QString("my_chat_members"), RecordsToCbor(m_MyChatMembers));
+    cbor.insert(QString("files"), RecordsToCbor(m_Files));
+    cbor.insert(QString("channel_posts"), RecordsToCbor(m_ChannelPosts));
+
+    // Keyboards: [message ID, [[[text, callback_data], ...], ...]]
+    QCborArray keyboards;
+    for (const QPair < qint64, KeyboardRecord > & message_keyboard :
+        m_Keyboards)
+    {
+        QCborArray rows;
+        for (const QList < KeyboardRecord::Button > & row :
+            message_keyboard.second.m_Rows)
+        {
+            QCborArray buttons;
+            for (const KeyboardRecord::Button & button : row)
+            {
+                buttons.append(QCborArray({ button.m_Text,
+                    button.m_CallbackData }));
+            }
+            rows.append(buttons);
+        }
+        keyboards.append(QCborArray({ message_keyboard.first, rows }));
+    }
+    cbor.insert(QString("keyboards"), keyboards);
+
+    return cbor;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Convert from binary representation
+ParsedEntities ParsedEntities::FromCbor(const QCborMap & mcrCbor)
+{
+    ParsedEntities parsed;
+    parsed.m_Updates =
+        RecordsFromCbor < UpdateRecord >(mcrCbor[QString("updates")]
+            .toArray());
+    parsed.m_Messages =
+        RecordsFromCbor < MessageRecord >(mcrCbor[QString("messages")]
+            .toArray());
+    parsed.m_EditedMessages =
+        RecordsFromCbor < MessageRecord >(
+            mcrCbor[QString("edited_messages")].toArray());
+    parsed.m_Users =
+        RecordsFromCbor < UserRecord >(mcrCbor[QString("users")].toArray());
+    parsed.m_Chats =
+        RecordsFromCbor < ChatRecord >(mcrCbor[QString("chats")].toArray());
+    parsed.m_MyChatMembers =
+        RecordsFromCbor < MyChatMemberRecord >(
+            mcrCbor[QString("my_chat_members")].toArray());
+    parsed.m_Files =
+        RecordsFromCbor < FileRecord >(mcrCbor[QString("files")].toArray());
+    parsed.m_ChannelPosts =
+        RecordsFromCbor < ChannelPostRecord >(
+            mcrCbor[QString("channel_posts")].toArray());
+
+    const QCborArray keyboards = mcrCbor[QString("keyboards")].toArray();
+    for (const QCborValue & keyboard_value : keyboards)
+    {
+        const QCborArray message_keyboard = keyboard_value.toArray();
+        KeyboardRecord keyboard;
+        const QCborArray rows = message_keyboard.at(1).toArray();
+        for (const QCborValue & row : rows)
+        {
+            QList < KeyboardRecord::Button > buttons;
+            const QCborArray row_array = row.toArray();
+            for (const QCborValue & button_value : row_array)
+            {
+                const QCborArray button_array = button_value.toArray();
+                KeyboardRecord::Button button;
+                button.m_Text = button_array.at(0).toString();
+                button.m_CallbackData = button_array.at(1).toString();
+                buttons << button;
+            }
+            keyboard.m_Rows << buttons;
+        }
+        keyboard.m_ContentHash = keyboard.ComputeContentHash();
+        parsed.m_Keyboards << QPair < qint64, KeyboardRecord >(
+            message_keyboard.at(0).toInteger(), keyboard);
+    }
+
+    return parsed;
+}
@@ -0,0 +1,247 @@
+// TelegramRecords.h
+// Type definitions
+
+// Parsed Telegram entities. Numbers and flags are kept in their native types;
+// anything we don't need to look at regularly goes into m_Extras.
+// ToHash() and FromHash() convert from and to the key/value representation
+// used in the database and in the Get*Info() methods of TelegramComms.
+//
+// Conventions for "not set": IDs and time stamps are 0, strings are null,
+// flags are not set (only flags Telegram gave us are stored).
+
+#ifndef TELEGRAMRECORDS_H
+#define TELEGRAMRECORDS_H
+
+// Qt includes
+#include <QByteArray>
+#include <QCborArray>
+#include <QCborMap>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+
+
+// Flag (remembers whether it was given at all, so records don't add flags
+// to the key/value info that weren't there)
+struct RecordFlag
+{
+    bool m_IsSet = false;
+    bool m_Value = false;
+
+    RecordFlag & operator=(const bool mcValue)
+    {
+        m_IsSet = true;
+        m_Value = mcValue;
+        return *this;
+    }
+    operator bool() const { return m_Value; }
+};
+
+
+
+// Update
+struct UpdateRecord
+{
+    qint64 m_ID = 0;
+    QString m_Type;
+    qint64 m_MessageID = 0;
+    qint64 m_ChatID = 0;
+    qint64 m_MyChatMemberID = 0;
+    QHash < QString, QString > m_Extras;
+
+    bool IsEmpty() const { return m_ID == 0; }
+    QHash < QString, QString > ToHash() const;
+    static UpdateRecord FromHash(const QHash < QString, QString > & mcrInfo);
+};
+
+
+
+// Message
+struct MessageRecord
+{
+    qint64 m_ID = 0;
+    qint64 m_ChatID = 0;
+    qint64 m_FromID = 0;
+    qint64 m_SenderChatID = 0;
+    qint64 m_ReplyToMessageID = 0;
+    qint64 m_Date = 0;
+    qint64 m_EditDate = 0;
+    qint64 m_ForwardDate = 0;
+    qint64 m_ForwardFromID = 0;
+    qint64 m_ForwardFromChatID = 0;
+    QString m_Text;
+    QString m_Caption;
+    QString m_StickerID;
+    QString m_DocumentID;
+    QString m_PhotoFileID;
+    QHash < QString, QString > m_Extras;
+
+    bool IsEmpty() const { return m_ID == 0; }
+    QHash < QString, QString > ToHash() const;
+    static MessageRecord FromHash(const QHash < QString, QString > & mcrInfo);
+};
+
+
+
+// User
+struct UserRecord
+{
+    qint64 m_ID = 0;
+    RecordFlag m_IsBot;
+    RecordFlag m_IsPremium;
+    QString m_FirstName;
+    QString m_LastName;
+    QString m_Username;
+    QString m_LanguageCode;
+    QHash < QString, QString > m_Extras;
+
+    bool IsEmpty() const { return m_ID == 0; }
+    QHash < QString, QString > ToHash() const;
+    static UserRecord FromHash(const QHash < QString, QString > & mcrInfo);
+};
+
+
+
+// Chat
+struct ChatRecord
+{
+    qint64 m_ID = 0;
+    QString m_Type;
+    QString m_Title;
+    QString m_FirstName;
+    QString m_LastName;
+    QString m_Username;
+    QHash < QString, QString > m_Extras;
+
+    bool IsEmpty() const { return m_ID == 0; }
+    QHash < QString, QString > ToHash() const;
+    static ChatRecord FromHash(const QHash < QString, QString > & mcrInfo);
+};
+
+
+
+// MyChatMember
+struct MyChatMemberRecord
+{
+    // Telegram doesn't provide an ID; we're using the time stamp
+    qint64 m_ID = 0;
+    qint64 m_ChatID = 0;
+    qint64 m_FromID = 0;
+    qint64 m_Date = 0;
+
+    // old_chat_member_... and new_chat_member_... live in here
+    QHash < QString, QString > m_Extras;
+
+    bool IsEmpty() const { return m_ID == 0; }
+    QHash < QString, QString > ToHash() const;
+    static MyChatMemberRecord FromHash(
+        const QHash < QString, QString > & mcrInfo);
+};
+
+
+
+// File (animation, document, photo, sticker)
+struct FileRecord
+{
+    QString m_ID;
+    QString m_FileUniqueID;
+    qint64 m_FileSize = 0;
+    int m_Width = 0;
+    int m_Height = 0;
+    RecordFlag m_IsAnimated;
+    RecordFlag m_IsVideo;
+    QString m_Type;
+    QString m_SetName;
+    QString m_Emoji;
+    QString m_FileName;
+    QString m_MimeType;
+    QHash < QString, QString > m_Extras;
+
+    bool IsEmpty() const { return m_ID.isEmpty(); }
+    QHash < QString, QString > ToHash() const;
+    static FileRecord FromHash(const QHash < QString, QString > & mcrInfo);
+
+    // Fill in whatever we didn't know yet from another version of the
+    // same file
+    void Merge(const FileRecord & mcrOther);
+};
+
+
+
+// Channel post
+struct ChannelPostRecord
+{
+    qint64 m_ID = 0;
+    qint64 m_ChatID = 0;
+    qint64 m_SenderChatID = 0;
+    qint64 m_Date = 0;
+    QString m_Text;
+    QString m_Caption;
+    QString m_PhotoFileID;
+    QString m_DocumentFileID;
+    QHash < QString, QString > m_Extras;
+
+    bool IsEmpty() const { return m_ID == 0; }
+    QHash < QString, QString > ToHash() const;
+    static ChannelPostRecord FromHash(
+        const QHash < QString, QString > & mcrInfo);
+};
+
+
+
+// Inline keyboard (reply_markup). Identical keyboards are only stored once;
+// they are told apart by the hash of their content.
+struct KeyboardRecord
+{
+    struct Button
+    {
+        QString m_Text;
+        QString m_CallbackData;
+    };
+
+    qint64 m_ID = 0;
+    QString m_ContentHash;
+    QList < QList < Button > > m_Rows;
+
+    bool IsEmpty() const { return m_Rows.isEmpty(); }
+
+    // Compact representation used in the database:
+    // [[["text","callback_data"],...],...]
+    QByteArray ToJson() const;
+    static KeyboardRecord FromJson(const QByteArray & mcrJson);
+
+    // MD5 of the compact representation
+    QString ComputeContentHash() const;
+};
+
+
+
+// Everything found while parsing a response, in the order parsing finished
+// (nested entities before the ones containing them). Parsing only fills
+// this in; TelegramComms::CommitParsedEntities() saves it afterwards.
+//
+// When parsed entities need to be handed on or kept (queues, journals),
+// use the CBOR representation; it is a lot smaller and faster to decode
+// than JSON text.
+struct ParsedEntities
+{
+    QList < UpdateRecord > m_Updates;
+    QList < MessageRecord > m_Messages;
+    QList < MessageRecord > m_EditedMessages;
+    QList < UserRecord > m_Users;
+    QList < ChatRecord > m_Chats;
+    QList < MyChatMemberRecord > m_MyChatMembers;
+    QList < FileRecord > m_Files;
+    QList < ChannelPostRecord > m_ChannelPosts;
+
+    // Keyboards get their IDs when committed (message ID, keyboard)
+    QList < QPair < qint64, KeyboardRecord > > m_Keyboards;
+
+    // Binary representation
+    QCborMap ToCbor() const;
+    static ParsedEntities FromCbor(const QCborMap & mcrCbor);
+};
+
+#endif
@@ -23,6 +23,9 @@
 #include "Config.h"
 #include "TelegramComms.h"
 #include "MainWindow.h"
+#include "ParserBenchmark.h"
+#include "ScalerBenchmark.h"
+#include "StickerSetCheck.h"
 
 // System include
 #include <signal.h>
@@ -39,6 +42,30 @@ int main(int mNumParameters, char * mpParameter[])
 
     Application * app = Application::Instance(mNumParameters, mpParameter);
 
+    // Parser benchmark instead of running the bot
+    if (app -> arguments().contains("--benchmark"))
+    {
+        const int result = ParserBenchmark::Run(1000);
+        delete app;
+        return result;
+    }
+
+    // Scaler benchmark (contact sheet tiles) instead of running the bot
+    if (app -> arguments().contains("--benchmark-scaler"))
+    {
+        const int result = ScalerBenchmark::Run(100);
+        delete app;
+        return result;
+    }
+
+    // Sticker set download checks instead of running the bot
+    if (app -> arguments().contains("--check-sticker-sets"))
+    {
+        const int result = StickerSetCheck::Run();
+        delete app;
+        return result;
+    }
+
     // Open database
     TelegramComms * tc = TelegramComms::Instance();
 